@@ -0,0 +1,147 @@
+// Example Benchmarks
+// ------------------
+// Evaluates programs of `examples/` with 1, 2, 4 ... threads (up to the available parallelism),
+// reporting rewrites per second. Only `normalize` is timed: parsing, building the program and
+// creating the heap aren't. After each example, prints its scaling efficiency at each thread
+// count, `time(1) / (n * time(n))`. Run with `cargo bench --bench examples`.
+//
+// With HVM_BENCH_COMPILED=1, each example is also compiled to Rust with `hvm compile`, built with
+// `cargo build --release`, and timed by running the resulting binary (its own TIME report, which
+// has a resolution of 10ms). This needs a toolchain and network access for the generated crate.
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use hvm::language;
+use hvm::runtime::{*};
+use std::collections::HashMap;
+use std::time::{Duration, Instant};
+
+// (name, file, main call)
+const EXAMPLES : &[(&str, &str, &str)] = &[
+  ("quick_sort"    , "examples/sort/quick/main.hvm"           , "(Main 16)"),
+  ("bitonic_sort"  , "examples/sort/bitonic/main.hvm"         , "(Main 14)"),
+  ("radix_sort"    , "examples/sort/radix/main.hvm"           , "(Main 16)"),
+  ("bubble_sort"   , "examples/sort/bubble/main.hvm"          , "(Main 2)"),
+  ("multiplication", "examples/lambda/multiplication/main.hvm", "(Main 20)"),
+  ("fib_tups"      , "examples/bugs/fib_tups.hvm"             , "(Main 0)"),
+];
+
+fn read_example(file: &str) -> String {
+  let path = format!("{}/{}", env!("CARGO_MANIFEST_DIR"), file);
+  return std::fs::read_to_string(&path).unwrap_or_else(|e| panic!("can't read '{}': {}", path, e));
+}
+
+fn thread_counts() -> Vec<usize> {
+  let cpus = std::thread::available_parallelism().map(|x| x.get()).unwrap_or(1);
+  let mut tids = vec![];
+  let mut count = 1;
+  while count < cpus {
+    tids.push(count);
+    count *= 2;
+  }
+  tids.push(cpus);
+  return tids;
+}
+
+// Evaluates the rulebook's HVM_MAIN_CALL, returning the rewrite count and the time to normalize
+fn eval(book: &language::rulebook::RuleBook, prog: &Program, size: usize, tids: usize) -> (u64, Duration) {
+  let heap = new_heap(size, tids, AllocMode::Scan);
+  let tids = new_tids(tids);
+  let host = alloc(&heap, tids[0], 1);
+  link(&heap, host, Fun(*book.name_to_id.get("HVM_MAIN_CALL").unwrap(), 0));
+  let init = Instant::now();
+  normalize(&heap, prog, &tids, host, false);
+  let time = init.elapsed();
+  return (get_cost(&heap), time);
+}
+
+// Compiles an example with `hvm compile` in a scratch directory, returning the built binary
+fn build_compiled(name: &str, file: &str) -> std::path::PathBuf {
+  let dir = std::env::temp_dir().join("hvm-bench");
+  std::fs::create_dir_all(&dir).unwrap();
+  std::fs::write(dir.join(format!("{}.hvm", name)), read_example(file)).unwrap();
+  let done = std::process::Command::new(env!("CARGO_BIN_EXE_hvm")).current_dir(&dir).arg("compile").arg(format!("{}.hvm", name)).status().unwrap();
+  assert!(done.success(), "can't compile '{}'", file);
+  let done = std::process::Command::new("cargo").current_dir(dir.join(name)).args(["build", "--release"]).status().unwrap();
+  assert!(done.success(), "can't build the compiled '{}'", file);
+  return dir.join(name).join("target").join("release").join(name);
+}
+
+// Runs a compiled example, parsing its "[TIME: ..s | COST: .. | ...]" report
+fn run_compiled(bin: &std::path::Path, name: &str, call: &str, tids: usize) -> (u64, Duration) {
+  let dir = bin.parent().unwrap().parent().unwrap().parent().unwrap().parent().unwrap();
+  let file = dir.join(format!("{}.hvm", name));
+  let tids = tids.to_string();
+  let done = std::process::Command::new(bin).args(["run", "-t", &tids, "-c", "true", "-f"]).arg(&file).arg(call).output().unwrap();
+  let text = String::from_utf8_lossy(&done.stderr);
+  let field = |key: &str| -> f64 {
+    let init = text.find(key).unwrap_or_else(|| panic!("no {} in the output of '{}': {}", key, name, text)) + key.len();
+    let rest = text[init ..].trim_start();
+    let size = rest.find(|c: char| !(c.is_ascii_digit() || c == '.')).unwrap_or(rest.len());
+    return rest[.. size].parse::<f64>().unwrap();
+  };
+  return (field("COST:") as u64 + 1, Duration::from_secs_f64(field("TIME:")));
+}
+
+// Prints rewrites per second and scaling efficiency from the mean time at each thread count
+fn show_scaling(name: &str, cost: u64, times: &HashMap<usize, Duration>) {
+  let mut tids = times.keys().cloned().collect::<Vec<usize>>();
+  tids.sort();
+  if let Some(time1) = times.get(&1) {
+    for count in tids {
+      let time = times[&count];
+      let mrps = cost as f64 / time.as_secs_f64() / 1_000_000.0;
+      let efficiency = time1.as_secs_f64() / (count as f64 * time.as_secs_f64());
+      println!("{:>24} | threads: {:>3} | {:>10.2} M rewrites/s | efficiency: {:>5.1}%", name, count, mrps, efficiency * 100.0);
+    }
+  }
+}
+
+fn interpreted(c: &mut Criterion) {
+  let size = default_heap_size();
+  for (name, file, call) in EXAMPLES {
+    let code = format!("{}\nHVM_MAIN_CALL = {}", read_example(file), call);
+    let book = language::rulebook::gen_rulebook(&language::syntax::read_file(&code).unwrap());
+    let mut prog = Program::new();
+    prog.add_book(&book);
+    let (cost, _) = eval(&book, &prog, size, 1);
+    let mut times = HashMap::new();
+    let mut group = c.benchmark_group(format!("interpreted/{}", name));
+    group.sample_size(10);
+    group.throughput(Throughput::Elements(cost));
+    for tids in thread_counts() {
+      group.bench_with_input(BenchmarkId::from_parameter(tids), &tids, |b, tids| b.iter_custom(|iters| {
+        let time = (0 .. iters).map(|_| eval(&book, &prog, size, *tids).1).sum::<Duration>();
+        times.insert(*tids, time / iters as u32);
+        return time;
+      }));
+    }
+    group.finish();
+    show_scaling(&format!("interpreted/{}", name), cost, &times);
+  }
+}
+
+fn compiled(c: &mut Criterion) {
+  if std::env::var("HVM_BENCH_COMPILED").map_or(true, |x| x != "1") {
+    return;
+  }
+  for (name, file, call) in EXAMPLES {
+    let bin = build_compiled(name, file);
+    let (cost, _) = run_compiled(&bin, name, call, 1);
+    let mut times = HashMap::new();
+    let mut group = c.benchmark_group(format!("compiled/{}", name));
+    group.sample_size(10);
+    group.throughput(Throughput::Elements(cost));
+    for tids in thread_counts() {
+      group.bench_with_input(BenchmarkId::from_parameter(tids), &tids, |b, tids| b.iter_custom(|iters| {
+        let time = (0 .. iters).map(|_| run_compiled(&bin, name, call, *tids).1).sum::<Duration>();
+        times.insert(*tids, time / iters as u32);
+        return time;
+      }));
+    }
+    group.finish();
+    show_scaling(&format!("compiled/{}", name), cost, &times);
+  }
+}
+
+criterion_group!(benches, interpreted, compiled);
+criterion_main!(benches);
@@ -0,0 +1,262 @@
+// Rule Benchmarks
+// ---------------
+// Microbenchmarks of the runtime's building blocks: the allocator, the redex bag, the visit queue,
+// the array kernels, `alloc_body` and each rewrite rule. A rewrite is measured by allocating a batch of terms whose
+// redex sits at a known location, then timing only the calls to the rule's `apply` over the batch;
+// building and collecting the terms isn't counted. Run with `cargo bench --bench rules`.
+
+use criterion::{black_box, criterion_group, criterion_main, BatchSize, Criterion, Throughput};
+use hvm::language;
+use hvm::runtime::{*};
+use std::time::{Duration, Instant};
+
+// Terms built (and collected) at once, outside of the timed section
+const BATCH : u64 = 1 << 10;
+
+// Defines the function used by the FUN rules and the constructors used by the terms below
+const CODE : &str = "
+  (Foo (Pair a b)) = (Cons (+ a 1) (Cons λx (x b) Nil))
+";
+
+struct Fixture {
+  book: language::rulebook::RuleBook,
+  prog: Program,
+  heap: Heap,
+}
+
+fn fixture(code: &str, mode: AllocMode) -> Fixture {
+  let file = language::syntax::read_file(code).unwrap();
+  let book = language::rulebook::gen_rulebook(&file);
+  let mut prog = Program::new();
+  prog.add_book(&book);
+  let heap = new_heap(1 << 24, 1, mode);
+  return Fixture { book, prog, heap };
+}
+
+// Allocates `term`, returning the location of its host
+fn alloc_code(fix: &Fixture, term: &str) -> u64 {
+  let term = language::syntax::read_term(term).unwrap();
+  return alloc_term(&fix.heap, &fix.prog, 0, &fix.book, &term);
+}
+
+// Calls `rule` with a context for the term at `host`, as the reducer would
+fn with_ctx(fix: &Fixture, host: u64, rule: impl FnOnce(ReduceCtx) -> bool) -> bool {
+  let heap = &fix.heap;
+  let term = load_ptr(heap, host);
+  let mut cont = REDEX_CONT_RET;
+  let mut host = host;
+  return rule(ReduceCtx { heap, prog: &fix.prog, tid: 0, hold: true, term, visit: &heap.vstk[0], redex: &heap.rbag, cont: &mut cont, host: &mut host });
+}
+
+fn app_rule(fix: &Fixture, host: u64) -> bool {
+  return with_ctx(fix, host, app::apply);
+}
+
+fn dup_rule(fix: &Fixture, host: u64) -> bool {
+  let term = load_ptr(&fix.heap, host);
+  acquire_lock(&fix.heap, 0, term).ok();
+  let done = with_ctx(fix, host, dup::apply);
+  // A dup that was rewritten was freed, which released its lock
+  if !done {
+    release_lock(&fix.heap, 0, term);
+  }
+  return done;
+}
+
+fn op2_rule(fix: &Fixture, host: u64) -> bool {
+  return with_ctx(fix, host, op2::apply);
+}
+
+fn fun_rule(fix: &Fixture, host: u64) -> bool {
+  let fid = get_ext(load_ptr(&fix.heap, host));
+  match fix.prog.funs.get(&fid) {
+    Some(Function::Interpreted { visit, apply, .. }) => {
+      return with_ctx(fix, host, |ctx| fun::apply(ctx, fid, visit, apply));
+    }
+    _ => {
+      return false;
+    }
+  }
+}
+
+// (name, term, argument path from the root to the redex, rule)
+const RULES : &[(&str, &str, &[u64], fn(&Fixture, u64) -> bool)] = &[
+  ("APP-LAM"    , "((λx (Pair x x)) 7)"                     , &[] , app_rule),
+  ("APP-SUP"    , "({(λx x) (λy y)} 7)"                     , &[] , app_rule),
+  ("DUP-LAM"    , "dup a b = λx (Cons x Nil); (Pair a b)"   , &[0], dup_rule),
+  ("DUP-SUP-NE" , "dup a b = {1 2}; (Pair a b)"             , &[0], dup_rule),
+  ("DUP-U60"    , "dup a b = 7; (Pair a b)"                 , &[0], dup_rule),
+  ("DUP-F60"    , "dup a b = 7.5; (Pair a b)"               , &[0], dup_rule),
+  ("DUP-CTR"    , "dup a b = (Pair 1 2); (Pair a b)"        , &[0], dup_rule),
+  ("OP2-U60"    , "(+ 2 3)"                                 , &[] , op2_rule),
+  ("OP2-F60"    , "(+ 2.5 3.5)"                             , &[] , op2_rule),
+  ("OP2-SUP-0"  , "(+ {1 2} 3)"                             , &[] , op2_rule),
+  ("OP2-SUP-1"  , "(+ 3 {1 2})"                             , &[] , op2_rule),
+  ("FUN-CTR"    , "(Foo (Pair 1 2))"                        , &[] , fun_rule),
+  ("FUN-SUP"    , "(Foo {(Pair 1 2) (Pair 3 4)})"           , &[] , fun_rule),
+];
+
+// Runs `iters` rewrites of `term`, BATCH at a time, returning the time spent inside `rule`
+fn time_rule(fix: &Fixture, term: &str, path: &[u64], rule: fn(&Fixture, u64) -> bool, iters: u64) -> Duration {
+  let heap = &fix.heap;
+  let mut time = Duration::ZERO;
+  let mut left = iters;
+  while left > 0 {
+    let size = std::cmp::min(left, BATCH);
+    let roots = (0 .. size).map(|_| alloc_code(fix, term)).collect::<Vec<u64>>();
+    let hosts = roots.iter().map(|root| path.iter().fold(*root, |host, arg| get_loc(load_ptr(heap, host), *arg))).collect::<Vec<u64>>();
+    let init = Instant::now();
+    for host in &hosts {
+      black_box(rule(fix, *host));
+    }
+    time += init.elapsed();
+    for root in roots {
+      collect(heap, &fix.prog.aris, 0, load_ptr(heap, root));
+      free(heap, 0, root, 1);
+    }
+    left -= size;
+  }
+  return time;
+}
+
+fn rules(c: &mut Criterion) {
+  let fix = fixture(CODE, AllocMode::Scan);
+  let mut group = c.benchmark_group("rule");
+  group.throughput(Throughput::Elements(1));
+  for (name, term, path, rule) in RULES {
+    group.bench_function(*name, |b| b.iter_custom(|iters| time_rule(&fix, term, path, *rule, iters)));
+  }
+  group.finish();
+}
+
+fn alloc_body_bench(c: &mut Criterion) {
+  let fix = fixture(CODE, AllocMode::Scan);
+  let heap = &fix.heap;
+  let fid = *fix.book.name_to_id.get("Foo").unwrap();
+  let rule = match fix.prog.funs.get(&fid) {
+    Some(Function::Interpreted { apply, .. }) => &apply.rules[0],
+    _ => panic!("Foo isn't interpreted"),
+  };
+  let mut group = c.benchmark_group("program");
+  group.throughput(Throughput::Elements(1));
+  group.bench_function("alloc_body", |b| b.iter_custom(|iters| {
+    let mut time = Duration::ZERO;
+    let mut left = iters;
+    while left > 0 {
+      let size = std::cmp::min(left, BATCH);
+      let roots = (0 .. size).map(|_| alloc_code(&fix, "(Foo (Pair 1 2))")).collect::<Vec<u64>>();
+      let mut dones = Vec::with_capacity(size as usize);
+      let init = Instant::now();
+      for root in &roots {
+        dones.push(alloc_body(heap, &fix.prog, 0, load_ptr(heap, *root), &rule.vars, &rule.body));
+      }
+      time += init.elapsed();
+      // The body took the pair's fields, so the matched nodes are freed rather than collected
+      for (root, done) in roots.iter().zip(dones) {
+        let term = load_ptr(heap, *root);
+        collect(heap, &fix.prog.aris, 0, done);
+        free(heap, 0, get_loc(load_arg(heap, term, 0), 0), 2);
+        free(heap, 0, get_loc(term, 0), 1);
+        free(heap, 0, *root, 1);
+      }
+      left -= size;
+    }
+    return time;
+  }));
+  group.finish();
+}
+
+fn memory(c: &mut Criterion) {
+  let mut group = c.benchmark_group("memory");
+  group.throughput(Throughput::Elements(1));
+  for (name, mode) in [("scan", AllocMode::Scan), ("arena", AllocMode::Arena)] {
+    let heap = new_heap(1 << 24, 1, mode);
+    group.bench_function(format!("alloc_free/{}", name), |b| b.iter(|| {
+      let loc = alloc(&heap, 0, 3);
+      free(&heap, 0, black_box(loc), 3);
+    }));
+  }
+  // Fresh heaps, so that allocations go through the scanner instead of a free list
+  let size = 1 << 12;
+  group.throughput(Throughput::Elements(size));
+  group.bench_function("alloc_scan", |b| b.iter_batched(|| new_heap(1 << 20, 1, AllocMode::Scan), |heap| {
+    for _ in 0 .. size {
+      let loc = alloc(&heap, 0, 2);
+      link(&heap, loc, Era());
+      link(&heap, loc + 1, Era());
+    }
+    return heap;
+  }, BatchSize::PerIteration));
+  group.finish();
+}
+
+fn redex_bag(c: &mut Criterion) {
+  let redex = RedexBag::new(1);
+  let mut group = c.benchmark_group("redex_bag");
+  group.throughput(Throughput::Elements(1));
+  group.bench_function("insert_complete", |b| b.iter(|| {
+    let goup = redex.insert(0, new_redex(1, REDEX_CONT_RET, 1));
+    return black_box(redex.complete(0, goup));
+  }));
+  group.bench_function("insert_complete_2", |b| b.iter(|| {
+    let goup = redex.insert(0, new_redex(1, REDEX_CONT_RET, 2));
+    black_box(redex.complete(0, goup));
+    return black_box(redex.complete(0, goup));
+  }));
+  group.finish();
+}
+
+fn visit_queue(c: &mut Criterion) {
+  let queue = VisitQueue::new();
+  let other = VisitQueue::new();
+  let mut group = c.benchmark_group("visit_queue");
+  group.throughput(Throughput::Elements(1));
+  group.bench_function("push_pop", |b| b.iter(|| {
+    queue.push(new_visit(1, false, REDEX_CONT_RET));
+    return black_box(queue.pop());
+  }));
+  group.bench_function("push_steal", |b| b.iter(|| {
+    queue.push(new_visit(1, false, REDEX_CONT_RET));
+    return black_box(queue.steal());
+  }));
+  let size = 1 << 6;
+  group.throughput(Throughput::Elements(size));
+  group.bench_function("push_steal_batch", |b| b.iter(|| {
+    for host in 0 .. size {
+      queue.push(new_visit(host, false, REDEX_CONT_RET));
+    }
+    while let Some(_) = queue.steal_batch(&other) {
+      while let Some(visit) = other.pop() {
+        black_box(visit);
+      }
+    }
+  }));
+  group.finish();
+}
+
+fn array(c: &mut Criterion) {
+  let size = 1 << 16;
+  let xs = array_bytes(&(0 .. size as u64).collect::<Vec<u64>>());
+  let ys = array_bytes(&(0 .. size as u64).map(|x| f60::new(x as f64)).collect::<Vec<u64>>());
+  let mut group = c.benchmark_group("array");
+  group.throughput(Throughput::Elements(size as u64));
+  group.bench_function("map/u60_mul", |b| b.iter(|| {
+    return black_box(array_zip(BUFFER_U60, MUL, Operand::Elems(&xs), Operand::Num(3), size));
+  }));
+  group.bench_function("zip/u60_add", |b| b.iter(|| {
+    return black_box(array_zip(BUFFER_U60, ADD, Operand::Elems(&xs), Operand::Elems(&xs), size));
+  }));
+  group.bench_function("zip/f60_mul", |b| b.iter(|| {
+    return black_box(array_zip(BUFFER_F60, MUL, Operand::Elems(&ys), Operand::Elems(&ys), size));
+  }));
+  group.bench_function("fold/u60_add", |b| b.iter(|| {
+    return black_box(array_fold(BUFFER_U60, ADD, 0, &xs, false));
+  }));
+  group.bench_function("fold/u60_sub", |b| b.iter(|| {
+    return black_box(array_fold(BUFFER_U60, SUB, 0, &xs, false));
+  }));
+  group.finish();
+}
+
+criterion_group!(benches, memory, redex_bag, visit_queue, array, alloc_body_bench, rules);
+criterion_main!(benches);
@@ -1,21 +1,66 @@
 use crate::language;
 use crate::runtime;
 
+// How to evaluate a term. The defaults are those of `hvm run` without flags.
+#[derive(Clone, Copy, Debug)]
+pub struct EvalOptions<'a> {
+  pub size: usize, // heap size, in 64-bit nodes
+  pub tids: usize, // threads to reduce with
+  pub alloc: runtime::AllocMode,
+  pub steal: runtime::StealMode,
+  pub cache: Option<&'a std::path::Path>, // where to cache the rulebook, if anywhere
+  pub prof: bool, // returns per-thread and per-rule counters
+  pub jit: bool, // lowers the functions to machine code first
+  pub gc: Option<f64>, // the heap use that triggers the collector, if any
+  pub tele: Option<&'a str>, // where to serve live counters, if anywhere
+  pub fold: Option<&'a std::path::Path>, // where to write the sampled stacks, if anywhere
+  pub dbug: bool, // shows each reduction step
+}
+
+impl Default for EvalOptions<'_> {
+  fn default() -> Self {
+    return EvalOptions {
+      size: runtime::default_heap_size(),
+      tids: runtime::default_heap_tids(),
+      alloc: runtime::AllocMode::Scan,
+      steal: runtime::StealMode::Random,
+      cache: None,
+      prof: false,
+      jit: false,
+      gc: None,
+      tele: None,
+      fold: None,
+      dbug: false,
+    };
+  }
+}
+
 // Evaluates a HVM term to normal form
 pub fn eval(
   file: &str,
   term: &str,
   funs: Vec<(String, runtime::Function)>,
-  size: usize,
-  tids: usize,
-  dbug: bool,
-) -> Result<(String, u64, u64), String> {
+  opts: &EvalOptions,
+) -> Result<(String, u64, u64, Option<String>), String> {
+  let mut code = Vec::new();
+  let (cost, time, prof) = eval_into(file, term, funs, opts, language::readback::ReadbackFormat::Text, &mut code)?;
+  let code = String::from_utf8(code).map_err(|e| e.to_string())?;
+  Ok((code, cost, time, prof))
+}
 
-  // Parses and reads the input file
-  let file = language::syntax::read_file(&format!("{}\nHVM_MAIN_CALL = {}", file, term))?;
+// Evaluates a HVM term to normal form, writing it to `out` as it is read back
+pub fn eval_into(
+  file: &str,
+  term: &str,
+  funs: Vec<(String, runtime::Function)>,
+  opts: &EvalOptions,
+  format: language::readback::ReadbackFormat,
+  out: &mut dyn std::io::Write,
+) -> Result<(u64, u64, Option<String>), String> {
+  let EvalOptions { size, tids, alloc, steal, cache, prof, jit, gc, tele, fold, dbug } = *opts;
 
-  // Converts the file to a Rulebook
-  let book = language::rulebook::gen_rulebook(&file);
+  // Parses the input file and converts it to a Rulebook, or loads both from the cache
+  let (book, book_funs) = runtime::load_book(&format!("{}\nHVM_MAIN_CALL = {}", file, term), cache)?;
 
   // Creates the runtime program
   let mut prog = runtime::Program::new();
@@ -23,7 +68,12 @@ pub fn eval(
   let begin = instant::Instant::now();
 
   // Adds the interpreted functions (from the Rulebook)
-  prog.add_book(&book);
+  prog.add_book_with(&book, book_funs);
+
+  // Lowers them to machine code, if asked to
+  if jit {
+    runtime::jit_program(&mut prog);
+  }
 
   // Adds the extra functions
   for (name, fun) in funs {
@@ -31,25 +81,43 @@ pub fn eval(
   }
 
   // Creates the runtime heap
-  let heap = runtime::new_heap(size, tids);
+  let mut heap = runtime::new_heap(size, tids, alloc);
+  heap.steal = steal;
+  // Stealing from the same node assumes each worker stays on its cpu, and its memory near it
+  if steal == runtime::StealMode::Socket {
+    heap.pool.pin();
+  }
+  if prof {
+    heap.prof = Some(runtime::new_prof(tids));
+  }
+  if let Some(ratio) = gc {
+    heap.gc = Some(runtime::new_collector(&heap, size, ratio));
+  }
+  if tele.is_some() || fold.is_some() {
+    heap.tele = Some(runtime::new_telemetry(tids, tele)?);
+  }
   let tids = runtime::new_tids(tids);
 
   // Allocates the main term
-  runtime::link(&heap, 0, runtime::Fun(*book.name_to_id.get("HVM_MAIN_CALL").unwrap(), 0));
-  let host = 0;
+  let host = runtime::alloc(&heap, tids[0], 1);
+  runtime::link(&heap, host, runtime::Fun(*book.name_to_id.get("HVM_MAIN_CALL").unwrap(), 0));
 
   // Normalizes it
   let init = instant::Instant::now();
   runtime::normalize(&heap, &prog, &tids, host, dbug);
   let time = init.elapsed().as_millis() as u64;
+  let prof = if prof { Some(runtime::show_profile(&heap, &prog)) } else { None };
+  if let Some(fold) = fold {
+    std::fs::write(fold, runtime::show_folded(&heap, &prog)).map_err(|e| format!("can't write the samples to '{}': {}", fold.display(), e))?;
+  }
 
-  // Reads it back to a string
-  let code = format!("{}", language::readback::as_term(&heap, &prog, host));
+  // Reads it back to the output
+  language::readback::write_term_par(&heap, &prog, &tids, host, format, out).map_err(|e| e.to_string())?;
 
   // Frees used memory
   runtime::collect(&heap, &prog.aris, tids[0], runtime::load_ptr(&heap, host));
-  runtime::free(&heap, 0, 0, 1);
+  runtime::free(&heap, tids[0], host, 1);
 
-  // Returns the result, rewrite cost and time elapsed
-  Ok((code, runtime::get_cost(&heap), time))
+  // Returns the rewrite cost, time elapsed and profile
+  Ok((runtime::get_cost(&heap), time, prof))
 }
@@ -1,5 +1,4 @@
 // TODO: optimize apply to return false when it is a ctr
-// TODO: optimize apply to realloc same arity nodes
 
 use std::collections::HashMap;
 use crate::language as language;
@@ -127,7 +126,7 @@ pub fn build_function(
     smap: fn_smap,
     visit: fn_visit,
     apply: fn_apply,
-  } = runtime::build_function(book, fname, rules) {
+  } = runtime::build_function(book, fname, rules, false) {
 
     // Visit
     // -----
@@ -205,11 +204,11 @@ pub fn build_function(
         }
       }
       // Checks if its rhs only allocs one node
-      if body.1.len() != 1 {
+      if body.node_count() != 1 {
         break 'TransmuteOptimization;
       }
       // Checks if the function and body arity match
-      let cell = &body.1[0];
+      let cell = body.node(0);
       if cell.len() != vars.len() {
         break 'TransmuteOptimization;
       }
@@ -225,7 +224,7 @@ pub fn build_function(
       }
       // Gets the new ptr
       let ptr;
-      if let runtime::RuleBodyCell::Ptr { value, targ: 0, slot: 0 } = body.0 {
+      if let runtime::RuleBodyCell::Ptr { value, targ: 0, slot: 0 } = body.root {
         ptr = value;
       } else {
         break 'TransmuteOptimization;
@@ -251,121 +250,91 @@ pub fn build_function(
         line(&mut apply, 1, &format!("let arg{} = load_arg(ctx.heap, ctx.term, {});", i, i));
       }
 
-      // Applies the fun_sup rule to superposed args
+      // Applies the fun_sup rule to superposed args, and unpacks the first character of buffers
       for (i, is_strict) in fn_visit.strict_map.iter().enumerate() {
         if *is_strict {
           line(&mut apply, 1, &format!("if get_tag(arg{}) == SUP {{", i));
           line(&mut apply, 2, &format!("fun::superpose(ctx.heap, &ctx.prog.aris, ctx.tid, *ctx.host, ctx.term, arg{}, {});", i, i));
           line(&mut apply, 1, "}");
+          line(&mut apply, 1, &format!("let arg{} = if get_tag(arg{}) == BUF {{ unpack_buffer(ctx.heap, ctx.tid, get_loc(ctx.term, {})) }} else {{ arg{} }};", i, i, i, i));
         }
       }
 
-      // For each rule condition vector
-      for (r, rule) in fn_apply.rules.iter().enumerate() {
-        let mut matched: Vec<String> = Vec::new();
-
-        // Tests each rule condition (ex: `get_tag(args[0]) == SUCC`)
-        for (i, cond) in rule.cond.iter().enumerate() {
-          let i = i as u64;
-          if runtime::get_tag(*cond) == runtime::U60 {
-            let same_tag = format!("get_tag(arg{}) == U60", i);
-            let same_val = format!("get_num(arg{}) == {}", i, runtime::get_num(*cond));
-            matched.push(format!("({} && {})", same_tag, same_val));
-          }
-          if runtime::get_tag(*cond) == runtime::F60 {
-            let same_tag = format!("get_tag(arg{}) == F60", i);
-            let same_val = format!("get_num(arg{}) == {}", i, runtime::get_num(*cond));
-            matched.push(format!("({} && {})", same_tag, same_val));
-          }
-          if runtime::get_tag(*cond) == runtime::CTR {
-            let some_tag = format!("get_tag(arg{}) == CTR", i);
-            let some_ext = format!("get_ext(arg{}) == {}", i, runtime::get_ext(*cond));
-            matched.push(format!("({} && {})", some_tag, some_ext));
-          }
-            // If this is a strict argument, then we're in a default variable
-          if runtime::get_tag(*cond) == runtime::VAR && fn_visit.strict_map[i as usize] {
-
-            // This is a Kind2-specific optimization. Check 'HOAS_OPT'.
-            if rule.hoas && r != fn_apply.rules.len() - 1 {
-
-              // Matches number literals
-              let is_num = format!("({} || {})",
-                format!("get_tag(arg{}) == U60", i),
-                format!("get_tag(arg{}) == F60", i));
-
-              // Matches constructor labels
-              let is_ctr = format!("({} && {})",
-                format!("get_tag(arg{}) == CTR", i),
-                format!("arity_of(heap, arg{}) == 0u", i));
-
-              // Matches HOAS numbers and constructors
-              let is_hoas_ctr_num = format!("({} && {} && {})",
-                format!("get_tag(arg{}) == CTR", i),
-                format!("get_ext(arg{}) >= HOAS_CT0", i),
-                format!("get_ext(arg{}) <= HOAS_F60", i));
-
-              matched.push(format!("({} || {} || {})", is_num, is_ctr, is_hoas_ctr_num));
-
-            // Only match default variables on CTRs, U60s, F60s
-            } else {
-              let is_ctr = format!("get_tag(arg{}) == CTR", i);
-              let is_u60 = format!("get_tag(arg{}) == U60", i);
-              let is_f60 = format!("get_tag(arg{}) == F60", i);
-              matched.push(format!("({} || {} || {})", is_ctr, is_u60, is_f60));
+      // Finds the matching rule with the match tree, switching on one strict argument at a time
+      if let Some(tree) = &fn_apply.tree {
+        build_match_tree_code(&mut apply, 1, "let rule : usize = ", tree, 0, ";");
+        line(&mut apply, 1, "match rule {");
+        for (r, rule) in fn_apply.rules.iter().enumerate() {
+          line(&mut apply, 2, &format!("{} => {{", r));
+          build_function_rule_apply(book, &mut apply, 3, rule, &fn_visit);
+          line(&mut apply, 2, "}");
+        }
+        line(&mut apply, 2, "_ => {}");
+        line(&mut apply, 1, "}");
+      } else {
+        // Otherwise, tests each rule condition vector
+        for (r, rule) in fn_apply.rules.iter().enumerate() {
+          let mut matched: Vec<String> = Vec::new();
+
+          // Tests each rule condition (ex: `get_tag(args[0]) == SUCC`)
+          for (i, cond) in rule.cond.iter().enumerate() {
+            let i = i as u64;
+            if runtime::get_tag(*cond) == runtime::U60 {
+              let same_tag = format!("get_tag(arg{}) == U60", i);
+              let same_val = format!("get_num(arg{}) == {}", i, runtime::get_num(*cond));
+              matched.push(format!("({} && {})", same_tag, same_val));
+            }
+            if runtime::get_tag(*cond) == runtime::F60 {
+              let same_tag = format!("get_tag(arg{}) == F60", i);
+              let same_val = format!("get_num(arg{}) == {}", i, runtime::get_num(*cond));
+              matched.push(format!("({} && {})", same_tag, same_val));
+            }
+            if runtime::get_tag(*cond) == runtime::CTR {
+              let some_tag = format!("get_tag(arg{}) == CTR", i);
+              let some_ext = format!("get_ext(arg{}) == {}", i, runtime::get_ext(*cond));
+              matched.push(format!("({} && {})", some_tag, some_ext));
             }
+              // If this is a strict argument, then we're in a default variable
+            if runtime::get_tag(*cond) == runtime::VAR && fn_visit.strict_map[i as usize] {
+
+              // This is a Kind2-specific optimization. Check 'HOAS_OPT'.
+              if rule.hoas && r != fn_apply.rules.len() - 1 {
+
+                // Matches number literals
+                let is_num = format!("({} || {})",
+                  format!("get_tag(arg{}) == U60", i),
+                  format!("get_tag(arg{}) == F60", i));
+
+                // Matches constructor labels
+                let is_ctr = format!("({} && {})",
+                  format!("get_tag(arg{}) == CTR", i),
+                  format!("arity_of(heap, arg{}) == 0u", i));
+
+                // Matches HOAS numbers and constructors
+                let is_hoas_ctr_num = format!("({} && {} && {})",
+                  format!("get_tag(arg{}) == CTR", i),
+                  format!("get_ext(arg{}) >= HOAS_CT0", i),
+                  format!("get_ext(arg{}) <= HOAS_F60", i));
+
+                matched.push(format!("({} || {} || {})", is_num, is_ctr, is_hoas_ctr_num));
+
+              // Only match default variables on CTRs, U60s, F60s
+              } else {
+                let is_ctr = format!("get_tag(arg{}) == CTR", i);
+                let is_u60 = format!("get_tag(arg{}) == U60", i);
+                let is_f60 = format!("get_tag(arg{}) == F60", i);
+                matched.push(format!("({} || {} || {})", is_ctr, is_u60, is_f60));
+              }
 
+            }
           }
-        }
-
-        let conds = if matched.is_empty() { String::from("true") } else { matched.join(" && ") };
-        line(&mut apply, 1, &format!("if {} {{", conds));
 
-        // Increments the gas count
-        line(&mut apply, 2, "inc_cost(ctx.heap, ctx.tid);");
+          let conds = if matched.is_empty() { String::from("true") } else { matched.join(" && ") };
+          line(&mut apply, 1, &format!("if {} {{", conds));
 
-        // Builds the free vector
-        let mut free : Vec<Option<(String,u64)>> = vec![];
-        for (idx, ari) in &rule.free {
-          free.push(Some((format!("get_loc(arg{}, 0)", idx), *ari)));
-        }
-        free.push(Some(("get_loc(ctx.term, 0)".to_string(), fn_visit.strict_map.len() as u64)));
-
-        // Builds the right-hand side term (ex: `(Succ (Add a b))`)
-        //let done = build_function_rule_body(&mut apply, 2, &rule.body, &rule.vars);
-        let done = build_function_rule_rhs(book, &mut apply, &mut free, 2, &rule.core, &rule.vars);
-        line(&mut apply, 2, &format!("let done = {};", done));
-
-        // Links the host location to it
-        line(&mut apply, 2, "link(ctx.heap, *ctx.host, done);");
-
-        // Collects unused variables (none in this example)
-        for dynvar @ runtime::RuleVar { param: _, field: _, erase } in rule.vars.iter() {
-          if *erase {
-            line(&mut apply, 2, &format!("collect(ctx.heap, &ctx.prog.aris, ctx.tid, {});", get_var(dynvar)));
-          }
-        }
-
-        // Clears the matched ctrs (the `(Succ ...)` and the `(Add ...)` ctrs)
-        for must_free in &free {
-          if let Some((loc, ari)) = must_free {
-            line(&mut apply, 2, &format!("free(ctx.heap, ctx.tid, {}, {});", loc, ari));
-          }
+          build_function_rule_apply(book, &mut apply, 2, rule, &fn_visit);
+          line(&mut apply, 1, "}");
         }
-        
-        //for (i, arity) in &rule.free {
-          //let i = *i as u64;
-          //line(&mut apply, 2, &format!("free(ctx.heap, ctx.tid, get_loc(arg{}, 0), {});", i, arity));
-        //}
-        //line(&mut apply, 2, &format!("free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), {});", fn_visit.strict_map.len()));
-        
-        let ret_ptr = match rule.body.0 {
-          runtime::RuleBodyCell::Val { value }     => value,
-          runtime::RuleBodyCell::Ptr { value, .. } => value,
-          runtime::RuleBodyCell::Var { .. }        => runtime::Var(0),
-        };
-        line(&mut apply, 2, &format!("return {};", if runtime::is_whnf(ret_ptr) { "false" } else { "true" }));
-        //line(&mut apply, 2, &format!("return true;"));
-        line(&mut apply, 1, "}");
       }
       line(&mut apply, 1, "return false;");
 
@@ -378,6 +347,95 @@ pub fn build_function(
   }
 }
 
+// Emits the match tree as nested `match` expressions on the arguments' tags, constructor ids and
+// numbers, evaluating to the index of the matching rule, or usize::MAX if none matches
+pub fn build_match_tree_code(code: &mut String, tab: u64, head: &str, tree: &[runtime::MatchNode], node: usize, tail: &str) {
+  match &tree[node] {
+    runtime::MatchNode::Leaf { rule } => {
+      line(code, tab, &format!("{}{}{}", head, rule.map_or("usize::MAX".to_string(), |r| r.to_string()), tail));
+    }
+    runtime::MatchNode::Switch { arg, cases, other } => {
+      line(code, tab, &format!("{}match get_tag(arg{}) {{", head, arg));
+      let mut rest = vec![];
+      for (tag, name, get) in [(runtime::CTR, "CTR", "get_ext"), (runtime::U60, "U60", "get_num"), (runtime::F60, "F60", "get_num")] {
+        let tag_cases = cases.iter().filter(|(key, _)| runtime::get_tag(*key) == tag).collect::<Vec<&(u64, usize)>>();
+        if tag_cases.is_empty() {
+          rest.push(name);
+        } else {
+          line(code, tab + 1, &format!("{} => match {}(arg{}) {{", name, get, arg));
+          for (key, case) in tag_cases {
+            let val = if tag == runtime::CTR { runtime::get_ext(*key) } else { runtime::get_num(*key) };
+            build_match_tree_code(code, tab + 2, &format!("{} => ", val), tree, *case, ",");
+          }
+          build_match_tree_code(code, tab + 2, "_ => ", tree, *other, ",");
+          line(code, tab + 1, "},");
+        }
+      }
+      if !rest.is_empty() {
+        build_match_tree_code(code, tab + 1, &format!("{} => ", rest.join(" | ")), tree, *other, ",");
+      }
+      line(code, tab + 1, "_ => usize::MAX,");
+      line(code, tab, &format!("}}{}", tail));
+    }
+  }
+}
+
+// Builds the rewrite of a rule that matched: allocates its body, links it to the host, collects
+// its erased variables and frees the matched nodes
+pub fn build_function_rule_apply(
+  book     : &language::rulebook::RuleBook,
+  code     : &mut String,
+  tab      : u64,
+  rule     : &runtime::program::Rule,
+  fn_visit : &runtime::VisitObj,
+) {
+  // Increments the gas count
+  line(code, tab, "inc_cost(ctx.heap, ctx.tid);");
+
+  // Builds the free vector
+  let mut free : Vec<Option<(String,u64)>> = vec![];
+  for (idx, ari) in &rule.free {
+    free.push(Some((format!("get_loc(arg{}, 0)", idx), *ari)));
+  }
+  free.push(Some(("get_loc(ctx.term, 0)".to_string(), fn_visit.strict_map.len() as u64)));
+
+  // Builds the right-hand side term (ex: `(Succ (Add a b))`)
+  //let done = build_function_rule_body(&mut apply, 2, &rule.body, &rule.vars);
+  let done = build_function_rule_rhs(book, code, &mut free, tab, &rule.core, &rule.vars);
+  line(code, tab, &format!("let done = {};", done));
+
+  // Links the host location to it
+  line(code, tab, "link(ctx.heap, *ctx.host, done);");
+
+  // Collects unused variables (none in this example)
+  for dynvar @ runtime::RuleVar { param: _, field: _, erase } in rule.vars.iter() {
+    if *erase {
+      line(code, tab, &format!("collect(ctx.heap, &ctx.prog.aris, ctx.tid, {});", get_var(dynvar)));
+    }
+  }
+
+  // Clears the matched ctrs (the `(Succ ...)` and the `(Add ...)` ctrs)
+  for must_free in &free {
+    if let Some((loc, ari)) = must_free {
+      line(code, tab, &format!("free(ctx.heap, ctx.tid, {}, {});", loc, ari));
+    }
+  }
+  
+  //for (i, arity) in &rule.free {
+    //let i = *i as u64;
+    //line(code, tab, &format!("free(ctx.heap, ctx.tid, get_loc(arg{}, 0), {});", i, arity));
+  //}
+  //line(code, tab, &format!("free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), {});", fn_visit.strict_map.len()));
+  
+  let ret_ptr = match rule.body.root {
+    runtime::RuleBodyCell::Val { value }     => value,
+    runtime::RuleBodyCell::Ptr { value, .. } => value,
+    runtime::RuleBodyCell::Var { .. }        => runtime::Var(0),
+  };
+  line(code, tab, &format!("return {};", if runtime::is_whnf(ret_ptr) { "false" } else { "true" }));
+  //line(code, tab, &format!("return true;"));
+}
+
 pub fn build_function_rule_rhs(
   book : &language::rulebook::RuleBook,
   code : &mut String,
@@ -422,7 +480,8 @@ pub fn build_function_rule_rhs(
       let coln = fresh(nams, "col");
       let name = fresh(nams, "dup");
       line(code, tab + 1, &format!("let {} = gen_dup(ctx.heap, ctx.tid);", coln));
-      line(code, tab + 1, &format!("let {} = {};", name, alloc_node(free, 3)));
+      line(code, tab + 1, &format!("let {} = {};", name, alloc_node(free, 4)));
+      line(code, tab + 1, &format!("open_lock(ctx.heap, {});", name));
       line(code, tab, &format!("link(ctx.heap, {} + 0, Era());", name)); // FIXME: remove when possible (same as above)
       line(code, tab, &format!("link(ctx.heap, {} + 1, Era());", name)); // FIXME: remove when possible (same as above)
       if glob != 0 {
@@ -5,7 +5,10 @@ mod compile;
 
 pub fn compile(code: &str, name: &str) -> std::io::Result<()> {
   
-  let cargo_rs = include_str!("./../../Cargo.toml")
+  // The benchmarks (and their dependencies) aren't copied, so their section is left out
+  let cargo_rs = include_str!("./../../Cargo.toml");
+  let cargo_rs = cargo_rs.split("\n# Benchmarks").next().unwrap_or(cargo_rs).to_string() + "\n";
+  let cargo_rs = cargo_rs
     .replace("name = \"hvm\"", &format!("name = \"{}\"", name))
     .replace("name = \"hvm\"", &format!("name = \"{}\"", name));
 
@@ -29,6 +32,7 @@ pub fn compile(code: &str, name: &str) -> std::io::Result<()> {
   std::fs::create_dir(format!("./{}/src/language",name)).ok();
   std::fs::write(format!("./{}/src/language/mod.rs",name)      , include_str!("./../language/mod.rs"))?;
   std::fs::write(format!("./{}/src/language/parser.rs",name)   , include_str!("./../language/parser.rs"))?;
+  std::fs::write(format!("./{}/src/language/reader.rs",name)   , include_str!("./../language/reader.rs"))?;
   std::fs::write(format!("./{}/src/language/readback.rs",name) , include_str!("./../language/readback.rs"))?;
   std::fs::write(format!("./{}/src/language/rulebook.rs",name) , include_str!("./../language/rulebook.rs"))?;
   std::fs::write(format!("./{}/src/language/syntax.rs",name)   , include_str!("./../language/syntax.rs"))?;
@@ -41,11 +45,19 @@ pub fn compile(code: &str, name: &str) -> std::io::Result<()> {
   let (precomp_rs, reducer_rs) = compile::build_code(code).unwrap();
   std::fs::create_dir(format!("./{}/src/runtime/base",name)).ok();
   std::fs::write(format!("./{}/src/runtime/base/mod.rs",name)     , include_str!("./../runtime/base/mod.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/base/array.rs",name)   , include_str!("./../runtime/base/array.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/base/buffer.rs",name)  , include_str!("./../runtime/base/buffer.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/base/cache.rs",name)   , include_str!("./../runtime/base/cache.rs"))?;
   std::fs::write(format!("./{}/src/runtime/base/debug.rs",name)   , include_str!("./../runtime/base/debug.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/base/gc.rs",name)      , include_str!("./../runtime/base/gc.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/base/jit.rs",name)     , include_str!("./../runtime/base/jit.rs"))?;
   std::fs::write(format!("./{}/src/runtime/base/memory.rs",name)  , include_str!("./../runtime/base/memory.rs"))?;
   std::fs::write(format!("./{}/src/runtime/base/precomp.rs",name) , precomp_rs)?;
+  std::fs::write(format!("./{}/src/runtime/base/profile.rs",name) , include_str!("./../runtime/base/profile.rs"))?;
   std::fs::write(format!("./{}/src/runtime/base/program.rs",name) , include_str!("./../runtime/base/program.rs"))?;
   std::fs::write(format!("./{}/src/runtime/base/reducer.rs",name) , reducer_rs)?;
+  std::fs::write(format!("./{}/src/runtime/base/snapshot.rs",name), include_str!("./../runtime/base/snapshot.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/base/telemetry.rs",name), include_str!("./../runtime/base/telemetry.rs"))?;
 
   // hvm/src/runtime/data
   std::fs::create_dir(format!("./{}/src/runtime/data",name)).ok();
@@ -53,9 +65,17 @@ pub fn compile(code: &str, name: &str) -> std::io::Result<()> {
   std::fs::write(format!("./{}/src/runtime/data/f60.rs",name)         , include_str!("./../runtime/data/f60.rs"))?;
   std::fs::write(format!("./{}/src/runtime/data/allocator.rs",name)   , include_str!("./../runtime/data/allocator.rs"))?;
   std::fs::write(format!("./{}/src/runtime/data/barrier.rs",name)     , include_str!("./../runtime/data/barrier.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/data/buffer_store.rs",name), include_str!("./../runtime/data/buffer_store.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/data/label_space.rs",name) , include_str!("./../runtime/data/label_space.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/data/mem_map.rs",name)     , include_str!("./../runtime/data/mem_map.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/data/memo_table.rs",name)  , include_str!("./../runtime/data/memo_table.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/data/park.rs",name)        , include_str!("./../runtime/data/park.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/data/pool.rs",name)        , include_str!("./../runtime/data/pool.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/data/reactor.rs",name)     , include_str!("./../runtime/data/reactor.rs"))?;
   std::fs::write(format!("./{}/src/runtime/data/redex_bag.rs",name)   , include_str!("./../runtime/data/redex_bag.rs"))?;
   std::fs::write(format!("./{}/src/runtime/data/u60.rs",name)         , include_str!("./../runtime/data/u60.rs"))?;
   std::fs::write(format!("./{}/src/runtime/data/u64_map.rs",name)     , include_str!("./../runtime/data/u64_map.rs"))?;
+  std::fs::write(format!("./{}/src/runtime/data/victims.rs",name)     , include_str!("./../runtime/data/victims.rs"))?;
   std::fs::write(format!("./{}/src/runtime/data/visit_queue.rs",name) , include_str!("./../runtime/data/visit_queue.rs"))?;
 
   // hvm/src/runtime/rule
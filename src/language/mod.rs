@@ -1,4 +1,5 @@
 pub mod parser;
+pub mod reader;
 pub mod readback;
 pub mod rulebook;
 pub mod syntax;
@@ -208,6 +208,9 @@ pub fn as_term(heap: &Heap, prog: &Program, host: u64) -> Box<language::syntax::
         let name = ctx.prog.nams.get(&func).map(String::to_string).unwrap_or_else(|| format!("${}", func));
         return Box::new(language::syntax::Term::Ctr { name, args });
       }
+      runtime::BUF => {
+        return Box::new(buffer_term(ctx.heap, term));
+      }
       runtime::VAR => {
         let name = ctx.names.get(&term).map(String::to_string).unwrap_or_else(|| format!("^{}", runtime::get_loc(term, 0)));
         return Box::new(language::syntax::Term::Var { name }); // ............... /\ why this sounds so threatening?
@@ -237,6 +240,33 @@ pub fn as_term(heap: &Heap, prog: &Program, host: u64) -> Box<language::syntax::
   readback(heap, prog, ctx, &mut stacks, term, 0)
 }
 
+// The `String.cons` list a buffer stands for, or the `Array.pack` call that builds an array
+fn buffer_term(heap: &Heap, term: Ptr) -> language::syntax::Term {
+  let bytes = runtime::get_buffer_bytes(heap, term);
+  if runtime::get_buffer_kind(term) != runtime::BUFFER_BYTES {
+    let is_f60 = runtime::get_buffer_kind(term) == runtime::BUFFER_F60;
+    let mut list = language::syntax::Term::Ctr { name: "List.nil".to_string(), args: vec![] };
+    for numb in runtime::get_array_elems(bytes).collect::<Vec<u64>>().into_iter().rev() {
+      let head = Box::new(if is_f60 { language::syntax::Term::F6O { numb } } else { language::syntax::Term::U6O { numb } });
+      list = language::syntax::Term::Ctr { name: "List.cons".to_string(), args: vec![head, Box::new(list)] };
+    }
+    return language::syntax::Term::Ctr { name: "Array.pack".to_string(), args: vec![Box::new(list)] };
+  }
+  let mut chrs = Vec::new();
+  let mut init = 0;
+  while init < bytes.len() {
+    let (chr, size) = runtime::buffer_char(&bytes[init ..]);
+    chrs.push(chr);
+    init += size;
+  }
+  let mut term = language::syntax::Term::Ctr { name: "String.nil".to_string(), args: vec![] };
+  for numb in chrs.into_iter().rev() {
+    let head = Box::new(language::syntax::Term::U6O { numb });
+    term = language::syntax::Term::Ctr { name: "String.cons".to_string(), args: vec![head, Box::new(term)] };
+  }
+  return term;
+}
+
 // Reads a term linearly, i.e., preserving dups
 pub fn as_linear_term(heap: &Heap, prog: &Program, host: u64) -> Box<language::syntax::Term> {
   enum StackItem {
@@ -426,6 +456,9 @@ pub fn as_linear_term(heap: &Heap, prog: &Program, host: u64) -> Box<language::s
               let numb = runtime::get_num(term);
               output.push(language::syntax::Term::F6O { numb });
             }
+            runtime::BUF => {
+              output.push(buffer_term(heap, term));
+            }
             runtime::CTR => {
               let arit = runtime::arity_of(&prog.aris, term);
               stack.push(StackItem::Resolver(term));
@@ -459,6 +492,660 @@ pub fn as_linear_code(heap: &Heap, prog: &Program, host: u64) -> String {
 }
 
 
+// Streaming Readback
+// ------------------
+// Writes a term from Runtime's memory straight to a sink, without building a `syntax::Term`. The
+// text form matches `as_code`, except that variables are numbered in the order they're written.
+// The walk keeps its own stack of tasks, so deep terms don't overflow, and the tail of a list or
+// of a constructor's last field doesn't grow it.
+//
+// The binary form is the magic "HVMB", a version byte (1), then the term in prefix order. Every
+// number is a LEB128 varint. Dups and sups are resolved as in the text form.
+//
+//   byte | node | followed by
+//   ---- | ---- | ---------------------------------------------------------------------
+//   0x00 | VAR  | the variable's index
+//   0x01 | LAM  | the variable's index plus one, or 0 if erased; then the body
+//   0x02 | APP  | the function and the argument
+//   0x03 | SUP  | both sides
+//   0x04 | CTR  | the name's index, the arity and the fields
+//   0x05 | CTR  | the name's index, its length, its UTF-8 bytes, the arity and the fields
+//   0x06 | U60  | the number
+//   0x07 | F60  | the number's 60 bits
+//   0x08 | OP2  | the operator (ADD = 0 ... NEQ = 15), then both operands
+//   0x09 | ERA  |
+//   0x0A | ARG  |
+//   0x0B | ?    | the runtime tag
+//   0x0C | BUF  | the number of bytes, then the bytes
+//   0x0D | BUF  | the elements' tag (0x06 or 0x07), the number of elements, then the numbers
+//
+// A name's first use is 0x05, which gives it the next index, starting at 0. Later uses are 0x04.
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum ReadbackFormat {
+  Text,
+  Binary,
+}
+
+// A change to the dup stacks, which the matching task undoes once its scope ends
+#[derive(Clone, Copy)]
+enum Undo {
+  Pop(u64),
+  Push(u64, bool),
+}
+
+#[derive(Clone, Copy)]
+enum Task {
+  Term(Ptr),
+  Text(&'static str),
+  Undo(Undo),
+  List(Ptr),   // the tail of a list, after its first element
+  Part(usize), // a task split off to another part (see `write_term_par`)
+}
+
+// What goes where the index of a variable or of a name is written, which depends on everything
+// written before it, so a part of a parallel readback leaves a hole there instead
+#[derive(Clone, Copy)]
+enum Hole {
+  Var(u64),    // the variable bound at this location
+  Lam(u64),    // the same, as the binder of a binary lambda, which writes it plus one
+  Ctr(u64),    // the name of this constructor, in the binary form
+  Part(usize), // the output of another part
+}
+
+type Stacks = HashMap<u64, Vec<bool>>;
+
+fn undo_on(stacks: &mut Stacks, undo: Undo) {
+  match undo {
+    Undo::Pop(col) => { stacks.entry(col).or_insert_with(Vec::new).pop(); }
+    Undo::Push(col, val) => { stacks.entry(col).or_insert_with(Vec::new).push(val); }
+  }
+}
+
+fn varint(out: &mut Vec<u8>, numb: u64) {
+  let mut numb = numb;
+  loop {
+    let byte = (numb & 0x7F) as u8;
+    numb >>= 7;
+    if numb == 0 {
+      out.push(byte);
+      return;
+    }
+    out.push(byte | 0x80);
+  }
+}
+
+// Numbers variables and names in the order they're written
+struct Names {
+  vars: HashMap<u64, u64>,
+  ctrs: HashMap<u64, u64>,
+}
+
+impl Names {
+  fn new() -> Names {
+    return Names { vars: HashMap::new(), ctrs: HashMap::new() };
+  }
+
+  fn fill(&mut self, prog: &Program, format: ReadbackFormat, hole: Hole, out: &mut Vec<u8>) {
+    match hole {
+      Hole::Var(loc) | Hole::Lam(loc) => {
+        let next = self.vars.len() as u64;
+        let var = *self.vars.entry(loc).or_insert(next);
+        match format {
+          ReadbackFormat::Text => out.extend_from_slice(var.to_string().as_bytes()),
+          ReadbackFormat::Binary => varint(out, if let Hole::Lam(_) = hole { var + 1 } else { var }),
+        }
+      }
+      Hole::Ctr(fid) => {
+        let next = self.ctrs.len() as u64;
+        match self.ctrs.entry(fid) {
+          hash_map::Entry::Occupied(e) => {
+            out.push(0x04);
+            varint(out, *e.get());
+          }
+          hash_map::Entry::Vacant(e) => {
+            e.insert(next);
+            let name = prog.nams.get(&fid).map(String::from).unwrap_or_else(|| format!("${}", fid));
+            out.push(0x05);
+            varint(out, next);
+            varint(out, name.len() as u64);
+            out.extend_from_slice(name.as_bytes());
+          }
+        }
+      }
+      Hole::Part(_) => {}
+    }
+  }
+}
+
+struct Writer<'a> {
+  heap: &'a Heap,
+  prog: &'a Program,
+  format: ReadbackFormat,
+  stacks: Stacks,
+  log: Vec<Undo>,
+  names: Option<Names>,      // None in a part of a parallel readback, which leaves holes instead
+  holes: Vec<(usize, Hole)>, // the holes left, at their offsets in the output
+}
+
+impl<'a> Writer<'a> {
+  fn new(heap: &'a Heap, prog: &'a Program, format: ReadbackFormat, stacks: Stacks, names: Option<Names>) -> Writer<'a> {
+    return Writer { heap, prog, format, stacks, log: Vec::new(), names, holes: Vec::new() };
+  }
+
+  fn undo(&mut self, undo: Undo) {
+    undo_on(&mut self.stacks, undo);
+  }
+
+  // Undoes the changes logged since `mark`, right away
+  fn rewind(&mut self, mark: usize) {
+    while self.log.len() > mark {
+      let undo = self.log.pop().unwrap();
+      self.undo(undo);
+    }
+  }
+
+  // Undoes the changes logged since `mark` once the tasks pushed after these are done
+  fn defer(&mut self, mark: usize, tasks: &mut Vec<Task>) {
+    for undo in &self.log[mark ..] {
+      tasks.push(Task::Undo(*undo));
+    }
+    self.log.truncate(mark);
+  }
+
+  // Follows dups, and sups that one of them selects a side of, logging the stack changes
+  fn resolve(&mut self, term: Ptr) -> Ptr {
+    let mut term = term;
+    loop {
+      match runtime::get_tag(term) {
+        runtime::DP0 | runtime::DP1 => {
+          let col = runtime::get_ext(term);
+          self.stacks.entry(col).or_insert_with(Vec::new).push(runtime::get_tag(term) == runtime::DP1);
+          self.log.push(Undo::Pop(col));
+          term = runtime::load_arg(self.heap, term, 2);
+        }
+        runtime::SUP => {
+          let col = runtime::get_ext(term);
+          match self.stacks.get_mut(&col).and_then(|stack| stack.pop()) {
+            Some(val) => {
+              self.log.push(Undo::Push(col, val));
+              term = runtime::load_arg(self.heap, term, val as u64);
+            }
+            None => {
+              return term;
+            }
+          }
+        }
+        _ => {
+          return term;
+        }
+      }
+    }
+  }
+
+  // Writes the index of a variable or name, or leaves a hole for it
+  fn put(&mut self, hole: Hole, out: &mut Vec<u8>) {
+    match &mut self.names {
+      Some(names) => names.fill(self.prog, self.format, hole, out),
+      None => self.holes.push((out.len(), hole)),
+    }
+  }
+
+  fn name(&self, term: Ptr) -> Option<&'a str> {
+    return self.prog.nams.get(&runtime::get_ext(term)).map(|name| name.as_str());
+  }
+
+  fn is_ctr(&self, term: Ptr, name: &str, arity: u64) -> bool {
+    let tag = runtime::get_tag(term);
+    return (tag == runtime::CTR || tag == runtime::FUN) && self.name(term) == Some(name) && runtime::arity_of(&self.prog.aris, term) == arity;
+  }
+
+  // The character of a `String.cons`, if its head reads back to one
+  fn chr(&mut self, term: Ptr) -> Option<char> {
+    let mark = self.log.len();
+    let head = self.resolve(runtime::load_arg(self.heap, term, 0));
+    self.rewind(mark);
+    if runtime::get_tag(head) == runtime::U60 {
+      return std::char::from_u32(runtime::get_num(head) as u32);
+    } else {
+      return None;
+    }
+  }
+
+  // Checks if `term` is a whole `cons`/`nil` chain, of characters if `text`, as the sugars need.
+  // A chain of characters can end in a buffer, which is what's left of an unpacked one.
+  fn is_chain(&mut self, term: Ptr, cons: &str, nil: &str, text: bool) -> bool {
+    let mark = self.log.len();
+    let mut term = term;
+    let done = loop {
+      term = self.resolve(term);
+      if self.is_ctr(term, cons, 2) {
+        if text && self.chr(term).is_none() {
+          break false;
+        }
+        term = runtime::load_arg(self.heap, term, 1);
+      } else {
+        break self.is_ctr(term, nil, 0) || text && runtime::is_byte_buffer(term);
+      }
+    };
+    self.rewind(mark);
+    return done;
+  }
+
+  // Runs a task, pushing the ones it leads to
+  fn step(&mut self, task: Task, tasks: &mut Vec<Task>, out: &mut Vec<u8>) {
+    match task {
+      Task::Term(term) => {
+        match self.format {
+          ReadbackFormat::Text => text(self, tasks, term, out),
+          ReadbackFormat::Binary => binary(self, tasks, term, out),
+        }
+      }
+      Task::Text(text) => {
+        out.extend_from_slice(text.as_bytes());
+      }
+      Task::Undo(undo) => {
+        self.undo(undo);
+      }
+      Task::List(term) => {
+        let mark = self.log.len();
+        let term = self.resolve(term);
+        self.defer(mark, tasks);
+        if self.is_ctr(term, "List.cons", 2) {
+          out.extend_from_slice(b", ");
+          tasks.push(Task::List(runtime::load_arg(self.heap, term, 1)));
+          tasks.push(Task::Term(runtime::load_arg(self.heap, term, 0)));
+        }
+      }
+      Task::Part(part) => {
+        self.holes.push((out.len(), Hole::Part(part)));
+      }
+    }
+  }
+
+  // Takes the outermost term or list tail that `tasks` still has to write, which is likely the
+  // largest, for another part to write, leaving `part` in its place. Returns it with the dup
+  // stacks it must be written under, which are the current ones, once the changes that the tasks
+  // above it undo are undone. Only splits if some other term or list tail is left.
+  fn split(&self, tasks: &mut Vec<Task>, part: usize) -> Option<(Task, Stacks)> {
+    let index = tasks.iter().position(|task| matches!(task, Task::Term(_) | Task::List(_)))?;
+    if !tasks[index + 1 ..].iter().any(|task| matches!(task, Task::Term(_) | Task::List(_))) {
+      return None;
+    }
+    let mut stacks : Stacks = self.stacks.iter().filter(|(_, stack)| !stack.is_empty()).map(|(col, stack)| (*col, stack.clone())).collect();
+    for task in tasks[index + 1 ..].iter().rev() {
+      if let Task::Undo(undo) = task {
+        undo_on(&mut stacks, *undo);
+      }
+    }
+    return Some((std::mem::replace(&mut tasks[index], Task::Part(part)), stacks));
+  }
+}
+
+fn oper(oper: u64) -> &'static str {
+  match oper {
+    runtime::ADD => "+",
+    runtime::SUB => "-",
+    runtime::MUL => "*",
+    runtime::DIV => "/",
+    runtime::MOD => "%",
+    runtime::AND => "&",
+    runtime::OR  => "|",
+    runtime::XOR => "^",
+    runtime::SHL => "<<",
+    runtime::SHR => ">>",
+    runtime::LTN => "<",
+    runtime::LTE => "<=",
+    runtime::EQL => "==",
+    runtime::GTE => ">=",
+    runtime::GTN => ">",
+    runtime::NEQ => "!=",
+    _            => panic!("unknown operation"),
+  }
+}
+
+fn text(ctx: &mut Writer, tasks: &mut Vec<Task>, term: Ptr, out: &mut Vec<u8>) {
+  let mark = ctx.log.len();
+  let term = ctx.resolve(term);
+  ctx.defer(mark, tasks);
+  match runtime::get_tag(term) {
+    runtime::LAM => {
+      if runtime::get_tag(runtime::load_arg(ctx.heap, term, 0)) == runtime::ERA {
+        out.extend_from_slice("λ* ".as_bytes());
+      } else {
+        out.extend_from_slice("λx".as_bytes());
+        ctx.put(Hole::Var(runtime::get_loc(term, 0)), out);
+        out.push(b' ');
+      }
+      tasks.push(Task::Term(runtime::load_arg(ctx.heap, term, 1)));
+    }
+    runtime::APP => {
+      // Flattens `((f a) b)` to `(f a b)`. Each argument is read in the scope of its own
+      // application, so the function's stack changes are undone before it.
+      out.push(b'(');
+      tasks.push(Task::Text(")"));
+      let mark = ctx.log.len();
+      let mut term = term;
+      loop {
+        let argm = runtime::load_arg(ctx.heap, term, 1);
+        let init = ctx.log.len();
+        let func = ctx.resolve(runtime::load_arg(ctx.heap, term, 0));
+        tasks.push(Task::Term(argm));
+        tasks.push(Task::Text(" "));
+        ctx.defer(init, tasks);
+        if runtime::get_tag(func) == runtime::APP {
+          term = func;
+        } else {
+          tasks.push(Task::Term(func));
+          break;
+        }
+      }
+      ctx.log.truncate(mark);
+    }
+    runtime::SUP => {
+      out.push(b'{');
+      tasks.push(Task::Text("}"));
+      tasks.push(Task::Term(runtime::load_arg(ctx.heap, term, 1)));
+      tasks.push(Task::Text(" "));
+      tasks.push(Task::Term(runtime::load_arg(ctx.heap, term, 0)));
+    }
+    runtime::OP2 => {
+      out.push(b'(');
+      out.extend_from_slice(oper(runtime::get_ext(term)).as_bytes());
+      out.push(b' ');
+      tasks.push(Task::Text(")"));
+      tasks.push(Task::Term(runtime::load_arg(ctx.heap, term, 1)));
+      tasks.push(Task::Text(" "));
+      tasks.push(Task::Term(runtime::load_arg(ctx.heap, term, 0)));
+    }
+    runtime::U60 => {
+      out.extend_from_slice(runtime::u60::show(runtime::get_num(term)).as_bytes());
+    }
+    runtime::F60 => {
+      out.extend_from_slice(runtime::f60::show(runtime::get_num(term)).as_bytes());
+    }
+    runtime::BUF => {
+      if runtime::is_byte_buffer(term) {
+        out.push(b'"');
+        write_buffer(ctx.heap, term, out);
+        out.push(b'"');
+      } else {
+        let show = if runtime::get_buffer_kind(term) == runtime::BUFFER_F60 { runtime::f60::show } else { runtime::u60::show };
+        out.extend_from_slice(b"(Array.pack [");
+        for (i, numb) in runtime::get_array_elems(runtime::get_buffer_bytes(ctx.heap, term)).enumerate() {
+          if i > 0 {
+            out.extend_from_slice(b", ");
+          }
+          out.extend_from_slice(show(numb).as_bytes());
+        }
+        out.extend_from_slice(b"])");
+      }
+    }
+    runtime::CTR | runtime::FUN => {
+      if ctx.is_chain(term, "String.cons", "String.nil", true) {
+        let mark = ctx.log.len();
+        let mut term = term;
+        let mut buff = [0; 4];
+        out.push(b'"');
+        while ctx.is_ctr(term, "String.cons", 2) {
+          out.extend_from_slice(ctx.chr(term).unwrap().encode_utf8(&mut buff).as_bytes());
+          term = ctx.resolve(runtime::load_arg(ctx.heap, term, 1));
+        }
+        if runtime::is_byte_buffer(term) {
+          write_buffer(ctx.heap, term, out);
+        }
+        out.push(b'"');
+        ctx.rewind(mark);
+      } else if ctx.is_chain(term, "List.cons", "List.nil", false) {
+        out.push(b'[');
+        tasks.push(Task::Text("]"));
+        if ctx.is_ctr(term, "List.cons", 2) {
+          tasks.push(Task::List(runtime::load_arg(ctx.heap, term, 1)));
+          tasks.push(Task::Term(runtime::load_arg(ctx.heap, term, 0)));
+        }
+      } else {
+        let arit = runtime::arity_of(&ctx.prog.aris, term);
+        out.push(b'(');
+        match ctx.name(term) {
+          Some(name) => out.extend_from_slice(name.as_bytes()),
+          None => out.extend_from_slice(format!("${}", runtime::get_ext(term)).as_bytes()),
+        }
+        tasks.push(Task::Text(")"));
+        for i in (0 .. arit).rev() {
+          tasks.push(Task::Term(runtime::load_arg(ctx.heap, term, i)));
+          tasks.push(Task::Text(" "));
+        }
+      }
+    }
+    runtime::VAR => {
+      out.push(b'x');
+      ctx.put(Hole::Var(runtime::get_loc(term, 0)), out);
+    }
+    runtime::ARG => {
+      out.extend_from_slice(b"<arg>");
+    }
+    runtime::ERA => {
+      out.extend_from_slice(b"<era>");
+    }
+    _ => {
+      out.extend_from_slice(format!("<unknown_tag_{}>", runtime::get_tag(term)).as_bytes());
+    }
+  }
+}
+
+// Writes a buffer's characters as UTF-8, as `buffer_char` decodes them
+fn write_buffer(heap: &Heap, term: Ptr, out: &mut Vec<u8>) {
+  let bytes = runtime::get_buffer_bytes(heap, term);
+  if std::str::from_utf8(bytes).is_ok() {
+    out.extend_from_slice(bytes);
+  } else {
+    out.extend_from_slice(runtime::buffer_text(bytes).as_bytes());
+  }
+}
+
+fn binary(ctx: &mut Writer, tasks: &mut Vec<Task>, term: Ptr, out: &mut Vec<u8>) {
+  let mark = ctx.log.len();
+  let term = ctx.resolve(term);
+  ctx.defer(mark, tasks);
+  match runtime::get_tag(term) {
+    runtime::LAM => {
+      out.push(0x01);
+      if runtime::get_tag(runtime::load_arg(ctx.heap, term, 0)) == runtime::ERA {
+        varint(out, 0);
+      } else {
+        ctx.put(Hole::Lam(runtime::get_loc(term, 0)), out);
+      }
+      tasks.push(Task::Term(runtime::load_arg(ctx.heap, term, 1)));
+    }
+    runtime::APP | runtime::SUP => {
+      out.push(if runtime::get_tag(term) == runtime::APP { 0x02 } else { 0x03 });
+      tasks.push(Task::Term(runtime::load_arg(ctx.heap, term, 1)));
+      tasks.push(Task::Term(runtime::load_arg(ctx.heap, term, 0)));
+    }
+    runtime::OP2 => {
+      out.extend_from_slice(&[0x08, runtime::get_ext(term) as u8]);
+      tasks.push(Task::Term(runtime::load_arg(ctx.heap, term, 1)));
+      tasks.push(Task::Term(runtime::load_arg(ctx.heap, term, 0)));
+    }
+    runtime::U60 => {
+      out.push(0x06);
+      varint(out, runtime::get_num(term));
+    }
+    runtime::F60 => {
+      out.push(0x07);
+      varint(out, runtime::get_num(term));
+    }
+    runtime::CTR | runtime::FUN => {
+      let arit = runtime::arity_of(&ctx.prog.aris, term);
+      ctx.put(Hole::Ctr(runtime::get_ext(term)), out);
+      varint(out, arit);
+      for i in (0 .. arit).rev() {
+        tasks.push(Task::Term(runtime::load_arg(ctx.heap, term, i)));
+      }
+    }
+    runtime::VAR => {
+      out.push(0x00);
+      ctx.put(Hole::Var(runtime::get_loc(term, 0)), out);
+    }
+    runtime::BUF => {
+      let bytes = runtime::get_buffer_bytes(ctx.heap, term);
+      match runtime::get_buffer_kind(term) {
+        runtime::BUFFER_BYTES => {
+          out.push(0x0C);
+          varint(out, bytes.len() as u64);
+          out.extend_from_slice(bytes);
+        }
+        kind => {
+          out.extend_from_slice(&[0x0D, if kind == runtime::BUFFER_F60 { 0x07 } else { 0x06 }]);
+          varint(out, bytes.len() as u64 / 8);
+          for numb in runtime::get_array_elems(bytes) {
+            varint(out, numb);
+          }
+        }
+      }
+    }
+    runtime::ERA => {
+      out.push(0x09);
+    }
+    runtime::ARG => {
+      out.push(0x0A);
+    }
+    _ => {
+      out.extend_from_slice(&[0x0B, runtime::get_tag(term) as u8]);
+    }
+  }
+}
+
+// The output is built in a buffer, which is flushed to the sink whenever it gets this large
+const WRITE_CHUNK : usize = 1 << 16;
+
+pub fn write_term(heap: &Heap, prog: &Program, host: u64, format: ReadbackFormat, out: &mut dyn std::io::Write) -> std::io::Result<()> {
+  let ctx = &mut Writer::new(heap, prog, format, HashMap::new(), Some(Names::new()));
+  let tasks = &mut vec![Task::Term(runtime::load_ptr(heap, host))];
+  let buff = &mut Vec::with_capacity(WRITE_CHUNK);
+  if let ReadbackFormat::Binary = format {
+    buff.extend_from_slice(b"HVMB\x01");
+  }
+  while let Some(task) = tasks.pop() {
+    ctx.step(task, tasks, buff);
+    if buff.len() >= WRITE_CHUNK {
+      out.write_all(buff)?;
+      buff.clear();
+    }
+  }
+  return out.write_all(buff);
+}
+
+// Parallel Readback
+// -----------------
+// Writes the same output as `write_term`, with the threads of `tids`. Each thread writes parts of
+// the term to its own buffer, with the walk `write_term` does, and a thread that runs while others
+// are idle splits off the outermost term left on its task stack, which they can then take (see
+// `Writer::split`). As the index of a variable or constructor name depends on all the output that
+// comes before it, parts leave holes for these, and for the parts split off theirs. Once the whole
+// term is written, the parts are spliced together in order, filling the holes as `write_term`
+// would, so the output is the same, bit for bit. This is worth it for large results, whose walk is
+// mostly loads from a heap the threads have just written.
+
+// Tasks a part runs between checks for idle threads to split work off to
+pub const SPLIT_EVERY : usize = 64;
+
+struct Part {
+  bytes: Vec<u8>,
+  holes: Vec<(usize, Hole)>,
+}
+
+pub fn write_term_par(heap: &Heap, prog: &Program, tids: &[usize], host: u64, format: ReadbackFormat, out: &mut dyn std::io::Write) -> std::io::Result<()> {
+  if tids.len() <= 1 {
+    return write_term(heap, prog, host, format, out);
+  }
+
+  let todo  = std::sync::Mutex::new(vec![(0, Task::Term(runtime::load_ptr(heap, host)), Stacks::new())]);
+  let parts = std::sync::Mutex::new(vec![None]);
+  let left  = std::sync::atomic::AtomicUsize::new(1); // parts not written yet
+  let park  = runtime::Park::new();
+
+  heap.pool.run(tids.len(), &|_| {
+    let mut sleep = runtime::PARK_MIN_MICROS;
+    loop {
+      let next = todo.lock().unwrap().pop();
+      let (part, task, stacks) = match next {
+        Some(next) => next,
+        None => {
+          if left.load(std::sync::atomic::Ordering::Acquire) == 0 {
+            return;
+          }
+          park.wait(&left, sleep);
+          sleep = std::cmp::min(sleep * 2, runtime::PARK_MAX_MICROS);
+          continue;
+        }
+      };
+      sleep = runtime::PARK_MIN_MICROS;
+      let ctx = &mut Writer::new(heap, prog, format, stacks, None);
+      let tasks = &mut vec![task];
+      let bytes = &mut Vec::new();
+      let mut step = 0;
+      while let Some(task) = tasks.pop() {
+        ctx.step(task, tasks, bytes);
+        step += 1;
+        if step % SPLIT_EVERY == 0 && park.has_sleepers() {
+          let mut todo = todo.lock().unwrap();
+          if todo.is_empty() {
+            let mut parts = parts.lock().unwrap();
+            if let Some((task, stacks)) = ctx.split(tasks, parts.len()) {
+              left.fetch_add(1, std::sync::atomic::Ordering::AcqRel);
+              todo.push((parts.len(), task, stacks));
+              parts.push(None);
+              park.notify_one();
+            }
+          }
+        }
+      }
+      parts.lock().unwrap()[part] = Some(Part { bytes: std::mem::take(bytes), holes: std::mem::take(&mut ctx.holes) });
+      if left.fetch_sub(1, std::sync::atomic::Ordering::AcqRel) == 1 {
+        park.notify_all();
+      }
+    }
+  });
+
+  // Splices the parts, starting from the root's, filling the holes
+  let parts = parts.into_inner().unwrap().into_iter().map(|part| part.unwrap()).collect::<Vec<Part>>();
+  let names = &mut Names::new();
+  let buff = &mut Vec::with_capacity(WRITE_CHUNK);
+  let stack = &mut vec![(0, 0, 0)]; // each part being spliced, the bytes and holes spliced of it
+  if let ReadbackFormat::Binary = format {
+    buff.extend_from_slice(b"HVMB\x01");
+  }
+  while let Some((part, init, hole)) = stack.pop() {
+    let Part { bytes, holes } = &parts[part];
+    match holes.get(hole) {
+      Some((upto, fill)) => {
+        buff.extend_from_slice(&bytes[init .. *upto]);
+        stack.push((part, *upto, hole + 1));
+        match fill {
+          Hole::Part(next) => stack.push((*next, 0, 0)),
+          fill => names.fill(prog, format, *fill, buff),
+        }
+      }
+      None => {
+        buff.extend_from_slice(&bytes[init ..]);
+      }
+    }
+    if buff.len() >= WRITE_CHUNK {
+      out.write_all(buff)?;
+      buff.clear();
+    }
+  }
+  return out.write_all(buff);
+}
+
+/// Reads back a term from Runtime's memory, without an intermediate `syntax::Term`
+pub fn as_code_streamed(heap: &Heap, prog: &Program, host: u64) -> String {
+  let mut code = Vec::new();
+  write_term(heap, prog, host, ReadbackFormat::Text, &mut code).unwrap();
+  return String::from_utf8(code).unwrap();
+}
+
 // This reads a term in the `(String.cons ... String.nil)` shape directly into a string.
 pub fn as_string(heap: &Heap, prog: &Program, tids: &[usize], host: u64) -> Option<String> {
   let mut host = host;
@@ -482,9 +1169,54 @@ pub fn as_string(heap: &Heap, prog: &Program, tids: &[usize], host: u64) -> Opti
         }
       }
       return None;
+    } else if runtime::is_byte_buffer(term) {
+      text.push_str(&runtime::buffer_text(runtime::get_buffer_bytes(heap, term)));
+      break;
     } else {
       return None;
     }
   }
   return Some(text);
 }
+
+// Like `as_string`, but borrows the bytes of a buffer instead of decoding them
+pub fn as_bytes<'a>(heap: &'a Heap, prog: &Program, tids: &[usize], host: u64) -> Option<std::borrow::Cow<'a, [u8]>> {
+  let term = runtime::reduce(heap, prog, tids, host, true, false);
+  if runtime::is_byte_buffer(term) {
+    return Some(std::borrow::Cow::Borrowed(runtime::get_buffer_bytes(heap, term)));
+  } else {
+    return as_string(heap, prog, tids, host).map(|text| std::borrow::Cow::Owned(text.into_bytes()));
+  }
+}
+
+// This reads a `(List.cons ... List.nil)` of numbers directly into their values. The numbers must
+// all have the same tag, which is returned too (U60 for an empty list).
+pub fn as_numbers(heap: &Heap, prog: &Program, tids: &[usize], host: u64) -> Option<(u64, Vec<u64>)> {
+  let mut host = host;
+  let mut tag = None;
+  let mut numbs = Vec::new();
+  runtime::reduce(heap, prog, tids, host, true, false);
+  loop {
+    let term = runtime::load_ptr(heap, host);
+    if runtime::get_tag(term) != runtime::CTR {
+      return None;
+    }
+    match prog.nams.get(&runtime::get_ext(term)).map(|name| name.as_str()) {
+      Some("List.nil") => {
+        return Some((tag.unwrap_or(runtime::U60), numbs));
+      }
+      Some("List.cons") if runtime::arity_of(&prog.aris, term) == 2 => {
+        let head = runtime::load_arg(heap, term, 0);
+        let head_tag = runtime::get_tag(head);
+        if head_tag != runtime::U60 && head_tag != runtime::F60 || *tag.get_or_insert(head_tag) != head_tag {
+          return None;
+        }
+        numbs.push(runtime::get_num(head));
+        host = runtime::get_loc(term, 1);
+      }
+      _ => {
+        return None;
+      }
+    }
+  }
+}
@@ -0,0 +1,375 @@
+// Reader
+// ======
+// A fast path for `syntax::read_file` and `syntax::read_term`, for the large files that compilers
+// emit. It reads the same grammar as the combinator parser, with the same results, but scans the
+// source bytes directly: tokens are slices of the source, so nothing is allocated but the terms
+// themselves, and each construct is picked by its first character, instead of trying every parser
+// in turn. Whatever it doesn't handle exactly as the combinator parser would (errors, `ask`, and
+// malformed numbers or strings) makes it give up, returning None, so that the caller reparses the
+// source with the combinator parser, which reports the error, or reads the construct. So this
+// never changes what a source means, only how fast it is read.
+
+use crate::language::syntax::{File, Oper, Rule, Term};
+use crate::runtime::data::f60;
+use crate::runtime::data::u60;
+
+pub struct Reader<'a> {
+  code: &'a str,
+  index: usize,
+}
+
+// The operators, in the order the combinator parser tries them
+const OPERS : &[(&str, Oper)] = &[
+  ("+", Oper::Add), ("-", Oper::Sub), ("*", Oper::Mul), ("/", Oper::Div),
+  ("%", Oper::Mod), ("&", Oper::And), ("|", Oper::Or), ("^", Oper::Xor),
+  ("<<", Oper::Shl), (">>", Oper::Shr), ("<=", Oper::Lte), ("<", Oper::Ltn),
+  ("==", Oper::Eql), (">=", Oper::Gte), (">", Oper::Gtn), ("!=", Oper::Neq),
+];
+
+fn is_letter(chr: u8) -> bool {
+  chr.is_ascii_alphanumeric() || chr == b'_' || chr == b'.' || chr == b'$'
+}
+
+fn is_op_char(chr: u8) -> bool {
+  matches!(chr, b'+' | b'-' | b'*' | b'/' | b'%' | b'&' | b'|' | b'^' | b'<' | b'>' | b'=' | b'!')
+}
+
+impl<'a> Reader<'a> {
+  pub fn new(code: &'a str) -> Reader<'a> {
+    return Reader { code, index: 0 };
+  }
+
+  // Scanning
+  // --------
+
+  fn rest(&self) -> &'a str {
+    return &self.code[self.index ..];
+  }
+
+  // The byte at the cursor, or 0 at the end
+  fn byte(&self) -> u8 {
+    return self.code.as_bytes().get(self.index).copied().unwrap_or(0);
+  }
+
+  // Skips whitespace and `//` comments
+  fn skip(&mut self) {
+    let bytes = self.code.as_bytes();
+    loop {
+      match bytes.get(self.index) {
+        Some(b' ' | b'\t' | b'\n' | b'\r' | 0x0B | 0x0C) => {
+          self.index += 1;
+        }
+        Some(b'/') if bytes.get(self.index + 1) == Some(&b'/') => {
+          self.index += self.rest().find('\n').unwrap_or(self.rest().len());
+        }
+        Some(chr) if *chr >= 0x80 => {
+          match self.rest().chars().next() {
+            Some(chr) if chr.is_whitespace() => self.index += chr.len_utf8(),
+            _ => return,
+          }
+        }
+        _ => return,
+      }
+    }
+  }
+
+  // Skips, then the byte at the cursor
+  fn peek(&mut self) -> u8 {
+    self.skip();
+    return self.byte();
+  }
+
+  // Skips, then consumes `pat` if it is next
+  fn text(&mut self, pat: &str) -> bool {
+    self.skip();
+    if self.rest().starts_with(pat) {
+      self.index += pat.len();
+      return true;
+    }
+    return false;
+  }
+
+  // Like `text`, but gives up if `pat` isn't next
+  fn consume(&mut self, pat: &str) -> Option<()> {
+    return if self.text(pat) { Some(()) } else { None };
+  }
+
+  // Skips, then reads a name, which may be empty
+  fn name(&mut self) -> &'a str {
+    self.skip();
+    let init = self.index;
+    let bytes = self.code.as_bytes();
+    while self.index < bytes.len() && is_letter(bytes[self.index]) {
+      self.index += 1;
+    }
+    return &self.code[init .. self.index];
+  }
+
+  fn name1(&mut self) -> Option<&'a str> {
+    let name = self.name();
+    return if name.is_empty() { None } else { Some(name) };
+  }
+
+  // Terms
+  // -----
+
+  pub fn term(&mut self) -> Option<Box<Term>> {
+    let head = self.peek();
+    let rest = self.rest();
+    if rest.starts_with("let ") {
+      self.index += 4;
+      let name = self.name1()?.to_string();
+      self.consume("=")?;
+      let expr = self.term()?;
+      self.text(";");
+      let body = self.term()?;
+      return Some(Box::new(Term::Let { name, expr, body }));
+    }
+    if rest.starts_with("dup ") {
+      self.index += 4;
+      let nam0 = self.name1()?.to_string();
+      let nam1 = self.name1()?.to_string();
+      self.consume("=")?;
+      let expr = self.term()?;
+      self.text(";");
+      let body = self.term()?;
+      return Some(Box::new(Term::Dup { nam0, nam1, expr, body }));
+    }
+    if rest.starts_with("λ") || head == b'@' {
+      self.index += if head == b'@' { 1 } else { "λ".len() };
+      let name = self.name().to_string();
+      let body = self.term()?;
+      return Some(Box::new(Term::Lam { name, body }));
+    }
+    match head {
+      b'(' => {
+        self.index += 1;
+        let next = self.peek();
+        if next.is_ascii_uppercase() {
+          let name = self.name1()?.to_string();
+          let mut args = Vec::new();
+          while !self.text(")") {
+            args.push(self.term()?);
+          }
+          return Some(Box::new(Term::Ctr { name, args }));
+        }
+        if is_op_char(next) {
+          let oper = OPERS.iter().find(|(symbol, _)| self.rest().starts_with(symbol))?;
+          self.index += oper.0.len();
+          let val0 = self.term()?;
+          let val1 = self.term()?;
+          self.text(")");
+          return Some(Box::new(Term::Op2 { oper: oper.1, val0, val1 }));
+        }
+        let mut args = Vec::new();
+        while !self.text(")") {
+          args.push(self.term()?);
+        }
+        return Some(args.into_iter().reduce(|func, argm| Box::new(Term::App { func, argm })).unwrap_or(Box::new(Term::U6O { numb: 0 })));
+      }
+      b'A' ..= b'Z' => {
+        let name = self.name1()?.to_string();
+        return Some(Box::new(Term::Ctr { name, args: Vec::new() }));
+      }
+      b'{' => {
+        self.index += 1;
+        let val0 = self.term()?;
+        let val1 = self.term()?;
+        self.consume("}")?;
+        return Some(Box::new(Term::Sup { val0, val1 }));
+      }
+      b'0' ..= b'9' => {
+        let text = self.name1()?;
+        if text.starts_with("0x") {
+          return Some(Box::new(Term::U6O { numb: u60::new(u64::from_str_radix(&text[2 ..], 16).ok()?) }));
+        } else if text.contains('.') {
+          return Some(Box::new(Term::F6O { numb: f60::new(text.parse::<f64>().ok()?) }));
+        } else {
+          return Some(Box::new(Term::U6O { numb: u60::new(text.parse::<u64>().ok()?) }));
+        }
+      }
+      b'%' => {
+        use std::hash::Hasher;
+        self.index += 1;
+        let mut hasher = std::collections::hash_map::DefaultHasher::new();
+        hasher.write(self.name().as_bytes());
+        return Some(Box::new(Term::U6O { numb: u60::new(hasher.finish()) }));
+      }
+      b'\'' => {
+        self.index += 1;
+        let chr = self.rest().chars().next()?;
+        self.index += chr.len_utf8();
+        self.text("'");
+        return Some(Box::new(Term::U6O { numb: chr as u64 }));
+      }
+      b'"' | b'`' => {
+        self.index += 1;
+        let size = self.rest().find(|chr| chr == head as char || chr == '\0')?;
+        let text = &self.rest()[.. size];
+        self.index += size + 1;
+        let empty = Term::Ctr { name: "String.nil".to_string(), args: Vec::new() };
+        return Some(Box::new(text.chars().rfold(empty, |tail, head| Term::Ctr {
+          name: "String.cons".to_string(),
+          args: vec![Box::new(Term::U6O { numb: head as u64 }), Box::new(tail)],
+        })));
+      }
+      b'[' => {
+        self.index += 1;
+        let mut elems = Vec::new();
+        while !self.text("]") {
+          elems.push(self.term()?);
+          self.text(",");
+        }
+        let empty = Term::Ctr { name: "List.nil".to_string(), args: Vec::new() };
+        return Some(Box::new(elems.into_iter().rfold(empty, |tail, head| Term::Ctr {
+          name: "List.cons".to_string(),
+          args: vec![head, Box::new(tail)],
+        })));
+      }
+      b'i' if rest.starts_with("if ") => {
+        self.index += 3;
+        let cond = self.term()?;
+        self.consume("{")?;
+        let if_t = self.term()?;
+        self.consume("}")?;
+        self.consume("else")?;
+        self.consume("{")?;
+        let if_f = self.term()?;
+        self.consume("}")?;
+        return Some(Box::new(Term::Ctr { name: "U60.if".to_string(), args: vec![cond, if_t, if_f] }));
+      }
+      b'!' => {
+        self.index += 1;
+        return self.term();
+      }
+      b'a' if rest.starts_with("ask ") => {
+        return None;
+      }
+      b'a' ..= b'z' | b'_' | b'$' => {
+        let name = self.name().to_string();
+        return Some(Box::new(Term::Var { name }));
+      }
+      _ => {
+        return None;
+      }
+    }
+  }
+
+  // Files
+  // -----
+
+  // A rule whose left-hand side is a call also gives the strictness of its arguments, marked by `!`
+  fn rule(&mut self, smaps: &mut Vec<(String, Vec<bool>)>) -> Option<Rule> {
+    let lhs = if self.text("(") {
+      let name = self.name1()?;
+      if !name.as_bytes()[0].is_ascii_uppercase() {
+        return None;
+      }
+      let mut args = Vec::new();
+      let mut smap = Vec::new();
+      while !self.text(")") {
+        smap.push(self.peek() == b'!');
+        args.push(self.term()?);
+      }
+      smaps.push((name.to_string(), smap));
+      Box::new(Term::Ctr { name: name.to_string(), args })
+    } else {
+      self.term()?
+    };
+    self.consume("=")?;
+    let rhs = self.term()?;
+    return Some(Rule { lhs, rhs });
+  }
+
+  pub fn file(&mut self) -> Option<File> {
+    let mut rules = Vec::new();
+    let mut smaps = Vec::new();
+    loop {
+      self.skip();
+      if self.index == self.code.len() {
+        break;
+      }
+      rules.push(self.rule(&mut smaps)?);
+    }
+    return Some(File { rules, smaps });
+  }
+}
+
+#[cfg(test)]
+mod tests {
+  use super::Reader;
+  use crate::language::parser;
+  use crate::language::rulebook::{gen_rulebook, RuleBook};
+  use crate::language::syntax::{parse_file, File};
+  use std::collections::BTreeMap;
+
+  pub const EXAMPLES : [&str; 13] = [
+    include_str!("../../examples/IO/log.hvm"),
+    include_str!("../../examples/IO/query_and_print.hvm"),
+    include_str!("../../examples/IO/store_and_load.hvm"),
+    include_str!("../../examples/bugs/fib_dups.hvm"),
+    include_str!("../../examples/bugs/fib_loop.hvm"),
+    include_str!("../../examples/bugs/fib_tups.hvm"),
+    include_str!("../../examples/bugs/lotto.hvm"),
+    include_str!("../../examples/hello/main.hvm"),
+    include_str!("../../examples/lambda/multiplication/main.hvm"),
+    include_str!("../../examples/sort/bitonic/main.hvm"),
+    include_str!("../../examples/sort/bubble/main.hvm"),
+    include_str!("../../examples/sort/quick/main.hvm"),
+    include_str!("../../examples/sort/radix/main.hvm"),
+  ];
+
+  // Sources that stress what the reader scans by hand: comments, strings, chars, nested lets, and
+  // the other constructs picked by their first characters
+  pub const EDGES : [&str; 8] = [
+    // comments, also between tokens, after the last rule, and at the end without a newline
+    "// head\n(Foo a) = a // tail\n(Bar // inside\n  b) = (Foo // again\n b)\n// end",
+    "(Main) = (Foo 1)\n\n//",
+    // strings and chars, empty, with unicode, and with the other quote inside
+    "(Main) = [\"\" \"hello, world\" `back` \"λ → é\" \"it's\" `say \"hi\"`]",
+    "(Main) = (Pair 'a' (Pair 'λ' ' '))",
+    // nested lets and dups, with and without `;`
+    "(Main) = let a = 1; let b = let c = 2; (+ c a); dup x y = b; (+ x y)",
+    "(Main) = let a = let b = let c = 3 c b dup p q = {a a} (Pair p q)",
+    // lambdas, operators, numbers, hashes, lists, if and strict arguments
+    "(Id !x y) = (@a λb (a b) x y)\n(Ops a b) = [(+ a b), (<< a 1), (<= a b), (< a b), (>> b 2), (!= a b)]",
+    "(Main) = (if (== 0x1F 31) { 1.5 } else { %name })\n(Main2) = !(Id 2 3)",
+  ];
+
+  // The rules and smaps of a file, in order, in full
+  fn show_file(file: &File) -> String {
+    return format!("{:?} {:?}", file.rules, file.smaps);
+  }
+
+  // A rulebook by names: ids are given in the order of hash maps, so they may differ between two
+  // rulebooks of the same file
+  fn show_book(book: &RuleBook) -> String {
+    let groups = book.rule_group.iter().map(|(name, group)| (name, format!("{:?}", group))).collect::<BTreeMap<_, _>>();
+    let names = book.name_to_id.iter().map(|(name, id)| {
+      assert_eq!(book.id_to_name.get(id), Some(name));
+      (name, book.id_to_smap.get(id))
+    }).collect::<BTreeMap<_, _>>();
+    let funs = book.ctr_is_fun.iter().collect::<BTreeMap<_, _>>();
+    return format!("{:?} {} {:?} {:?}", groups, book.name_count, names, funs);
+  }
+
+  #[test]
+  fn test_reader_agrees_with_parser() {
+    // lotto.hvm nests deeper than the parser fits in a test thread's stack
+    std::thread::Builder::new().stack_size(1 << 26).spawn(|| {
+      for code in EXAMPLES.iter().chain(EDGES.iter()) {
+        let fast = Reader::new(code).file().unwrap_or_else(|| panic!("the reader gave up on:\n{}", code));
+        let slow = parser::read(Box::new(parse_file), code).unwrap();
+        assert_eq!(show_file(&fast), show_file(&slow), "on:\n{}", code);
+        assert_eq!(show_book(&gen_rulebook(&fast)), show_book(&gen_rulebook(&slow)), "on:\n{}", code);
+      }
+    }).unwrap().join().unwrap();
+  }
+
+  #[test]
+  fn test_reader_gives_up_on_errors() {
+    for code in ["(Main) = ask x = (Foo); x", "(Main) = (Foo", "(Main) = \"open", "(main) = 1", "(Main) 1", "(Main) = 0xZZ"] {
+      assert!(Reader::new(code).file().is_none(), "on:\n{}", code);
+    }
+  }
+}
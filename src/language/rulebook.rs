@@ -1,6 +1,8 @@
 use crate::language as language;
 use crate::runtime as runtime;
+use crate::runtime::data::pool::par_map;
 use std::collections::{BTreeMap, HashMap, HashSet};
+use std::sync::atomic::{AtomicU64, Ordering};
 
 // RuleBook
 // ========
@@ -45,7 +47,7 @@ pub fn new_rulebook() -> RuleBook {
 }
 
 // Adds a group to a rulebook
-pub fn add_group(book: &mut RuleBook, name: &str, group: &RuleGroup) {
+pub fn add_group(book: &mut RuleBook, name: &str, group: RuleGroup) {
   fn register(book: &mut RuleBook, term: &language::syntax::Term, lhs_top: bool) {
     match term {
       language::syntax::Term::Dup { expr, body, .. } => {
@@ -119,9 +121,6 @@ pub fn add_group(book: &mut RuleBook, name: &str, group: &RuleGroup) {
     }
   }
 
-  // Inserts the group on the book
-  book.rule_group.insert(name.to_string(), group.clone());
-
   // Builds its metadata (name_to_id, id_to_name, ctr_is_fun)
   for rule in &group.1 {
     register(book, &rule.lhs, true);
@@ -130,6 +129,9 @@ pub fn add_group(book: &mut RuleBook, name: &str, group: &RuleGroup) {
       book.ctr_is_fun.insert(name.clone(), true);
     }
   }
+
+  // Inserts the group on the book
+  book.rule_group.insert(name.to_string(), group);
 }
 
 // Converts a file to a rulebook
@@ -138,12 +140,12 @@ pub fn gen_rulebook(file: &language::syntax::File) -> RuleBook {
   let mut book = new_rulebook();
 
   // Flattens, sanitizes and groups this file's rules
-  let groups = group_rules(&sanitize_rules(&flatten(&file.rules)));
+  let groups = group_rules(sanitize_rules(&flatten(&file.rules)));
 
   // Adds each group
-  for (name, group) in groups.iter() {
-    if book.name_to_id.get(name).unwrap_or(&u64::MAX) >= &runtime::PRECOMP_COUNT {
-      add_group(&mut book, name, group);
+  for (name, group) in groups {
+    if book.name_to_id.get(&name).unwrap_or(&u64::MAX) >= &runtime::PRECOMP_COUNT {
+      add_group(&mut book, &name, group);
     }
   }
 
@@ -170,17 +172,17 @@ pub fn gen_rulebook(file: &language::syntax::File) -> RuleBook {
 //   (add (zero)   (succ b)) = (succ b)
 //   (add (zero)   (zero)  ) = (zero)
 // This is a group of 4 rules starting with the "add" name.
-pub fn group_rules(rules: &[language::syntax::Rule]) -> HashMap<String, RuleGroup> {
+pub fn group_rules(rules: Vec<language::syntax::Rule>) -> HashMap<String, RuleGroup> {
   let mut groups: HashMap<String, RuleGroup> = HashMap::new();
   for rule in rules {
     if let language::syntax::Term::Ctr { ref name, ref args } = *rule.lhs {
       let group = groups.get_mut(name);
       match group {
         None => {
-          groups.insert(name.clone(), (args.len(), Vec::from([rule.clone()])));
+          groups.insert(name.clone(), (args.len(), Vec::from([rule])));
         }
         Some((_arity, rules)) => {
-          rules.push(rule.clone());
+          rules.push(rule);
         }
       }
     }
@@ -527,12 +529,14 @@ pub fn sanitize_rule(rule: &language::syntax::Rule) -> Result<language::syntax::
   Ok(language::syntax::Rule { lhs, rhs })
 }
 
-// Sanitizes all rules in a vector
+// Sanitizes all rules in a vector, in parallel, as each rule is sanitized on its own. The first
+// rule that fails is reported, as if they were sanitized in order.
 pub fn sanitize_rules(rules: &[language::syntax::Rule]) -> Vec<language::syntax::Rule> {
-  rules
-    .iter()
-    .map(|rule| {
-      match sanitize_rule(rule) {
+  par_map(rules, sanitize_rule)
+    .into_iter()
+    .zip(rules)
+    .map(|(sanitized, rule)| {
+      match sanitized {
         Ok(rule) => rule,
         Err(err) => {
           println!("{}", err);
@@ -709,12 +713,10 @@ pub fn subst(term: &mut language::syntax::Term, sub_name: &str, value: &language
 // Split rules that have nested cases, flattening them.
 // I'm not proud of this code. Must improve considerably.
 pub fn flatten(rules: &[language::syntax::Rule]) -> Vec<language::syntax::Rule> {
-  // Unique name generator
-  let mut name_count = 0;
-  fn fresh(name_count: &mut u64) -> u64 {
-    let name = *name_count;
-    *name_count += 1;
-    name
+  // Unique name generator, shared by the groups, which are split in parallel
+  let name_count = AtomicU64::new(0);
+  fn fresh(name_count: &AtomicU64) -> u64 {
+    name_count.fetch_add(1, Ordering::Relaxed)
   }
 
   // Checks if this rule has nested patterns, and must be splitted
@@ -821,7 +823,7 @@ pub fn flatten(rules: &[language::syntax::Rule]) -> Vec<language::syntax::Rule>
     (true, same_shape)
   }
 
-  fn split_group(rules: &[language::syntax::Rule], name_count: &mut u64) -> Vec<language::syntax::Rule> {
+  fn split_group(rules: &[language::syntax::Rule], name_count: &AtomicU64) -> Vec<language::syntax::Rule> {
     // println!("\n[split_group]");
     // for rule in rules {
     //   println!("{}", rule);
@@ -1009,12 +1011,8 @@ pub fn flatten(rules: &[language::syntax::Rule]) -> Vec<language::syntax::Rule>
   }
 
   // For each group, split its internal rules
-  let mut new_rules = Vec::new();
-  for (_name, rules) in &groups {
-    for rule in split_group(rules, &mut name_count) {
-      new_rules.push(rule);
-    }
-  }
+  let groups = groups.into_values().collect::<Vec<_>>();
+  let new_rules = par_map(&groups, |rules| split_group(rules, &name_count)).into_iter().flatten().collect::<Vec<_>>();
 
   // println!("\nresult:");
   // for rule in &new_rules {
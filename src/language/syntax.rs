@@ -1,4 +1,5 @@
 use crate::language::parser;
+use crate::language::reader;
 use crate::runtime::data::u60;
 use crate::runtime::data::f60;
 
@@ -627,11 +628,20 @@ pub fn parse_file(state: parser::State) -> parser::Answer<File> {
   Ok((state, File { rules, smaps }))
 }
 
+// Both try the fast reader first (see `reader.rs`), which gives up on anything it doesn't read
+// exactly as these parsers would, including errors, so that they are reported the same way.
+
 pub fn read_term(code: &str) -> Result<Box<Term>, String> {
+  if let Some(term) = reader::Reader::new(code).term() {
+    return Ok(term);
+  }
   parser::read(Box::new(parse_term), code)
 }
 
 pub fn read_file(code: &str) -> Result<File, String> {
+  if let Some(file) = reader::Reader::new(code).file() {
+    return Ok(file);
+  }
   parser::read(Box::new(parse_file), code)
 }
 
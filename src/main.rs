@@ -38,6 +38,46 @@ enum Command {
     #[clap(short = 't', long, default_value = "auto", parse(try_from_str=parse_tids))]
     tids: usize,
 
+    /// Set the allocator to use ("scan" or "arena").
+    #[clap(short = 'a', long, default_value = "scan", parse(try_from_str=parse_alloc))]
+    alloc: runtime::AllocMode,
+
+    /// Set the victim selection of idle threads ("random", "round-robin" or "socket"). With "socket",
+    /// threads steal from the same NUMA node first, and are pinned to cpus.
+    #[clap(long, default_value = "random", parse(try_from_str=parse_steal))]
+    steal: runtime::StealMode,
+
+    /// Caches the parsed rules on disk, keyed by the code, to skip parsing on later runs. Entries are
+    /// kept in $HVM_CACHE_DIR, else $XDG_CACHE_HOME/hvm, else ~/.cache/hvm.
+    #[clap(long, default_value = "false", default_missing_value = "true", parse(try_from_str=parse_bool))]
+    cache: bool,
+
+    /// Prints per-thread and per-rule counters as JSON to stderr, at exit.
+    #[clap(long, default_value = "false", default_missing_value = "true", parse(try_from_str=parse_bool))]
+    profile: bool,
+
+    /// Lowers the interpreted functions to machine code before running (x86-64 only).
+    #[clap(long, default_value = "false", default_missing_value = "true", parse(try_from_str=parse_bool))]
+    jit: bool,
+
+    /// Runs the tracing collector whenever this fraction of the heap is used (e.g. "0.5"), or "off".
+    #[clap(long, default_value = "off", parse(try_from_str=parse_gc))]
+    gc: Option<f64>,
+
+    /// Serves live counters on this address while running (e.g. "127.0.0.1:9090"), or "off": rewrites
+    /// and heap use in the Prometheus text format at /metrics, and the sampled stacks at /folded.
+    #[clap(long, default_value = "off", parse(try_from_str=parse_telemetry))]
+    telemetry: Option<String>,
+
+    /// Samples what the threads are reducing, writing the stacks to this file at exit, in the folded
+    /// format of flamegraph tools.
+    #[clap(long, default_value = "")]
+    folded: String,
+
+    /// Set the format of the normal form ("text" or "binary"), written to stdout as it's read back.
+    #[clap(short = 'o', long, default_value = "text", parse(try_from_str=parse_output))]
+    output: language::readback::ReadbackFormat,
+
     /// Shows the number of graph rewrites performed.
     #[clap(short = 'c', long, default_value = "false", default_missing_value = "true", parse(try_from_str=parse_bool))]
     cost: bool,
@@ -74,14 +114,35 @@ fn run_cli() -> Result<(), String> {
   let cli = Cli::parse();
 
   match cli.command {
-    Command::Run { size, tids, cost: show_cost, debug, file, expr } => {
+    Command::Run { size, tids, alloc, steal, cache, profile, jit, gc, telemetry, folded, output, cost: show_cost, debug, file, expr } => {
       let tids = if debug { 1 } else { tids };
-      let (norm, cost, time) = api::eval(&load_code(&file)?, &expr, Vec::new(), size, tids, debug)?;
-      println!("{}", norm);
+      let cache = if cache { runtime::default_cache_dir() } else { None };
+      let folded = if folded.is_empty() { None } else { Some(std::path::Path::new(&folded)) };
+      let mut out = std::io::BufWriter::new(std::io::stdout());
+      let (cost, time, prof) = api::eval_into(&load_code(&file)?, &expr, Vec::new(), &api::EvalOptions {
+        size,
+        tids,
+        alloc,
+        steal,
+        cache: cache.as_deref(),
+        prof: profile,
+        jit,
+        gc,
+        tele: telemetry.as_deref(),
+        fold: folded,
+        dbug: debug,
+      }, output, &mut out)?;
+      if output == language::readback::ReadbackFormat::Text {
+        std::io::Write::write_all(&mut out, b"\n").map_err(|e| e.to_string())?;
+      }
+      std::io::Write::flush(&mut out).map_err(|e| e.to_string())?;
       if show_cost {
         eprintln!();
         eprintln!("\x1b[32m[TIME: {:.2}s | COST: {} | RPS: {:.2}m]\x1b[0m", ((time as f64)/1000.0), cost - 1, (cost as f64) / (time as f64) / 1000.0);
       }
+      if let Some(prof) = prof {
+        eprintln!("{}", prof);
+      }
       Ok(())
     }
     Command::Compile { file } => {
@@ -110,6 +171,50 @@ fn parse_tids(text: &str) -> Result<usize, String> {
   }
 }
 
+fn parse_alloc(text: &str) -> Result<runtime::AllocMode, String> {
+  match text {
+    "scan"  => Ok(runtime::AllocMode::Scan),
+    "arena" => Ok(runtime::AllocMode::Arena),
+    _       => Err(format!("unknown allocator '{}', expected 'scan' or 'arena'", text)),
+  }
+}
+
+fn parse_output(text: &str) -> Result<language::readback::ReadbackFormat, String> {
+  match text {
+    "text"   => Ok(language::readback::ReadbackFormat::Text),
+    "binary" => Ok(language::readback::ReadbackFormat::Binary),
+    _        => Err(format!("unknown output format '{}', expected 'text' or 'binary'", text)),
+  }
+}
+
+fn parse_steal(text: &str) -> Result<runtime::StealMode, String> {
+  match text {
+    "random"      => Ok(runtime::StealMode::Random),
+    "round-robin" => Ok(runtime::StealMode::RoundRobin),
+    "socket"      => Ok(runtime::StealMode::Socket),
+    "node"        => Ok(runtime::StealMode::Socket),
+    _             => Err(format!("unknown steal mode '{}', expected 'random', 'round-robin' or 'socket'", text)),
+  }
+}
+
+fn parse_gc(text: &str) -> Result<Option<f64>, String> {
+  if text == "off" {
+    return Ok(None);
+  }
+  match text.parse::<f64>() {
+    Ok(ratio) if ratio > 0.0 && ratio <= 1.0 => Ok(Some(ratio)),
+    _ => Err(format!("invalid collector ratio '{}', expected a number in (0, 1] or 'off'", text)),
+  }
+}
+
+fn parse_telemetry(text: &str) -> Result<Option<String>, String> {
+  if text == "off" {
+    return Ok(None);
+  } else {
+    return Ok(Some(text.to_string()));
+  }
+}
+
 fn parse_bool(text: &str) -> Result<bool, String> {
   return text.parse::<bool>().map_err(|x| format!("{}", x));
 }
@@ -0,0 +1,220 @@
+// Arrays
+// ------
+// A number array is a buffer of U60s or F60s (see `buffer.rs`), 8 little-endian bytes each, that
+// the `Array.*` primitives operate on in bulk. An element-wise operation is a single rewrite that
+// runs a tight loop over the bytes, with the same `u60`/`f60` semantics as OP2, instead of one
+// graph rewrite, allocation and redex per number. The loops are written so that LLVM vectorizes
+// them; on x86-64, they're also compiled for AVX2, which is picked at runtime when available.
+
+use crate::runtime::{*};
+
+// An operand of an element-wise operation
+#[derive(Clone, Copy)]
+pub enum Operand<'a> {
+  Elems(&'a [u8]), // the elements of an array
+  Num(u64), // the same number, for every element
+}
+
+// An operand of an operator lambda
+#[derive(Clone, Copy, PartialEq, Eq)]
+pub enum OperArg {
+  Var(usize), // the lambda's `n`th variable
+  Num(u64),
+}
+
+// Matches the operator lambda at `host`, `λx0 .. λxn (op a b)`, whose operands are its variables
+// or numbers with the elements' tag, returning the operator and both operands. Lambdas that were
+// duplicated only take this shape once reduced, so each level is reduced to WHNF first.
+pub fn get_array_oper(heap: &Heap, prog: &Program, tid: usize, host: u64, arity: usize, tag: u64) -> Option<(u64, [OperArg; 2])> {
+  let mut lams = Vec::with_capacity(arity);
+  let mut host = host;
+  for _ in 0 .. arity {
+    let term = reduce(heap, prog, &[tid], host, false, false);
+    if get_tag(term) != LAM {
+      return None;
+    }
+    lams.push(get_loc(term, 0));
+    host = get_loc(term, 1);
+  }
+  let body = reduce(heap, prog, &[tid], host, false, false);
+  if get_tag(body) != OP2 {
+    return None;
+  }
+  let mut args = [OperArg::Num(0); 2];
+  for (i, arg) in args.iter_mut().enumerate() {
+    let mut val = load_arg(heap, body, i as u64);
+    // A variable that is used twice is read through a dup
+    while get_tag(val) == DP0 || get_tag(val) == DP1 {
+      val = load_arg(heap, val, 2);
+    }
+    if get_tag(val) == VAR {
+      *arg = OperArg::Var(lams.iter().position(|lam| *lam == get_loc(val, 0))?);
+    } else if get_tag(val) == tag {
+      *arg = OperArg::Num(get_num(val));
+    } else {
+      return None;
+    }
+  }
+  return Some((get_ext(body), args));
+}
+
+#[inline(always)]
+fn word(bytes: &[u8]) -> u64 {
+  return u64::from_le_bytes(bytes.try_into().unwrap());
+}
+
+pub fn get_array_elem(bytes: &[u8], index: usize) -> u64 {
+  return word(&bytes[index * 8 .. index * 8 + 8]);
+}
+
+pub fn get_array_elems(bytes: &[u8]) -> impl Iterator<Item = u64> + '_ {
+  return bytes.chunks_exact(8).map(word);
+}
+
+// Packs numbers into an array's bytes
+pub fn array_bytes(elems: &[u64]) -> Vec<u8> {
+  let mut data = vec![0; elems.len() * 8];
+  for (cell, elem) in data.chunks_exact_mut(8).zip(elems) {
+    cell.copy_from_slice(&elem.to_le_bytes());
+  }
+  return data;
+}
+
+// Calls `$body` with `$f` bound to the `u60` or `f60` function of an operator
+macro_rules! with_oper {
+  ($kind:expr, $oper:expr, $f:ident => $body:expr) => {
+    match ($kind == BUFFER_F60, $oper) {
+      (false, ADD) => { let $f = u60::add; $body }
+      (false, SUB) => { let $f = u60::sub; $body }
+      (false, MUL) => { let $f = u60::mul; $body }
+      (false, DIV) => { let $f = u60::div; $body }
+      (false, MOD) => { let $f = u60::mdl; $body }
+      (false, AND) => { let $f = u60::and; $body }
+      (false, OR ) => { let $f = u60::or;  $body }
+      (false, XOR) => { let $f = u60::xor; $body }
+      (false, SHL) => { let $f = u60::shl; $body }
+      (false, SHR) => { let $f = u60::shr; $body }
+      (false, LTN) => { let $f = u60::ltn; $body }
+      (false, LTE) => { let $f = u60::lte; $body }
+      (false, EQL) => { let $f = u60::eql; $body }
+      (false, GTE) => { let $f = u60::gte; $body }
+      (false, GTN) => { let $f = u60::gtn; $body }
+      (false, NEQ) => { let $f = u60::neq; $body }
+      (true,  ADD) => { let $f = f60::add; $body }
+      (true,  SUB) => { let $f = f60::sub; $body }
+      (true,  MUL) => { let $f = f60::mul; $body }
+      (true,  DIV) => { let $f = f60::div; $body }
+      (true,  MOD) => { let $f = f60::mdl; $body }
+      (true,  AND) => { let $f = f60::and; $body }
+      (true,  OR ) => { let $f = f60::or;  $body }
+      (true,  XOR) => { let $f = f60::xor; $body }
+      (true,  SHL) => { let $f = f60::shl; $body }
+      (true,  SHR) => { let $f = f60::shr; $body }
+      (true,  LTN) => { let $f = f60::ltn; $body }
+      (true,  LTE) => { let $f = f60::lte; $body }
+      (true,  EQL) => { let $f = f60::eql; $body }
+      (true,  GTE) => { let $f = f60::gte; $body }
+      (true,  GTN) => { let $f = f60::gtn; $body }
+      (true,  NEQ) => { let $f = f60::neq; $body }
+      _ => { let $f = |_, _| 0; $body }
+    }
+  };
+}
+
+// Element-wise
+// ------------
+
+#[inline(always)]
+fn zip_with(a: Operand, b: Operand, out: &mut [u8], f: impl Fn(u64, u64) -> u64) {
+  match (a, b) {
+    (Operand::Elems(a), Operand::Elems(b)) => {
+      for ((cell, a), b) in out.chunks_exact_mut(8).zip(a.chunks_exact(8)).zip(b.chunks_exact(8)) {
+        cell.copy_from_slice(&f(word(a), word(b)).to_le_bytes());
+      }
+    }
+    (Operand::Elems(a), Operand::Num(b)) => {
+      for (cell, a) in out.chunks_exact_mut(8).zip(a.chunks_exact(8)) {
+        cell.copy_from_slice(&f(word(a), b).to_le_bytes());
+      }
+    }
+    (Operand::Num(a), Operand::Elems(b)) => {
+      for (cell, b) in out.chunks_exact_mut(8).zip(b.chunks_exact(8)) {
+        cell.copy_from_slice(&f(a, word(b)).to_le_bytes());
+      }
+    }
+    (Operand::Num(a), Operand::Num(b)) => {
+      let c = f(a, b).to_le_bytes();
+      for cell in out.chunks_exact_mut(8) {
+        cell.copy_from_slice(&c);
+      }
+    }
+  }
+}
+
+#[inline(always)]
+fn zip_any(kind: u64, oper: u64, a: Operand, b: Operand, out: &mut [u8]) {
+  with_oper!(kind, oper, f => zip_with(a, b, out, f));
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn zip_avx2(kind: u64, oper: u64, a: Operand, b: Operand, out: &mut [u8]) {
+  zip_any(kind, oper, a, b, out);
+}
+
+// Applies `oper` to each pair of elements of `a` and `b`, returning `size` results' bytes
+pub fn array_zip(kind: u64, oper: u64, a: Operand, b: Operand, size: usize) -> Vec<u8> {
+  let mut out = vec![0; size * 8];
+  #[cfg(target_arch = "x86_64")]
+  if is_x86_feature_detected!("avx2") {
+    unsafe { zip_avx2(kind, oper, a, b, &mut out) };
+    return out;
+  }
+  zip_any(kind, oper, a, b, &mut out);
+  return out;
+}
+
+// Folds
+// -----
+
+#[inline(always)]
+fn fold_with(init: u64, elems: &[u8], flip: bool, f: impl Fn(u64, u64) -> u64) -> u64 {
+  if flip {
+    return elems.chunks_exact(8).fold(init, |acc, x| f(word(x), acc));
+  } else {
+    return elems.chunks_exact(8).fold(init, |acc, x| f(acc, word(x)));
+  }
+}
+
+#[inline(always)]
+fn fold_any(kind: u64, oper: u64, init: u64, elems: &[u8], flip: bool) -> u64 {
+  // Masking commutes with wrapping sums and products, and the bitwise operators are exact, so these
+  // folds can be reassociated into lane-wise reductions. Nothing else can, including every F60 one.
+  if kind == BUFFER_U60 {
+    let elems = elems.chunks_exact(8).map(word);
+    match oper {
+      ADD => { return u60::add(init, u60::new(elems.fold(0, u64::wrapping_add))); }
+      MUL => { return u60::mul(init, u60::new(elems.fold(1, u64::wrapping_mul))); }
+      AND => { return elems.fold(init, |a, b| a & b); }
+      OR  => { return elems.fold(init, |a, b| a | b); }
+      XOR => { return elems.fold(init, |a, b| a ^ b); }
+      _   => {}
+    }
+  }
+  with_oper!(kind, oper, f => fold_with(init, elems, flip, f))
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn fold_avx2(kind: u64, oper: u64, init: u64, elems: &[u8], flip: bool) -> u64 {
+  return fold_any(kind, oper, init, elems, flip);
+}
+
+// Folds the elements with `oper`, from the left, as `(oper acc x)`, or `(oper x acc)` if `flip`
+pub fn array_fold(kind: u64, oper: u64, init: u64, elems: &[u8], flip: bool) -> u64 {
+  #[cfg(target_arch = "x86_64")]
+  if is_x86_feature_detected!("avx2") {
+    return unsafe { fold_avx2(kind, oper, init, elems, flip) };
+  }
+  return fold_any(kind, oper, init, elems, flip);
+}
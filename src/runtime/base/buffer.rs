@@ -0,0 +1,163 @@
+// Buffers
+// -------
+// A buffer is a packed byte string: a BUF pointer to a 3-cell node that names a slice of bytes on
+// `heap.bufs`. It stands for the `String.cons`/`String.nil` list of its characters, decoded as
+// UTF-8 (a byte that doesn't start a valid character stands for itself), so code that matches on
+// strings works on buffers unchanged: when a function matches a buffer on a strict argument, its
+// first character is unpacked in place (see `unpack_buffer`). Each node owns one reference to its
+// bytes, so duplicating a buffer copies the node and shares the bytes, and slicing one only moves
+// its bounds. Buffers therefore take 24 bytes of heap, instead of 16 per character.
+//
+// A buffer can also hold numbers, 8 little-endian bytes each (see `array.rs`). Its kind is kept on
+// the pointer's ext, and its bounds count elements, so slicing and indexing work on any kind. Only
+// byte buffers stand for strings; a number buffer is only read by the primitives.
+
+use crate::runtime::{*};
+
+// Buffer kinds
+pub const BUFFER_BYTES : u64 = 0;
+pub const BUFFER_U60 : u64 = 1;
+pub const BUFFER_F60 : u64 = 2;
+
+// Allocates a node for `size` elements of the buffer at `slot`, from `init`, taking one reference
+pub fn alloc_buffer(heap: &Heap, tid: usize, kind: u64, slot: u64, init: u64, size: u64) -> Ptr {
+  let node = alloc(heap, tid, 3);
+  link(heap, node + 0, U6O(slot));
+  link(heap, node + 1, U6O(init));
+  link(heap, node + 2, U6O(size));
+  return Buf(kind, node);
+}
+
+// Moves `data` to the heap's buffers, without copying it
+pub fn make_buffer(heap: &Heap, tid: usize, kind: u64, data: Vec<u8>) -> Ptr {
+  let size = data.len() as u64 / get_buffer_width(kind);
+  let slot = heap.bufs.insert(data.into_boxed_slice());
+  return alloc_buffer(heap, tid, kind, slot, 0, size);
+}
+
+pub fn get_buffer_kind(term: Ptr) -> u64 {
+  return get_ext(term);
+}
+
+// The size of an element, in bytes
+#[inline(always)]
+pub fn get_buffer_width(kind: u64) -> u64 {
+  return if kind == BUFFER_BYTES { 1 } else { 8 };
+}
+
+pub fn is_byte_buffer(term: Ptr) -> bool {
+  return get_tag(term) == BUF && get_buffer_kind(term) == BUFFER_BYTES;
+}
+
+pub fn get_buffer_slot(heap: &Heap, term: Ptr) -> u64 {
+  return get_num(load_arg(heap, term, 0));
+}
+
+pub fn get_buffer_init(heap: &Heap, term: Ptr) -> u64 {
+  return get_num(load_arg(heap, term, 1));
+}
+
+pub fn get_buffer_size(heap: &Heap, term: Ptr) -> u64 {
+  return get_num(load_arg(heap, term, 2));
+}
+
+// The bytes of a buffer, valid while its node is alive
+pub fn get_buffer_bytes(heap: &Heap, term: Ptr) -> &[u8] {
+  let width = get_buffer_width(get_buffer_kind(term)) as usize;
+  let init = get_buffer_init(heap, term) as usize * width;
+  let size = get_buffer_size(heap, term) as usize * width;
+  return &heap.bufs.get(get_buffer_slot(heap, term))[init .. init + size];
+}
+
+// The `index`th element of a buffer, as a number, if it's in bounds
+pub fn get_buffer_elem(heap: &Heap, term: Ptr, index: u64) -> Option<Ptr> {
+  if index >= get_buffer_size(heap, term) {
+    return None;
+  }
+  let bytes = get_buffer_bytes(heap, term);
+  match get_buffer_kind(term) {
+    BUFFER_BYTES => Some(U6O(bytes[index as usize] as u64)),
+    BUFFER_U60 => Some(U6O(get_array_elem(bytes, index as usize))),
+    _ => Some(F6O(get_array_elem(bytes, index as usize))),
+  }
+}
+
+// Copies a buffer's node, sharing its bytes
+pub fn share_buffer(heap: &Heap, tid: usize, term: Ptr) -> Ptr {
+  let slot = get_buffer_slot(heap, term);
+  heap.bufs.share(slot);
+  return alloc_buffer(heap, tid, get_buffer_kind(term), slot, get_buffer_init(heap, term), get_buffer_size(heap, term));
+}
+
+// Narrows a buffer, in place, to `size` elements from its `init`th. Both are clamped to its bounds.
+pub fn slice_buffer(heap: &Heap, term: Ptr, init: u64, size: u64) {
+  let old_init = get_buffer_init(heap, term);
+  let old_size = get_buffer_size(heap, term);
+  let init = std::cmp::min(init, old_size);
+  let size = std::cmp::min(size, old_size - init);
+  link(heap, get_loc(term, 1), U6O(old_init + init));
+  link(heap, get_loc(term, 2), U6O(size));
+}
+
+pub fn free_buffer(heap: &Heap, tid: usize, term: Ptr) {
+  heap.bufs.release(get_buffer_slot(heap, term));
+  free(heap, tid, get_loc(term, 0), 3);
+}
+
+// Decodes the character at the start of `bytes`, which can't be empty, returning it and its size
+#[inline(always)]
+pub fn buffer_char(bytes: &[u8]) -> (u64, usize) {
+  if bytes[0] < 0x80 {
+    return (bytes[0] as u64, 1);
+  }
+  let head = &bytes[.. std::cmp::min(bytes.len(), 4)];
+  let text = match std::str::from_utf8(head) {
+    Ok(text) => text,
+    Err(err) => unsafe { std::str::from_utf8_unchecked(&head[.. err.valid_up_to()]) },
+  };
+  match text.chars().next() {
+    Some(chr) => (chr as u64, chr.len_utf8()),
+    None => (bytes[0] as u64, 1),
+  }
+}
+
+// Decodes a buffer's bytes to text, as `buffer_char` does
+pub fn buffer_text(bytes: &[u8]) -> String {
+  if let Ok(text) = std::str::from_utf8(bytes) {
+    return text.to_string();
+  }
+  let mut text = String::with_capacity(bytes.len());
+  let mut init = 0;
+  while init < bytes.len() {
+    let (chr, size) = buffer_char(&bytes[init ..]);
+    text.push(std::char::from_u32(chr as u32).unwrap_or('?'));
+    init += size;
+  }
+  return text;
+}
+
+// Replaces the buffer at `host` by its first `String.cons`, whose tail is the rest of the buffer
+// (reusing its node), or by `String.nil` if it's empty. Returns the new term. Number buffers are
+// left as they are.
+pub fn unpack_buffer(heap: &Heap, tid: usize, host: u64) -> Ptr {
+  let term = load_ptr(heap, host);
+  if get_buffer_kind(term) != BUFFER_BYTES {
+    return term;
+  }
+  let bytes = get_buffer_bytes(heap, term);
+  if bytes.is_empty() {
+    free_buffer(heap, tid, term);
+    let done = Ctr(STRING_NIL, 0);
+    link(heap, host, done);
+    return done;
+  } else {
+    let (chr, size) = buffer_char(bytes);
+    slice_buffer(heap, term, size as u64, u64::MAX);
+    let cons = alloc(heap, tid, 2);
+    link(heap, cons + 0, U6O(chr));
+    link(heap, cons + 1, term);
+    let done = Ctr(STRING_CONS, cons);
+    link(heap, host, done);
+    return done;
+  }
+}
@@ -0,0 +1,451 @@
+// Cache
+// -----
+// Keeps the front-end output (the RuleBook and the interpreted Functions built from it) on disk, so
+// that running the same code again skips parsing, sanitizing and building rules. Entries live in
+// `<dir>/<key>.hvmc`, where the key is an FNV-1a hash of the code, the HVM version and the
+// precompiled function count (which determines the ids of user functions). That hash is only a
+// name: each entry also holds its code, which must equal the one being loaded, so two codes with
+// the same key just replace each other's entry. A cached RuleBook has no `rule_group`, since only
+// the compiler needs the source rules. An unreadable or stale entry is treated as a miss. Once a
+// directory has more than CACHE_MAX_ENTRIES entries, the least recently used ones are removed.
+// Entries are a sequence of native-endian u64 words; strings are a length followed by their bytes,
+// padded to 8.
+
+use crate::language;
+use crate::runtime::{*};
+use std::collections::HashMap;
+use std::path::{Path, PathBuf};
+use std::time::SystemTime;
+
+pub const CACHE_MAGIC : u64 = u64::from_le_bytes(*b"HVMCACH\0");
+pub const CACHE_VERSION : u64 = 5;
+pub const CACHE_MAX_ENTRIES : usize = 64;
+
+// The cache directory: $HVM_CACHE_DIR, else $XDG_CACHE_HOME/hvm, else $HOME/.cache/hvm
+pub fn default_cache_dir() -> Option<PathBuf> {
+  if let Some(dir) = std::env::var_os("HVM_CACHE_DIR") {
+    return Some(PathBuf::from(dir));
+  }
+  if let Some(dir) = std::env::var_os("XDG_CACHE_HOME") {
+    return Some(PathBuf::from(dir).join("hvm"));
+  }
+  if let Some(dir) = std::env::var_os("HOME") {
+    return Some(PathBuf::from(dir).join(".cache").join("hvm"));
+  }
+  return None;
+}
+
+// Unlike `hash`, stays the same across builds, so entries are found by later versions of the binary
+pub fn cache_key(code: &str) -> u64 {
+  let mut key = 0xcbf29ce484222325;
+  let head = format!("{}\0{}\0{}\0", env!("CARGO_PKG_VERSION"), PRECOMP_COUNT, CACHE_VERSION);
+  for byte in head.bytes().chain(code.bytes()) {
+    key = (key ^ byte as u64).wrapping_mul(0x100000001b3);
+  }
+  return key;
+}
+
+// Builds the RuleBook and Functions of a code, reusing the cached ones on `dir`, if any
+pub fn load_book(code: &str, dir: Option<&Path>) -> Result<(language::rulebook::RuleBook, Funs), String> {
+  let path = dir.map(|dir| dir.join(format!("{:016x}.hvmc", cache_key(code))));
+  if let Some(path) = &path {
+    if let Some(got) = std::fs::read(path).ok().and_then(|data| get_cache(&data, code)) {
+      // Marks the entry as used, for `evict`
+      std::fs::File::options().append(true).open(path).and_then(|file| file.set_modified(SystemTime::now())).ok();
+      return Ok(got);
+    }
+  }
+  let file = language::syntax::read_file(code)?;
+  let book = language::rulebook::gen_rulebook(&file);
+  let funs = gen_functions(&book);
+  if let Some(path) = &path {
+    // Writes to a temporary file first, so that concurrent runs never read a partial entry
+    let temp = path.with_extension(format!("{}.tmp", std::process::id()));
+    if let Some(dir) = dir {
+      std::fs::create_dir_all(dir).ok();
+    }
+    if std::fs::write(&temp, put_cache(code, &book, &funs)).is_ok() {
+      std::fs::rename(&temp, path).ok();
+    }
+    if let Some(dir) = dir {
+      evict(dir);
+    }
+  }
+  return Ok((book, funs));
+}
+
+// Removes the least recently used entries of a directory, past CACHE_MAX_ENTRIES. Failures are
+// ignored, since another run may be evicting the same entries.
+fn evict(dir: &Path) {
+  let mut entries = match std::fs::read_dir(dir) {
+    Ok(entries) => entries.filter_map(|entry| {
+      let path = entry.ok()?.path();
+      if path.extension()? != "hvmc" {
+        return None;
+      }
+      return Some((std::fs::metadata(&path).ok()?.modified().ok()?, path));
+    }).collect::<Vec<(SystemTime, PathBuf)>>(),
+    Err(_) => {
+      return;
+    }
+  };
+  if entries.len() > CACHE_MAX_ENTRIES {
+    entries.sort();
+    for (_, path) in &entries[.. entries.len() - CACHE_MAX_ENTRIES] {
+      std::fs::remove_file(path).ok();
+    }
+  }
+}
+
+// Encoding
+// --------
+
+fn put_cache(code: &str, book: &language::rulebook::RuleBook, funs: &Funs) -> Vec<u8> {
+  let mut data = vec![CACHE_MAGIC, CACHE_VERSION];
+  put_str(&mut data, code);
+  data.push(book.name_count);
+  data.push(book.name_to_id.len() as u64);
+  for (name, id) in &book.name_to_id {
+    put_str(&mut data, name);
+    data.push(*id);
+  }
+  data.push(book.id_to_smap.len() as u64);
+  for (id, smap) in &book.id_to_smap {
+    data.push(*id);
+    put_bools(&mut data, smap);
+  }
+  data.push(book.id_to_name.len() as u64);
+  for (id, name) in &book.id_to_name {
+    data.push(*id);
+    put_str(&mut data, name);
+  }
+  data.push(book.ctr_is_fun.len() as u64);
+  for (name, is_fun) in &book.ctr_is_fun {
+    put_str(&mut data, name);
+    data.push(*is_fun as u64);
+  }
+  let interpreted = funs.data.iter().enumerate().filter_map(|(fid, fun)| match fun {
+    Some(Function::Interpreted { smap, visit, apply }) => Some((fid, smap, visit, apply)),
+    _ => None,
+  }).collect::<Vec<_>>();
+  data.push(interpreted.len() as u64);
+  for (fid, smap, visit, apply) in interpreted {
+    data.push(fid as u64);
+    put_bools(&mut data, smap);
+    put_bools(&mut data, &visit.strict_map);
+    put_u64s(&mut data, &visit.strict_idx);
+    data.push(apply.memo as u64);
+    data.push(apply.rules.len() as u64);
+    for rule in &apply.rules {
+      data.push(rule.hoas as u64);
+      put_u64s(&mut data, &rule.cond);
+      data.push(rule.vars.len() as u64);
+      for var in &rule.vars {
+        data.push(var.param);
+        data.push(var.field.map(|x| x + 1).unwrap_or(0));
+        data.push(var.erase as u64);
+      }
+      put_core(&mut data, &rule.core);
+      put_cell(&mut data, &rule.body.root);
+      data.push(rule.body.cells.len() as u64);
+      for cell in &rule.body.cells {
+        put_cell(&mut data, cell);
+      }
+      put_u64s(&mut data, &rule.body.nodes);
+      data.push(rule.body.dupk);
+      data.push(rule.free.len() as u64);
+      for (param, arity) in &rule.free {
+        data.push(*param);
+        data.push(*arity);
+      }
+    }
+  }
+  return data.iter().flat_map(|x| x.to_ne_bytes()).collect();
+}
+
+fn put_str(data: &mut Vec<u64>, text: &str) {
+  data.push(text.len() as u64);
+  for part in text.as_bytes().chunks(8) {
+    let mut word = [0; 8];
+    word[.. part.len()].copy_from_slice(part);
+    data.push(u64::from_ne_bytes(word));
+  }
+}
+
+fn put_bools(data: &mut Vec<u64>, bools: &[bool]) {
+  data.push(bools.len() as u64);
+  data.extend(bools.iter().map(|x| *x as u64));
+}
+
+fn put_u64s(data: &mut Vec<u64>, vals: &[u64]) {
+  data.push(vals.len() as u64);
+  data.extend_from_slice(vals);
+}
+
+fn put_cell(data: &mut Vec<u64>, cell: &RuleBodyCell) {
+  match cell {
+    RuleBodyCell::Val { value } => {
+      data.extend_from_slice(&[0, *value]);
+    }
+    RuleBodyCell::Var { index } => {
+      data.extend_from_slice(&[1, *index]);
+    }
+    RuleBodyCell::Ptr { value, targ, slot } => {
+      data.extend_from_slice(&[2, *value, *targ, *slot]);
+    }
+  }
+}
+
+fn put_core(data: &mut Vec<u64>, core: &Core) {
+  match core {
+    Core::Var { bidx } => {
+      data.extend_from_slice(&[0, *bidx]);
+    }
+    Core::Glo { glob, misc } => {
+      data.extend_from_slice(&[1, *glob, *misc]);
+    }
+    Core::Dup { eras, glob, expr, body } => {
+      data.extend_from_slice(&[2, eras.0 as u64, eras.1 as u64, *glob]);
+      put_core(data, expr);
+      put_core(data, body);
+    }
+    Core::Sup { val0, val1 } => {
+      data.push(3);
+      put_core(data, val0);
+      put_core(data, val1);
+    }
+    Core::Let { expr, body } => {
+      data.push(4);
+      put_core(data, expr);
+      put_core(data, body);
+    }
+    Core::Lam { eras, glob, body } => {
+      data.extend_from_slice(&[5, *eras as u64, *glob]);
+      put_core(data, body);
+    }
+    Core::App { func, argm } => {
+      data.push(6);
+      put_core(data, func);
+      put_core(data, argm);
+    }
+    Core::Fun { func, args } => {
+      data.extend_from_slice(&[7, *func, args.len() as u64]);
+      for arg in args {
+        put_core(data, arg);
+      }
+    }
+    Core::Ctr { func, args } => {
+      data.extend_from_slice(&[8, *func, args.len() as u64]);
+      for arg in args {
+        put_core(data, arg);
+      }
+    }
+    Core::U6O { numb } => {
+      data.extend_from_slice(&[9, *numb]);
+    }
+    Core::F6O { numb } => {
+      data.extend_from_slice(&[10, *numb]);
+    }
+    Core::Op2 { oper, val0, val1 } => {
+      data.extend_from_slice(&[11, *oper]);
+      put_core(data, val0);
+      put_core(data, val1);
+    }
+  }
+}
+
+// Decoding
+// --------
+
+struct CacheReader<'a> {
+  data: &'a [u8],
+  next: usize,
+}
+
+impl<'a> CacheReader<'a> {
+  fn get(&mut self) -> Option<u64> {
+    let word = self.data.get(self.next .. self.next + 8)?;
+    self.next += 8;
+    return Some(u64::from_ne_bytes(word.try_into().ok()?));
+  }
+
+  // Reads a length, refusing ones that couldn't possibly fit in the remaining data
+  fn len(&mut self) -> Option<usize> {
+    let len = self.get()? as usize;
+    if len > self.data.len() {
+      return None;
+    }
+    return Some(len);
+  }
+
+  fn get_str(&mut self) -> Option<String> {
+    let len = self.len()?;
+    let mut bytes = vec![];
+    for _ in 0 .. (len + 7) / 8 {
+      bytes.extend_from_slice(&self.get()?.to_ne_bytes());
+    }
+    bytes.truncate(len);
+    return String::from_utf8(bytes).ok();
+  }
+
+  fn get_bools(&mut self) -> Option<Vec<bool>> {
+    let len = self.len()?;
+    return (0 .. len).map(|_| self.get().map(|x| x != 0)).collect();
+  }
+
+  fn get_u64s(&mut self) -> Option<Vec<u64>> {
+    let len = self.len()?;
+    return (0 .. len).map(|_| self.get()).collect();
+  }
+
+  fn get_cell(&mut self) -> Option<RuleBodyCell> {
+    match self.get()? {
+      0 => Some(RuleBodyCell::Val { value: self.get()? }),
+      1 => Some(RuleBodyCell::Var { index: self.get()? }),
+      2 => Some(RuleBodyCell::Ptr { value: self.get()?, targ: self.get()?, slot: self.get()? }),
+      _ => None,
+    }
+  }
+
+  fn get_core(&mut self) -> Option<Core> {
+    match self.get()? {
+      0 => Some(Core::Var { bidx: self.get()? }),
+      1 => Some(Core::Glo { glob: self.get()?, misc: self.get()? }),
+      2 => Some(Core::Dup { eras: (self.get()? != 0, self.get()? != 0), glob: self.get()?, expr: Box::new(self.get_core()?), body: Box::new(self.get_core()?) }),
+      3 => Some(Core::Sup { val0: Box::new(self.get_core()?), val1: Box::new(self.get_core()?) }),
+      4 => Some(Core::Let { expr: Box::new(self.get_core()?), body: Box::new(self.get_core()?) }),
+      5 => Some(Core::Lam { eras: self.get()? != 0, glob: self.get()?, body: Box::new(self.get_core()?) }),
+      6 => Some(Core::App { func: Box::new(self.get_core()?), argm: Box::new(self.get_core()?) }),
+      7 => Some(Core::Fun { func: self.get()?, args: { let len = self.len()?; (0 .. len).map(|_| self.get_core()).collect::<Option<Vec<Core>>>()? } }),
+      8 => Some(Core::Ctr { func: self.get()?, args: { let len = self.len()?; (0 .. len).map(|_| self.get_core()).collect::<Option<Vec<Core>>>()? } }),
+      9 => Some(Core::U6O { numb: self.get()? }),
+      10 => Some(Core::F6O { numb: self.get()? }),
+      11 => Some(Core::Op2 { oper: self.get()?, val0: Box::new(self.get_core()?), val1: Box::new(self.get_core()?) }),
+      _ => None,
+    }
+  }
+}
+
+// Decodes an entry, if it was made from `code`
+fn get_cache(data: &[u8], code: &str) -> Option<(language::rulebook::RuleBook, Funs)> {
+  let mut read = CacheReader { data, next: 0 };
+  if read.get()? != CACHE_MAGIC || read.get()? != CACHE_VERSION || read.get_str()? != code {
+    return None;
+  }
+  let mut book = language::rulebook::new_rulebook();
+  book.name_count = read.get()?;
+  for _ in 0 .. read.len()? {
+    let name = read.get_str()?;
+    book.name_to_id.insert(name, read.get()?);
+  }
+  for _ in 0 .. read.len()? {
+    let id = read.get()?;
+    book.id_to_smap.insert(id, read.get_bools()?);
+  }
+  for _ in 0 .. read.len()? {
+    let id = read.get()?;
+    book.id_to_name.insert(id, read.get_str()?);
+  }
+  for _ in 0 .. read.len()? {
+    let name = read.get_str()?;
+    book.ctr_is_fun.insert(name, read.get()? != 0);
+  }
+  let mut funs = U64Map::new();
+  for _ in 0 .. read.len()? {
+    let fid = read.get()?;
+    let smap = read.get_bools()?.into_boxed_slice();
+    let strict_map = read.get_bools()?;
+    let strict_idx = read.get_u64s()?;
+    let memo = read.get()? != 0;
+    let mut rules = vec![];
+    for _ in 0 .. read.len()? {
+      let hoas = read.get()? != 0;
+      let cond = read.get_u64s()?;
+      let mut vars = vec![];
+      for _ in 0 .. read.len()? {
+        let param = read.get()?;
+        let field = read.get()?;
+        let erase = read.get()? != 0;
+        vars.push(RuleVar { param, field: if field == 0 { None } else { Some(field - 1) }, erase });
+      }
+      let core = read.get_core()?;
+      let root = read.get_cell()?;
+      let mut cells = vec![];
+      for _ in 0 .. read.len()? {
+        cells.push(read.get_cell()?);
+      }
+      let nodes = read.get_u64s()?;
+      if nodes.is_empty() || nodes[nodes.len() - 1] != cells.len() as u64 || nodes.windows(2).any(|x| x[0] > x[1]) {
+        return None;
+      }
+      let dupk = read.get()?;
+      let mut free = vec![];
+      for _ in 0 .. read.len()? {
+        free.push((read.get()?, read.get()?));
+      }
+      let body = RuleBody { root, cells, nodes, dupk };
+      let reuse = build_reuse(&free, cond.len() as u64, &body);
+      rules.push(Rule { hoas, cond, vars, core, body, free, reuse });
+    }
+    let tree = build_match_tree(&rules, &strict_idx);
+    funs.insert(fid, Function::Interpreted { smap, visit: VisitObj { strict_map, strict_idx }, apply: ApplyObj { rules, tree, jit: None, memo } });
+  }
+  if read.next != data.len() {
+    return None;
+  }
+  return Some((book, funs));
+}
+
+#[cfg(test)]
+mod tests {
+  use super::*;
+
+  const CODE : &str = "
+    (Len List.nil) = 0
+    (Len (List.cons x xs)) = (+ 1 (Len xs))
+    (Main) = (Len (List.cons 1 (List.cons 2 List.nil)))
+  ";
+
+  fn temp_dir(name: &str) -> PathBuf {
+    let dir = std::env::temp_dir().join(format!("hvm-cache-test-{}-{}", name, std::process::id()));
+    std::fs::remove_dir_all(&dir).ok();
+    return dir;
+  }
+
+  // The rules of each interpreted function, as their body cells, to compare functions that don't
+  // implement PartialEq
+  fn show_funs(funs: &Funs) -> Vec<String> {
+    return funs.data.iter().enumerate().filter_map(|(fid, fun)| match fun {
+      Some(Function::Interpreted { smap, visit, apply }) => {
+        Some(format!("{} {:?} {:?} {:?}", fid, smap, visit.strict_idx, apply.rules.iter().map(|rule| (&rule.cond, &rule.body.cells, &rule.free)).collect::<Vec<_>>()))
+      }
+      _ => None,
+    }).collect();
+  }
+
+  #[test]
+  fn test_cache_round_trip() {
+    let dir = temp_dir("trip");
+    let (book, funs) = load_book(CODE, Some(&dir)).unwrap();
+    let data = std::fs::read(dir.join(format!("{:016x}.hvmc", cache_key(CODE)))).unwrap();
+    let (got_book, got_funs) = get_cache(&data, CODE).unwrap();
+    assert_eq!(got_book.name_to_id, book.name_to_id);
+    assert_eq!(got_book.id_to_name, book.id_to_name);
+    assert_eq!(got_book.id_to_smap, book.id_to_smap);
+    assert_eq!(got_book.ctr_is_fun, book.ctr_is_fun);
+    assert_eq!(show_funs(&got_funs), show_funs(&funs));
+    // An entry is only used for the code it was made from
+    assert!(get_cache(&data, "(Main) = 0").is_none());
+    std::fs::remove_dir_all(&dir).ok();
+  }
+
+  #[test]
+  fn test_cache_evicts_old_entries() {
+    let dir = temp_dir("evict");
+    for i in 0 .. CACHE_MAX_ENTRIES + 4 {
+      load_book(&format!("(Main) = {}", i), Some(&dir)).unwrap();
+    }
+    assert_eq!(std::fs::read_dir(&dir).unwrap().count(), CACHE_MAX_ENTRIES);
+    std::fs::remove_dir_all(&dir).ok();
+  }
+}
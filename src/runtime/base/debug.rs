@@ -26,6 +26,9 @@ pub fn show_ptr(x: Ptr) -> String {
       OP2 => "Op2",
       U60 => "U60",
       F60 => "F60",
+      LCK => "Lck",
+      BUF => "Buf",
+      NIL => "Nil",
       _   => "?",
     };
     format!("{}({:07x}, {:08x})", tgs, ext, val)
@@ -34,7 +37,7 @@ pub fn show_ptr(x: Ptr) -> String {
 
 pub fn show_heap(heap: &Heap) -> String {
   let mut text: String = String::new();
-  for idx in 0 .. heap.node.len() {
+  for idx in 0 .. get_heap_end(heap) {
     let ptr = load_ptr(heap, idx as u64);
     if ptr != 0 {
       text.push_str(&format!("{:04x} | ", idx));
@@ -188,6 +191,15 @@ pub fn show_at(heap: &Heap, prog: &Program, host: u64, tlocs: &[AtomicU64]) -> S
         F60 => {
           format!("{}", f60::val(get_val(term)))
         }
+        BUF => {
+          if is_byte_buffer(term) {
+            format!("{:?}", buffer_text(get_buffer_bytes(heap, term)))
+          } else {
+            let show = if get_buffer_kind(term) == BUFFER_F60 { f60::show } else { u60::show };
+            let elems: Vec<String> = get_array_elems(get_buffer_bytes(heap, term)).map(show).collect();
+            format!("(Array.pack [{}])", elems.join(", "))
+          }
+        }
         CTR | FUN => {
           let func = get_ext(term);
           let arit = arity_of(&prog.aris, term);
@@ -221,7 +233,7 @@ pub fn show_at(heap: &Heap, prog: &Program, host: u64, tlocs: &[AtomicU64]) -> S
 }
 
 pub fn validate_heap(heap: &Heap) {
-  for idx in 0 .. heap.node.len() {
+  for idx in 0 .. get_heap_end(heap) {
     // If it is an ARG, it must be pointing to a VAR/DP0/DP1 that points to it
     let arg = load_ptr(heap, idx as u64);
     if get_tag(arg) == ARG {
@@ -0,0 +1,454 @@
+// Tracing Collector
+// -----------------
+// `collect()` frees a term as soon as it is known to be unreachable, but it can't free a dup node
+// whose other variable is inside its own expression (see the comment above it in `memory.rs`), so
+// a program that keeps making such clones slowly leaks. The tracing collector frees those: it marks
+// the cells of every node reachable from the roots, on a bitset with one bit per cell, then sweeps
+// the heap, giving each cell that wasn't marked, and isn't free already, back to the allocator.
+// Both phases are split between the threads. Each thread then scans its areas from the start.
+//
+// When the heap has a collector, it also runs on its own, in the middle of a reduction, once the
+// number of used cells crosses a fraction of the heap (or twice the cells that were live after the
+// last run, if that's more). The thread that notices asks the others to stop, which they do at the
+// top of their work loop, or while looking for work, where no rewrite is half done; once all of
+// them stopped, they collect together and resume. Since a reduction only knows its own root, that
+// assumes no other term is kept on the heap, except for the values of memoized functions, whose
+// cells are always roots (see `data::memo_table`). A thread can be kept from stopping, by a reducer
+// that a primitive started, for example, while another waits for a dup it locked, so, if the
+// threads don't all stop within GC_WAIT_MICROS, that collection is skipped, and tried again later.
+//
+// Marking also records the dup labels that live pointers carry, so that the label batches nothing
+// reached can be handed out again (see `data::label_space`). A collection is also requested when
+// few free batches are left. On a heap without a collector, outer reductions still stop for that,
+// with one that only marks and reclaims the labels, leaving the heap as it was.
+
+use crate::runtime::{*};
+use std::sync::Mutex;
+use std::sync::atomic::{AtomicBool, AtomicI64, AtomicU64, AtomicUsize, Ordering};
+
+// How many visits a reducer does between checks for a collection
+pub const GC_TICKS : u64 = 1 << 12;
+
+// How long the threads that stopped wait for the others
+pub const GC_WAIT_MICROS : u128 = 50_000;
+
+// After a skipped collection, another 1/GC_RETRY of the heap must be used before trying again
+pub const GC_RETRY : i64 = 16;
+
+// A marking thread shares half of its pending cells, with idle ones, once it has more than this
+pub const GC_SHARE : usize = 256;
+
+pub struct Collector {
+  pub limit: i64,               // used cells that trigger a collection, at least
+  pub next: AtomicI64,          // used cells that trigger the next collection
+  pub reach: MemMap<AtomicU64>, // one bit per cell, set on the cells of reachable nodes
+  pub runs: AtomicU64,          // number of collections
+  pub freed: AtomicU64,         // number of cells they freed
+  pub sweep: bool,              // frees the garbage; if not, it only reclaims dup labels
+}
+
+// The state shared by the threads of a reduction, to stop and collect together
+pub struct Safepoint {
+  pub tids: usize,
+  pub want: AtomicBool,           // a thread asked the others to stop
+  pub join: AtomicUsize,          // number of threads that stopped
+  pub state: AtomicUsize,         // whether they wait, collect or skip it
+  pub barr: Barrier,
+  pub hold: AtomicUsize,          // never 0, so the barrier always waits
+  pub work: Mutex<Vec<Vec<u64>>>, // cells shared between marking threads
+  pub idle: AtomicUsize,          // number of marking threads that ran out of cells
+  pub live: AtomicU64,            // number of cells marked
+  pub gone: AtomicU64,            // number of cells freed
+}
+
+pub const SAFEPOINT_WAIT : usize = 0;
+pub const SAFEPOINT_RUN  : usize = 1;
+pub const SAFEPOINT_SKIP : usize = 2;
+
+// Makes a collector for a heap of `size` cells, triggered once `ratio` of them are used
+pub fn new_collector(heap: &Heap, size: usize, ratio: f64) -> Collector {
+  let limit = (size as f64 * ratio) as i64;
+  return Collector {
+    limit,
+    next: AtomicI64::new(limit),
+    reach: MemMap::new((heap.node.len() + 63) / 64),
+    runs: AtomicU64::new(0),
+    freed: AtomicU64::new(0),
+    sweep: true,
+  };
+}
+
+// Makes a collector that runs only when the dup labels run low, and only reclaims them
+pub fn new_label_collector(heap: &Heap) -> Collector {
+  return Collector {
+    limit: i64::MAX,
+    next: AtomicI64::new(i64::MAX),
+    reach: MemMap::new((heap.node.len() + 63) / 64),
+    runs: AtomicU64::new(0),
+    freed: AtomicU64::new(0),
+    sweep: false,
+  };
+}
+
+impl Safepoint {
+  pub fn new(tids: usize) -> Safepoint {
+    return Safepoint {
+      tids,
+      want: AtomicBool::new(false),
+      join: AtomicUsize::new(0),
+      state: AtomicUsize::new(SAFEPOINT_WAIT),
+      barr: Barrier::new(tids),
+      hold: AtomicUsize::new(1),
+      work: Mutex::new(Vec::new()),
+      idle: AtomicUsize::new(0),
+      live: AtomicU64::new(0),
+      gone: AtomicU64::new(0),
+    };
+  }
+}
+
+// Whether a reducer should stop for a collection, either because another thread asked, or because
+// the heap crossed the threshold, or the dup labels are running out
+pub fn should_collect(heap: &Heap, gc: &Collector, safe: &Safepoint) -> bool {
+  return safe.want.load(Ordering::Relaxed) || get_used(heap) > gc.next.load(Ordering::Relaxed) || heap.labs.is_low();
+}
+
+// Stops this reducer until the others stopped too, and collects from `roots` with them, or until
+// it gives up. `index` is the thread's position on the reduction's tids.
+pub fn safepoint(heap: &Heap, prog: &Program, gc: &Collector, safe: &Safepoint, index: usize, tid: usize, roots: &[u64], stop: &AtomicUsize, full: bool) {
+  safe.want.store(true, Ordering::Relaxed);
+  safe.join.fetch_add(1, Ordering::SeqCst);
+  let init = instant::Instant::now();
+  loop {
+    match safe.state.load(Ordering::Acquire) {
+      SAFEPOINT_RUN => {
+        break;
+      }
+      SAFEPOINT_SKIP => {
+        // The last thread to leave lets the threshold grow, and resets the state
+        if safe.join.fetch_sub(1, Ordering::SeqCst) == 1 {
+          gc.next.store(get_used(heap) + gc.limit / GC_RETRY, Ordering::Relaxed);
+          safe.want.store(false, Ordering::Relaxed);
+          safe.state.store(SAFEPOINT_WAIT, Ordering::Release);
+        }
+        return;
+      }
+      _ => {
+        if safe.join.load(Ordering::SeqCst) == safe.tids {
+          let _ = safe.state.compare_exchange(SAFEPOINT_WAIT, SAFEPOINT_RUN, Ordering::AcqRel, Ordering::Relaxed);
+        } else if stop.load(Ordering::Relaxed) == 0 || init.elapsed().as_micros() > GC_WAIT_MICROS {
+          let _ = safe.state.compare_exchange(SAFEPOINT_WAIT, SAFEPOINT_SKIP, Ordering::AcqRel, Ordering::Relaxed);
+        } else {
+          std::thread::yield_now();
+        }
+      }
+    }
+  }
+  collect_with(heap, prog, gc, safe, index, tid, roots);
+  if index == 0 {
+    // Parts of the normal form may have been marked, by `normalize`, on cells that were now freed
+    if full && gc.sweep {
+      heap.dirt.store(true, Ordering::Relaxed);
+    }
+    safe.join.store(0, Ordering::Relaxed);
+    safe.want.store(false, Ordering::Relaxed);
+    safe.state.store(SAFEPOINT_WAIT, Ordering::Release);
+  }
+  safe.barr.wait(&safe.hold);
+}
+
+// Collects every node that isn't reachable from `roots`, on the heap's thread pool, while nothing
+// else uses the heap. Returns how many cells were freed.
+pub fn collect_garbage(heap: &Heap, prog: &Program, tids: &[usize], roots: &[u64]) -> u64 {
+  let own;
+  let gc = match &heap.gc {
+    Some(gc) => gc,
+    None => {
+      own = new_collector(heap, 0, 0.0);
+      &own
+    }
+  };
+  let safe = &Safepoint::new(tids.len());
+  heap.pool.run(tids.len(), &|i| {
+    collect_with(heap, prog, gc, safe, i, tids[i], roots);
+  });
+  return safe.gone.load(Ordering::Relaxed);
+}
+
+// Runs a collection on one of the `safe.tids` threads that take part in it
+fn collect_with(heap: &Heap, prog: &Program, gc: &Collector, safe: &Safepoint, index: usize, tid: usize, roots: &[u64]) {
+  let roots = if index == 0 { heap.memo.entries().iter().map(|(_, cell)| *cell).chain(roots.iter().cloned()).collect() } else { vec![] };
+  mark(heap, prog, gc, safe, &roots);
+  safe.barr.wait(&safe.hold);
+  let (init, last) = sweep_range(heap, gc, index, safe.tids);
+  if gc.sweep {
+    unlink(heap, gc, init, last);
+    safe.barr.wait(&safe.hold);
+    let freed = clear(heap, gc, tid, init, last);
+    unsafe { *heap.lvar.get_unchecked(tid).used.as_mut_ptr() -= freed as i64 };
+    // The cells freed can be anywhere on the thread's areas, so it scans them from the start again,
+    // reusing those before the ones past its cursor
+    rewind_area(heap, tid);
+    safe.gone.fetch_add(freed, Ordering::Relaxed);
+  } else {
+    unmark(gc, init, last);
+  }
+  safe.barr.wait(&safe.hold);
+  if index == 0 {
+    let live = safe.live.swap(0, Ordering::Relaxed) as i64;
+    if gc.sweep {
+      // Sets the used count to the cells that were marked, which also counts nodes on the heap
+      // that weren't allocated by this process, like those of a snapshot
+      unsafe { *heap.lvar.get_unchecked(tid).used.as_mut_ptr() += live - get_used(heap) };
+      gc.next.store(std::cmp::max(gc.limit, live * 2), Ordering::Relaxed);
+      gc.freed.fetch_add(safe.gone.load(Ordering::Relaxed), Ordering::Relaxed);
+    }
+    gc.runs.fetch_add(1, Ordering::Relaxed);
+    safe.idle.store(0, Ordering::Relaxed);
+    let held = heap.lvar.iter().map(|lvar| (lvar.dups.load(Ordering::Relaxed), lvar.dmax.load(Ordering::Relaxed))).collect::<Vec<(u64, u64)>>();
+    heap.labs.reclaim(&held);
+  }
+}
+
+// Marking
+// -------
+
+// Marks a cell, returning false if it was already marked
+fn mark_cell(gc: &Collector, loc: u64) -> bool {
+  let word = unsafe { gc.reach.get_unchecked((loc / 64) as usize) };
+  return (word.fetch_or(1 << (loc % 64), Ordering::Relaxed) >> (loc % 64)) & 1 == 0;
+}
+
+fn is_reached(gc: &Collector, loc: u64) -> bool {
+  let word = unsafe { gc.reach.get_unchecked((loc / 64) as usize) };
+  return (word.load(Ordering::Relaxed) >> (loc % 64)) & 1 == 1;
+}
+
+// Marks the cells of the node `term` points to, the first time it is reached, and pushes the ones
+// that hold its children to `todo`. Returns the number of cells marked.
+fn mark_term(heap: &Heap, prog: &Program, gc: &Collector, term: Ptr, todo: &mut Vec<u64>) -> u64 {
+  let (loc, size, init, last) = match get_tag(term) {
+    DP0 | DP1 => {
+      heap.labs.see(get_ext(term));
+      (get_loc(term, 0), 4, 2, 3)
+    }
+    LAM => {
+      // A lambda whose variable is reachable has its 1st cell marked already (see below), so its
+      // 2nd cell tells whether it was reached
+      if !mark_cell(gc, get_loc(term, 1)) {
+        return 0;
+      }
+      todo.push(get_loc(term, 1));
+      return 1 + mark_cell(gc, get_loc(term, 0)) as u64;
+    }
+    VAR => {
+      // The variable's substitution writes to its lambda's 1st cell, so that one is kept, even if
+      // the lambda itself, and its body, are unreachable
+      return mark_cell(gc, get_loc(term, 0)) as u64;
+    }
+    SUP => {
+      heap.labs.see(get_ext(term));
+      (get_loc(term, 0), 2, 0, 2)
+    }
+    APP | OP2 => (get_loc(term, 0), 2, 0, 2),
+    CTR | FUN => {
+      let arity = arity_of(&prog.aris, term);
+      (get_loc(term, 0), arity, 0, arity)
+    }
+    BUF => (get_loc(term, 0), 3, 0, 0),
+    _ => {
+      return 0;
+    }
+  };
+  if size == 0 || !mark_cell(gc, loc) {
+    return 0;
+  }
+  for i in 1 .. size {
+    mark_cell(gc, loc + i);
+  }
+  for i in init .. last {
+    todo.push(loc + i);
+  }
+  return size;
+}
+
+// Marks every node reachable from the cells in `roots`, sharing the work with the other threads
+fn mark(heap: &Heap, prog: &Program, gc: &Collector, safe: &Safepoint, roots: &[u64]) {
+  let mut todo = Vec::new();
+  let mut live = 0;
+  for root in roots {
+    if mark_cell(gc, *root) {
+      live += 1;
+      todo.push(*root);
+    }
+  }
+  loop {
+    while let Some(host) = todo.pop() {
+      live += mark_term(heap, prog, gc, load_ptr(heap, host), &mut todo);
+      if todo.len() > GC_SHARE && safe.idle.load(Ordering::Relaxed) > 0 {
+        let half = todo.split_off(todo.len() / 2);
+        safe.work.lock().unwrap().push(half);
+      }
+    }
+    if !take_work(safe, &mut todo) {
+      break;
+    }
+  }
+  safe.live.fetch_add(live, Ordering::Relaxed);
+}
+
+// Waits for another thread to share cells, returning false once every thread ran out of them
+fn take_work(safe: &Safepoint, todo: &mut Vec<u64>) -> bool {
+  let mut idle = false;
+  loop {
+    {
+      let mut work = safe.work.lock().unwrap();
+      if let Some(cells) = work.pop() {
+        if idle {
+          safe.idle.fetch_sub(1, Ordering::Relaxed);
+        }
+        *todo = cells;
+        return true;
+      }
+      if !idle {
+        idle = true;
+        safe.idle.fetch_add(1, Ordering::Relaxed);
+      }
+      if safe.idle.load(Ordering::Relaxed) == safe.tids {
+        return false;
+      }
+    }
+    std::thread::yield_now();
+  }
+}
+
+// Sweeping
+// --------
+
+// The words of the bitset that the `index`th of `tids` threads sweeps
+fn sweep_range(heap: &Heap, gc: &Collector, index: usize, tids: usize) -> (usize, usize) {
+  let words = std::cmp::min((get_heap_end(heap) + 63) / 64, gc.reach.len());
+  return (words * index / tids, words * (index + 1) / tids);
+}
+
+// Calls `f` on each cell, of the given words, that holds something but wasn't marked
+#[inline(always)]
+fn for_each_garbage(heap: &Heap, gc: &Collector, init: usize, last: usize, mut f: impl FnMut(u64, Ptr)) {
+  let end = std::cmp::min(get_heap_end(heap), heap.node.len()) as u64;
+  for index in init .. last {
+    let bits = unsafe { gc.reach.get_unchecked(index) }.load(Ordering::Relaxed);
+    if bits == u64::MAX {
+      continue;
+    }
+    for i in 0 .. 64 {
+      let loc = index as u64 * 64 + i;
+      if (bits >> i) & 1 == 0 && loc < end {
+        let term = load_ptr(heap, loc);
+        if term != 0 && get_tag(term) != NIL {
+          f(loc, term);
+        }
+      }
+    }
+  }
+}
+
+// Detaches the garbage from what is live, before any of it is cleared: a variable that is garbage
+// has its binder, if reachable, set to `Era()`, as `collect()` does, and a buffer drops its bytes
+fn unlink(heap: &Heap, gc: &Collector, init: usize, last: usize) {
+  for_each_garbage(heap, gc, init, last, |loc, term| {
+    match get_tag(term) {
+      DP0 | DP1 | VAR => {
+        let bind = get_loc(term, get_tag(term) & 0x01);
+        if is_reached(gc, bind) && load_ptr(heap, bind) == Arg(loc) {
+          link(heap, bind, Era());
+        }
+      }
+      BUF => {
+        heap.bufs.release(get_buffer_slot(heap, term));
+      }
+      _ => {}
+    }
+  });
+}
+
+// Gives the garbage cells back to the allocator, and clears the marks. Returns how many were freed.
+fn clear(heap: &Heap, gc: &Collector, tid: usize, init: usize, last: usize) -> u64 {
+  let mut freed = 0;
+  let mut page = (u64::MAX, 0);
+  for_each_garbage(heap, gc, init, last, |loc, _| {
+    unsafe { heap.node.get_unchecked(loc as usize) }.store(0, Ordering::Relaxed);
+    freed += 1;
+    // The arena counts the live cells of each page
+    if let Some(arena) = &heap.arena {
+      if loc / PAGE_SIZE as u64 != page.0 {
+        if page.1 > 0 {
+          arena.free(tid, page.0 * PAGE_SIZE as u64, page.1);
+        }
+        page = (loc / PAGE_SIZE as u64, 0);
+      }
+      page.1 += 1;
+    }
+  });
+  if let Some(arena) = &heap.arena {
+    if page.1 > 0 {
+      arena.free(tid, page.0 * PAGE_SIZE as u64, page.1);
+    }
+  }
+  unmark(gc, init, last);
+  return freed;
+}
+
+// Clears the marks of the given words
+fn unmark(gc: &Collector, init: usize, last: usize) {
+  for index in init .. last {
+    let word = unsafe { gc.reach.get_unchecked(index) };
+    if word.load(Ordering::Relaxed) != 0 {
+      word.store(0, Ordering::Relaxed);
+    }
+  }
+}
+
+#[cfg(test)]
+mod tests {
+  use crate::runtime::{*};
+
+  // Each (Main 1) leaks the cyclic dups of its multiplication
+  pub const LEAKY : &str = "
+    (Loop 0 !acc) = acc
+    (Loop n !acc) = (Loop (- n 1) (+ acc (Main 1)))
+  ";
+
+  #[test]
+  fn test_gc_keeps_leaking_loop_bounded() {
+    let size = 1 << 18;
+    let code = format!("{}{}", include_str!("../../../examples/lambda/multiplication/main.hvm"), LEAKY);
+    for gc in [false, true] {
+      let mut rt = Runtime::from_code_with(&code, size, 1, false).unwrap();
+      if gc {
+        rt.heap.gc = Some(new_collector(&rt.heap, size, 0.5));
+      }
+      let host = rt.normalize_code("(Loop 50 0)");
+      assert_eq!(get_num(rt.load_ptr(host)), 50 * 1410065408);
+      // Without a collector, the leaks fill the heap, so it takes a chunk of the reserved space
+      assert_eq!(get_heap_end(&rt.heap) == size, gc);
+    }
+  }
+
+  // Makes a dup per step, whose label nothing carries once it copied the number
+  pub const DUPS : &str = "
+    (Loop 0 !acc) = acc
+    (Loop n !acc) = dup a b = n; (Loop (- a 1) (+ acc b))
+  ";
+
+  #[test]
+  fn test_labels_are_reclaimed_without_collector() {
+    let mut rt = Runtime::from_code_with(DUPS, 1 << 16, 1, false).unwrap();
+    // Leaves fewer fresh batches than the loop takes labels
+    rt.heap.labs.set_next(LABEL_BATCHES - 16);
+    let host = rt.normalize_code("(Loop 1000000 0)");
+    assert_eq!(get_num(rt.load_ptr(host)), 500000500000);
+    assert!(rt.heap.labs.get_free() > 0);
+    // Nothing was freed, as there is no collector
+    assert!(rt.heap.gc.is_none());
+  }
+}
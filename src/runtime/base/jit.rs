@@ -0,0 +1,653 @@
+// JIT
+// ---
+// Lowers interpreted functions to x86-64 machine code, in process, as an alternative to `hvm
+// compile` that needs no Rust toolchain. Each function becomes a single routine that walks its
+// match tree with native compares and, for the matching rule, does what `alloc_rule_body` does,
+// with every body cell turned into a few stores: there is no tree walk nor cell dispatch left.
+// `fun::apply` calls it instead of the match tree; superpositions, the rewrite count, the link to
+// the host and the collection of erased variables are still done there, by the same code paths.
+//
+// Only functions with a match tree are lowered (see `build_match_tree`); the others, and every
+// function on other targets, stay interpreted. Allocation and freeing call back into `alloc` and
+// `free`, so the allocator mode, free lists and profile counters behave the same.
+//
+// The routine's arguments are a `JitEnv` and the call's pointer. It returns the index of the rule
+// applied, writing the body's root to `JitEnv::done`, or JIT_NONE if no rule matched.
+
+use crate::runtime::{*};
+
+pub const JIT_NONE : u64 = u64::MAX;
+
+// What the lowered code reads, by offset (see `JitEnv::new`)
+#[repr(C)]
+pub struct JitEnv {
+  pub node: *mut u64,    // 0: the heap's nodes
+  pub aloc: *mut u64,    // 8: the thread's `aloc`
+  pub dups: *mut u64,    // 16: the thread's dup label counter
+  pub heap: *const Heap, // 24
+  pub tid: usize,        // 32
+  pub done: Ptr,         // 40: the root of the body built
+  pub arena: u64,        // 48: whether bodies are allocated as a block (see `place_nodes`)
+  pub dmax: *mut u64,    // 56: the end of the thread's dup labels
+}
+
+impl JitEnv {
+  #[inline(always)]
+  pub fn new(heap: &Heap, tid: usize) -> JitEnv {
+    let node = heap.node.as_ptr() as *mut u64;
+    let aloc = unsafe { heap.aloc.get_unchecked(tid) }.as_ptr() as *mut u64;
+    let dups = unsafe { heap.lvar.get_unchecked(tid) }.dups.as_mut_ptr();
+    let dmax = unsafe { heap.lvar.get_unchecked(tid) }.dmax.as_mut_ptr();
+    return JitEnv { node, aloc, dups, heap, tid, done: 0, arena: heap.arena.is_some() as u64, dmax };
+  }
+}
+
+pub type JitFun = unsafe extern "sysv64" fn(env: *mut JitEnv, term: Ptr) -> u64;
+
+// A lowered function, owning its executable memory
+pub struct JitCode {
+  data: *mut u8,
+  size: usize,
+  func: JitFun,
+}
+
+// The code is immutable once built
+unsafe impl Sync for JitCode {}
+unsafe impl Send for JitCode {}
+
+impl JitCode {
+  // Matches `term` and builds the right-hand side of its rule, returning the rule's index and the
+  // body's root, or None if no rule matched (in which case nothing was written)
+  #[inline(always)]
+  pub fn apply(&self, heap: &Heap, tid: usize, term: Ptr) -> Option<(usize, Ptr)> {
+    let mut env = JitEnv::new(heap, tid);
+    let rule = unsafe { (self.func)(&mut env, term) };
+    if rule == JIT_NONE {
+      return None;
+    }
+    return Some((rule as usize, env.done));
+  }
+}
+
+impl Drop for JitCode {
+  fn drop(&mut self) {
+    #[cfg(unix)]
+    unsafe {
+      libc::munmap(self.data as *mut libc::c_void, self.size);
+    }
+  }
+}
+
+// Lowers every interpreted function of `prog` that can be, keeping the ones already lowered
+pub fn jit_program(prog: &mut Program) {
+  for fun in prog.funs.data.iter_mut() {
+    if let Some(Function::Interpreted { apply, .. }) = fun {
+      if apply.jit.is_none() {
+        apply.jit = jit_function(apply);
+      }
+    }
+  }
+}
+
+// Lowers a function, returning None if it can't be on this target
+pub fn jit_function(apply: &ApplyObj) -> Option<JitCode> {
+  #[cfg(all(target_arch = "x86_64", unix))]
+  return exec_code(&x64::lower_function(&apply.rules, apply.tree.as_ref()?));
+  #[cfg(not(all(target_arch = "x86_64", unix)))]
+  return None;
+}
+
+// Copies machine code to fresh pages, which are then made executable and read-only
+#[cfg(all(target_arch = "x86_64", unix))]
+fn exec_code(code: &[u8]) -> Option<JitCode> {
+  unsafe {
+    let page = libc::sysconf(libc::_SC_PAGESIZE) as usize;
+    let size = (std::cmp::max(code.len(), 1) + page - 1) / page * page;
+    let prot = libc::PROT_READ | libc::PROT_WRITE;
+    let flag = libc::MAP_PRIVATE | libc::MAP_ANONYMOUS;
+    let data = libc::mmap(std::ptr::null_mut(), size, prot, flag, -1, 0);
+    if data == libc::MAP_FAILED {
+      return None;
+    }
+    std::ptr::copy_nonoverlapping(code.as_ptr(), data as *mut u8, code.len());
+    if libc::mprotect(data, size, libc::PROT_READ | libc::PROT_EXEC) != 0 {
+      libc::munmap(data, size);
+      return None;
+    }
+    let func = std::mem::transmute::<*mut libc::c_void, JitFun>(data);
+    return Some(JitCode { data: data as *mut u8, size, func });
+  }
+}
+
+// Called by the lowered code to allocate and free nodes
+extern "sysv64" fn jit_alloc(env: &JitEnv, arity: u64) -> u64 {
+  return alloc(unsafe { &*env.heap }, env.tid, arity);
+}
+
+extern "sysv64" fn jit_free(env: &JitEnv, loc: u64, arity: u64) {
+  free(unsafe { &*env.heap }, env.tid, loc, arity);
+}
+
+// Called by the lowered code when the thread's dup labels run out
+extern "sysv64" fn jit_labels(env: &JitEnv, count: u64) {
+  take_labels(unsafe { &*env.heap }, env.tid, count);
+}
+
+#[cfg(all(target_arch = "x86_64", unix))]
+mod x64 {
+  use crate::runtime::{*};
+
+  // Registers
+  const RAX : u8 = 0;
+  const RCX : u8 = 1;
+  const RDX : u8 = 2;
+  const RBX : u8 = 3;
+  const RSI : u8 = 6;
+  const RDI : u8 = 7;
+  const R12 : u8 = 12;
+  const R13 : u8 = 13;
+  const R14 : u8 = 14;
+  const R15 : u8 = 15;
+
+  // Condition codes
+  const CC_B  : u8 = 0x2;
+  const CC_BE : u8 = 0x6;
+  const CC_E  : u8 = 0x4;
+  const CC_NE : u8 = 0x5;
+  const CC_A  : u8 = 0x7;
+
+  // While lowering a function:
+  // - rbx: the JitEnv
+  // - r12: the call's pointer
+  // - r13: the heap's nodes
+  // - r14: the thread's aloc
+  // - r15: the call's node while matching and taking variables; then the dup label, shifted to
+  //   the ext field, while writing the body
+  const ENV  : u8 = RBX;
+  const TERM : u8 = R12;
+  const NODE : u8 = R13;
+  const ALOC : u8 = R14;
+  const ARGS : u8 = R15;
+  const DUPS : u8 = R15;
+
+  const ENV_ALOC : i32 = 8;
+  const ENV_DUPS : i32 = 16;
+  const ENV_DONE : i32 = 40;
+  const ENV_ARENA : i32 = 48;
+  const ENV_DMAX : i32 = 56;
+
+  // A minimal assembler, for the instructions used below. Memory operands are always encoded
+  // with a 32-bit displacement.
+  struct Asm {
+    code: Vec<u8>,
+    labels: Vec<Option<usize>>,
+    fixes: Vec<(usize, usize)>, // (position of a rel32, label)
+  }
+
+  impl Asm {
+    fn new() -> Asm {
+      return Asm { code: vec![], labels: vec![], fixes: vec![] };
+    }
+
+    fn label(&mut self) -> usize {
+      self.labels.push(None);
+      return self.labels.len() - 1;
+    }
+
+    fn bind(&mut self, label: usize) {
+      self.labels[label] = Some(self.code.len());
+    }
+
+    fn finish(mut self) -> Vec<u8> {
+      for (pos, label) in &self.fixes {
+        let dest = self.labels[*label].expect("unbound label") as i64;
+        let rel = (dest - (*pos as i64 + 4)) as i32;
+        self.code[*pos .. *pos + 4].copy_from_slice(&rel.to_le_bytes());
+      }
+      return self.code;
+    }
+
+    fn rex(&mut self, w: bool, reg: u8, index: u8, base: u8) {
+      self.code.push(0x40 | (w as u8) << 3 | (reg >> 3) << 2 | (index >> 3) << 1 | (base >> 3));
+    }
+
+    fn imm32(&mut self, imm: i32) {
+      self.code.extend_from_slice(&imm.to_le_bytes());
+    }
+
+    // ModRM (and SIB) for [base + index * 8 + disp]
+    fn mem(&mut self, w: bool, op: u8, reg: u8, base: u8, index: Option<u8>, disp: i32) {
+      self.rex(w, reg, index.unwrap_or(0), base);
+      self.code.push(op);
+      match index {
+        None => {
+          self.code.push(0x80 | (reg & 7) << 3 | (base & 7));
+          if base & 7 == 4 {
+            self.code.push(0x24);
+          }
+        }
+        Some(index) => {
+          self.code.push(0x80 | (reg & 7) << 3 | 4);
+          self.code.push(3 << 6 | (index & 7) << 3 | (base & 7));
+        }
+      }
+      self.imm32(disp);
+    }
+
+    // A register to register instruction, `op rm, reg`
+    fn reg(&mut self, w: bool, op: u8, rm: u8, reg: u8) {
+      self.rex(w, reg, 0, rm);
+      self.code.push(op);
+      self.code.push(0xC0 | (reg & 7) << 3 | (rm & 7));
+    }
+
+    fn load(&mut self, dst: u8, base: u8, index: Option<u8>, disp: i32) {
+      self.mem(true, 0x8B, dst, base, index, disp);
+    }
+
+    // Loads the low 32 bits, i.e., a pointer's location
+    fn load_loc(&mut self, dst: u8, base: u8, index: Option<u8>, disp: i32) {
+      self.mem(false, 0x8B, dst, base, index, disp);
+    }
+
+    fn store(&mut self, src: u8, base: u8, index: Option<u8>, disp: i32) {
+      self.mem(true, 0x89, src, base, index, disp);
+    }
+
+    fn xchg(&mut self, reg: u8, base: u8, index: Option<u8>, disp: i32) {
+      self.mem(true, 0x87, reg, base, index, disp);
+    }
+
+    fn add_load(&mut self, dst: u8, base: u8, index: Option<u8>, disp: i32) {
+      self.mem(true, 0x03, dst, base, index, disp);
+    }
+
+    fn add_store_imm(&mut self, base: u8, disp: i32, imm: i32) {
+      self.mem(true, 0x81, 0, base, None, disp);
+      self.imm32(imm);
+    }
+
+    fn mov(&mut self, dst: u8, src: u8) {
+      self.reg(true, 0x89, dst, src);
+    }
+
+    // Moves the low 32 bits, clearing the high ones
+    fn mov_loc(&mut self, dst: u8, src: u8) {
+      self.reg(false, 0x89, dst, src);
+    }
+
+    fn add(&mut self, dst: u8, src: u8) {
+      self.reg(true, 0x01, dst, src);
+    }
+
+    fn and(&mut self, dst: u8, src: u8) {
+      self.reg(true, 0x21, dst, src);
+    }
+
+    fn cmp(&mut self, lhs: u8, rhs: u8) {
+      self.reg(true, 0x39, lhs, rhs);
+    }
+
+    // `op dst, imm32`, with `ext` selecting the operation (0: add, 4: and, 7: cmp)
+    fn imm(&mut self, ext: u8, dst: u8, imm: i32) {
+      self.rex(true, 0, 0, dst);
+      self.code.push(0x81);
+      self.code.push(0xC0 | ext << 3 | (dst & 7));
+      self.imm32(imm);
+    }
+
+    fn add_imm(&mut self, dst: u8, imm: i32) {
+      self.imm(0, dst, imm);
+    }
+
+    fn and_imm(&mut self, dst: u8, imm: i32) {
+      self.imm(4, dst, imm);
+    }
+
+    fn cmp_imm(&mut self, dst: u8, imm: i32) {
+      self.imm(7, dst, imm);
+    }
+
+    // `shl` (ext 4) or `shr` (ext 5) by a constant
+    fn shift(&mut self, ext: u8, dst: u8, bits: u8) {
+      self.rex(true, 0, 0, dst);
+      self.code.push(0xC1);
+      self.code.push(0xC0 | ext << 3 | (dst & 7));
+      self.code.push(bits);
+    }
+
+    fn shl(&mut self, dst: u8, bits: u8) {
+      self.shift(4, dst, bits);
+    }
+
+    fn shr(&mut self, dst: u8, bits: u8) {
+      self.shift(5, dst, bits);
+    }
+
+    fn mov_imm(&mut self, dst: u8, imm: u64) {
+      if imm <= u32::MAX as u64 {
+        self.rex(false, 0, 0, dst);
+        self.code.push(0xB8 + (dst & 7));
+        self.imm32(imm as u32 as i32);
+      } else {
+        self.rex(true, 0, 0, dst);
+        self.code.push(0xB8 + (dst & 7));
+        self.code.extend_from_slice(&imm.to_le_bytes());
+      }
+    }
+
+    fn push(&mut self, reg: u8) {
+      self.rex(false, 0, 0, reg);
+      self.code.push(0x50 + (reg & 7));
+    }
+
+    fn pop(&mut self, reg: u8) {
+      self.rex(false, 0, 0, reg);
+      self.code.push(0x58 + (reg & 7));
+    }
+
+    fn call(&mut self, addr: u64) {
+      self.mov_imm(RAX, addr);
+      self.code.extend_from_slice(&[0xFF, 0xD0]);
+    }
+
+    fn ret(&mut self) {
+      self.code.push(0xC3);
+    }
+
+    fn jmp(&mut self, label: usize) {
+      self.code.push(0xE9);
+      self.fixes.push((self.code.len(), label));
+      self.imm32(0);
+    }
+
+    fn jcc(&mut self, cc: u8, label: usize) {
+      self.code.push(0x0F);
+      self.code.push(0x80 | cc);
+      self.fixes.push((self.code.len(), label));
+      self.imm32(0);
+    }
+  }
+
+  const SAVED : [u8; 5] = [RBX, R12, R13, R14, R15];
+
+  pub fn lower_function(rules: &[Rule], tree: &[MatchNode]) -> Vec<u8> {
+    let mut asm = Asm::new();
+    let none = asm.label();
+    let exit = asm.label();
+    let labels = rules.iter().map(|_| asm.label()).collect::<Vec<usize>>();
+
+    // Prologue: 5 pushes over the return address keep the stack 16-byte aligned for calls
+    for reg in SAVED {
+      asm.push(reg);
+    }
+    asm.mov(ENV, RDI);
+    asm.mov(TERM, RSI);
+    asm.load(NODE, ENV, None, 0);
+    asm.load(ALOC, ENV, None, ENV_ALOC);
+    asm.mov_loc(ARGS, TERM);
+    asm.shl(ARGS, 3);
+    asm.add(ARGS, NODE);
+
+    let nodes = tree.iter().map(|_| asm.label()).collect::<Vec<usize>>();
+    for (i, node) in tree.iter().enumerate() {
+      asm.bind(nodes[i]);
+      match node {
+        MatchNode::Switch { arg, cases, other } => {
+          lower_switch(&mut asm, *arg, cases, nodes[*other], &nodes, none);
+        }
+        MatchNode::Leaf { rule } => {
+          asm.jmp(match rule { Some(r) => labels[*r], None => none });
+        }
+      }
+    }
+
+    for (r, rule) in rules.iter().enumerate() {
+      asm.bind(labels[r]);
+      lower_rule(&mut asm, rule);
+      asm.mov_imm(RAX, r as u64);
+      asm.jmp(exit);
+    }
+
+    asm.bind(none);
+    asm.mov_imm(RAX, JIT_NONE);
+    asm.bind(exit);
+    for reg in SAVED.iter().rev() {
+      asm.pop(*reg);
+    }
+    asm.ret();
+    return asm.finish();
+  }
+
+  // Computes the `match_key` of argument `arg` on rax, then compares it against the cases' keys,
+  // which are sorted, with a binary search
+  fn lower_switch(asm: &mut Asm, arg: u64, cases: &[(Ptr, usize)], other: usize, nodes: &[usize], none: usize) {
+    let keyed = asm.label();
+    let not_ctr = asm.label();
+    asm.load(RAX, ARGS, None, 8 * arg as i32);
+    asm.mov(RDX, RAX);
+    asm.shr(RDX, 60);
+    asm.cmp_imm(RDX, CTR as i32);
+    asm.jcc(CC_NE, not_ctr);
+    asm.mov_imm(RCX, !0xFFFF_FFFF);
+    asm.and(RAX, RCX);
+    asm.jmp(keyed);
+    asm.bind(not_ctr);
+    asm.cmp_imm(RDX, U60 as i32);
+    asm.jcc(CC_E, keyed);
+    asm.cmp_imm(RDX, F60 as i32);
+    asm.jcc(CC_NE, none);
+    asm.bind(keyed);
+    let cases = cases.iter().map(|(key, node)| (*key, nodes[*node])).collect::<Vec<(Ptr, usize)>>();
+    lower_search(asm, &cases, other);
+  }
+
+  fn lower_search(asm: &mut Asm, cases: &[(Ptr, usize)], other: usize) {
+    if cases.len() <= 4 {
+      for (key, node) in cases {
+        asm.mov_imm(RCX, *key);
+        asm.cmp(RAX, RCX);
+        asm.jcc(CC_E, *node);
+      }
+      asm.jmp(other);
+    } else {
+      let half = cases.len() / 2;
+      let lower = asm.label();
+      asm.mov_imm(RCX, cases[half].0);
+      asm.cmp(RAX, RCX);
+      asm.jcc(CC_E, cases[half].1);
+      asm.jcc(CC_B, lower);
+      lower_search(asm, &cases[half + 1 ..], other);
+      asm.bind(lower);
+      lower_search(asm, &cases[.. half], other);
+    }
+  }
+
+  // Loads the location of the `s`-th source of a rule (see `alloc_rule_body`)
+  fn lower_source(asm: &mut Asm, dst: u8, rule: &Rule, s: u64) {
+    match rule.free.get(s as usize) {
+      Some((param, _)) => asm.load_loc(dst, ARGS, None, 8 * *param as i32),
+      None => asm.mov_loc(dst, TERM),
+    }
+  }
+
+  // Loads the value of a body cell on rax (the `cell_to_ptr` of `write_body`)
+  fn lower_cell(asm: &mut Asm, size: usize, cell: &RuleBodyCell) {
+    match cell {
+      RuleBodyCell::Val { value } => {
+        asm.mov_imm(RAX, *value);
+      }
+      RuleBodyCell::Var { index } => {
+        asm.load(RAX, ALOC, None, 8 * (size as i32 + *index as i32));
+      }
+      RuleBodyCell::Ptr { value, targ, slot } => {
+        asm.mov_imm(RAX, value + slot);
+        asm.add_load(RAX, ALOC, None, 8 * *targ as i32);
+        if get_tag(*value) <= DP1 {
+          asm.add(RAX, DUPS);
+        }
+      }
+    }
+  }
+
+  // Writes the location of each node to aloc, with the nodes not reused allocated as a block of
+  // size `block`, or one by one if it is over BODY_BLOCK_MAX
+  fn lower_placement(asm: &mut Asm, rule: &Rule, block: u64) {
+    let body = &rule.body;
+    let fits = block <= BODY_BLOCK_MAX;
+    if fits && block > 0 {
+      asm.mov(RDI, ENV);
+      asm.mov_imm(RSI, block);
+      asm.call(super::jit_alloc as u64);
+    }
+    let mut next = 0;
+    for i in 0 .. body.node_count() {
+      match rule.reuse.iter().find(|(node, _)| *node == i as u64) {
+        Some((_, s)) => {
+          lower_source(asm, RDX, rule, *s);
+          asm.store(RDX, ALOC, None, 8 * i as i32);
+        }
+        None if fits => {
+          asm.mov(RDX, RAX);
+          asm.add_imm(RDX, next as i32);
+          asm.store(RDX, ALOC, None, 8 * i as i32);
+          next += body.node_size(i);
+        }
+        None => {
+          asm.mov(RDI, ENV);
+          asm.mov_imm(RSI, body.node_size(i));
+          asm.call(super::jit_alloc as u64);
+          asm.store(RAX, ALOC, None, 8 * i as i32);
+        }
+      }
+    }
+  }
+
+  // Follows `alloc_rule_body` and `write_body`, leaving the body's root on `JitEnv::done`
+  fn lower_rule(asm: &mut Asm, rule: &Rule) {
+    let body = &rule.body;
+    let size = body.node_count();
+
+    // Takes the variables, keeping them on aloc after the body's nodes. Like `take_ptr`, this
+    // leaves Nil(0) behind, not 0, which the scanner would hand out as free before the source is.
+    for (index, var) in rule.vars.iter().enumerate() {
+      asm.mov_imm(RAX, NIL * TAG);
+      match var.field {
+        Some(field) => {
+          asm.load_loc(RCX, ARGS, None, 8 * var.param as i32);
+          asm.xchg(RAX, NODE, Some(RCX), 8 * field as i32);
+        }
+        None => {
+          asm.xchg(RAX, ARGS, None, 8 * var.param as i32);
+        }
+      }
+      asm.store(RAX, ALOC, None, 8 * (size + index) as i32);
+    }
+
+    // Places the nodes like `place_nodes`. Allocating them as a block is only an option when it
+    // isn't too large; it leaves its location on rax.
+    let mut block = body.cells.len() as u64;
+    for (node, _) in &rule.reuse {
+      block -= body.node_size(*node as usize);
+    }
+    let placed = asm.label();
+    if block <= BODY_BLOCK_MAX {
+      let nodes = asm.label();
+      asm.load(RAX, ENV, None, ENV_ARENA);
+      asm.cmp_imm(RAX, 0);
+      asm.jcc(CC_E, nodes);
+      lower_placement(asm, rule, block);
+      asm.jmp(placed);
+      asm.bind(nodes);
+    }
+    lower_placement(asm, rule, BODY_BLOCK_MAX + 1);
+    asm.bind(placed);
+
+    // Frees the sources that weren't reused
+    for s in 0 ..= rule.free.len() as u64 {
+      if !rule.reuse.iter().any(|(_, used)| *used == s) {
+        let arity = match rule.free.get(s as usize) { Some((_, arity)) => *arity, None => rule.cond.len() as u64 };
+        lower_source(asm, RSI, rule, s);
+        asm.mov(RDI, ENV);
+        asm.mov_imm(RDX, arity);
+        asm.call(super::jit_free as u64);
+      }
+    }
+
+    // Takes more dup labels like `write_body`, then keeps the current one on DUPS, as an ext
+    if body.dupk > 0 {
+      let fits = asm.label();
+      asm.load(RDX, ENV, None, ENV_DUPS);
+      asm.load(RAX, RDX, None, 0);
+      asm.add_imm(RAX, body.dupk as i32);
+      asm.load(RCX, ENV, None, ENV_DMAX);
+      asm.load(RCX, RCX, None, 0);
+      asm.cmp(RAX, RCX);
+      asm.jcc(CC_BE, fits);
+      asm.mov(RDI, ENV);
+      asm.mov_imm(RSI, body.dupk);
+      asm.call(super::jit_labels as u64);
+      asm.bind(fits);
+      asm.load(RDX, ENV, None, ENV_DUPS);
+      asm.load(DUPS, RDX, None, 0);
+      asm.and_imm(DUPS, 0xFFF_FFFF);
+      asm.shl(DUPS, 32);
+    }
+
+    // Writes the cells, with the node's location on rcx. Variables are linked like `link` does.
+    for i in 0 .. size {
+      asm.load(RCX, ALOC, None, 8 * i as i32);
+      for (j, cell) in body.node(i).iter().enumerate() {
+        lower_cell(asm, size, cell);
+        asm.store(RAX, NODE, Some(RCX), 8 * j as i32);
+        if let RuleBodyCell::Var { .. } = cell {
+          let skip = asm.label();
+          asm.mov(RDX, RAX);
+          asm.shr(RDX, 60);
+          asm.cmp_imm(RDX, VAR as i32);
+          asm.jcc(CC_A, skip);
+          asm.and_imm(RDX, 1);
+          asm.mov_loc(RSI, RAX);
+          asm.add(RSI, RDX);
+          asm.mov_imm(RDX, Arg(j as u64));
+          asm.add(RDX, RCX);
+          asm.store(RDX, NODE, Some(RSI), 0);
+          asm.bind(skip);
+        }
+      }
+    }
+
+    lower_cell(asm, size, &body.root);
+    asm.store(RAX, ENV, None, ENV_DONE);
+    if body.dupk > 0 {
+      asm.load(RDX, ENV, None, ENV_DUPS);
+      asm.add_store_imm(RDX, 0, body.dupk as i32);
+    }
+  }
+}
+
+#[cfg(all(test, target_arch = "x86_64", unix))]
+mod tests {
+  use crate::runtime::{*};
+
+  // Sorting takes the fields of every matched list, and a heap this small makes the scanner wrap
+  // around, handing out the cells that rules free
+  pub const CHURN : &str = include_str!("../../../examples/sort/quick/main.hvm");
+
+  // The lowered rules leave the heap like the interpreted ones: the scanner doesn't hand out the
+  // cells of a node whose fields were taken before it's freed
+  #[test]
+  fn test_jit_alloc_rescans_its_area() {
+    let size = 1 << 15;
+    let mut runs = vec![];
+    for jit in [false, true] {
+      let mut rt = Runtime::from_code_with(CHURN, size, 1, false).unwrap();
+      if jit {
+        jit_program(&mut rt.prog);
+      }
+      let host = rt.normalize_code("(Main 10)");
+      runs.push((rt.show(host), get_heap_end(&rt.heap)));
+    }
+    assert_eq!(runs[0], runs[1]);
+  }
+}
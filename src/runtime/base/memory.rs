@@ -32,6 +32,9 @@
 //   OP2 |  10 | a numeric operation
 //   U60 |  11 | a 60-bit unsigned integer
 //   F60 |  12 | a 60-bit floating point
+//   LCK |  13 | the lock of a duplication node
+//   BUF |  14 | a packed byte string or number array
+//   NIL |  15 | a free cell, sitting on an allocator's free list
 //
 // The semantics of the 1st and 2nd values depend on the pointer tag. 
 //
@@ -50,6 +53,9 @@
 //   OP2 | the operation name           | points to the operation node
 //   U60 | the most significant 28 bits | the least significant 32 bits
 //   F60 | the most significant 28 bits | the least significant 32 bits
+//   LCK | not used                     | the id of the lock holder, plus one, or 0
+//   BUF | the buffer's kind            | points to the buffer node
+//   NIL | not used                     | the next free node of the same size
 //
 // Notes:
 //
@@ -58,12 +64,13 @@
 //   3. U60 and F60 pointers don't point anywhere, they just store the number directly.
 //
 // A node is a tuple of N pointers stored on sequential memory indices.
-// The meaning of each index depends on the node. There are 7 types:
+// The meaning of each index depends on the node. There are 8 types:
 //
 //   Duplication Node:
 //   - [0] => either an ERA or an ARG pointing to the 1st variable location
 //   - [1] => either an ERA or an ARG pointing to the 2nd variable location
 //   - [2] => pointer to the duplicated expression
+//   - [3] => the node's lock (see `acquire_lock`)
 //
 //   Lambda Node:
 //   - [0] => either and ERA or an ERA pointing to the variable location
@@ -93,6 +100,11 @@
 //   - [0] => pointer to the 1st operand
 //   - [1] => pointer to the 2nd operand
 //
+//   Buffer Node:
+//   - [0] => a U60 with the buffer's slot on `heap.bufs`
+//   - [1] => a U60 with the index of the first element
+//   - [2] => a U60 with the number of elements
+//
 // Notes:
 //
 //   1. Duplication nodes DON'T have a body. They "float" on the global scope.
@@ -151,12 +163,13 @@
 //
 //     Root : Ptr(LAM, 0x0000000, 0x00000000)
 //     0x00 | Ptr(ARG, 0x0000000, 0x00000004) // the lambda's argument
-//     0x01 | Ptr(OP2, 0x0000002, 0x00000005) // the lambda's body
-//     0x02 | Ptr(ARG, 0x0000000, 0x00000005) // the duplication's 1st argument
-//     0x03 | Ptr(ARG, 0x0000000, 0x00000006) // the duplication's 2nd argument
+//     0x01 | Ptr(OP2, 0x0000002, 0x00000006) // the lambda's body
+//     0x02 | Ptr(ARG, 0x0000000, 0x00000006) // the duplication's 1st argument
+//     0x03 | Ptr(ARG, 0x0000000, 0x00000007) // the duplication's 2nd argument
 //     0x04 | Ptr(VAR, 0x0000000, 0x00000000) // the duplicated expression
-//     0x05 | Ptr(DP0, 0xa31fb21, 0x00000002) // the operator's 1st operand
-//     0x06 | Ptr(DP1, 0xa31fb21, 0x00000002) // the operator's 2st operand
+//     0x05 | Ptr(LCK, 0x0000000, 0x00000000) // the duplication's lock, open
+//     0x06 | Ptr(DP0, 0xa31fb21, 0x00000002) // the operator's 1st operand
+//     0x07 | Ptr(DP1, 0xa31fb21, 0x00000002) // the operator's 2st operand
 //
 //   Notes:
 //     
@@ -166,12 +179,12 @@
 //     4. The lambda's body does not point to the dup node, but to the operator. Dup nodes float.
 //     5. 0xa31fb21 is a globally unique random label assigned to the duplication node.
 //     6. That duplication label is stored on the DP0/DP1 that point to the node, not on the node.
-//     7. A lambda uses 2 memory slots, a duplication uses 3, an operator uses 2. Total: 112 bytes.
+//     7. A lambda uses 2 memory slots, a duplication uses 4, an operator uses 2. Total: 128 bytes.
 //     8. In-memory size is different to, and larger than, serialization size.
 
 pub use crate::runtime::{*};
 
-use std::sync::atomic::{AtomicU8, AtomicU64, AtomicI64, Ordering};
+use std::sync::atomic::{AtomicBool, AtomicU8, AtomicU64, AtomicI64, Ordering};
 use crossbeam::utils::{CachePadded, Backoff};
 
 // Types
@@ -187,22 +200,47 @@ pub struct LocalVars {
   pub tid: usize,
   pub used: AtomicI64, // number of used memory cells
   pub next: AtomicU64, // next alloc index
-  pub amin: AtomicU64, // min alloc index
-  pub amax: AtomicU64, // max alloc index
+  pub amin: AtomicU64, // min alloc index of the current area
+  pub amax: AtomicU64, // max alloc index of the current area
+  pub room: AtomicU64, // number of cells on all the thread's areas
   pub dups: AtomicU64, // next dup label to be created
+  pub dmax: AtomicU64, // end of the labels the thread took (see `data::label_space`)
   pub cost: AtomicU64, // total number of rewrite rules
+  pub fcnt: AtomicU64, // number of cells held by the free lists
+  pub free: [AtomicU64; FREE_LIST_SIZES], // free list heads, indexed by node size
 }
 
 // Global memory buffer
 pub struct Heap {
   pub tids: usize,
-  pub node: Box<[AtomicU64]>,
-  pub lock: Box<[AtomicU8]>,
+  pub node: MemMap<AtomicU64>,
+  pub grow: AtomicU64, // first cell not yet given to any thread
+  pub base: u64, // the first cell past the initial areas, where the chunks start
+  pub owns: Box<[AtomicU64]>, // the thread that took each chunk, plus one, or 0
   pub lvar: Box<[CachePadded<LocalVars>]>,
   pub vstk: Box<[VisitQueue]>,
-  pub aloc: Box<[Box<[AtomicU64]>]>,
-  pub vbuf: Box<[Box<[AtomicU64]>]>,
+  pub aloc: Box<[MemMap<AtomicU64>]>,
+  pub vbuf: Box<[MemMap<AtomicU64>]>,
   pub rbag: RedexBag,
+  pub arena: Option<Allocator>,
+  pub steal: StealMode,
+  pub mark: MemMap<AtomicU64>,
+  pub dirt: AtomicBool,
+  pub pool: Pool,
+  pub bufs: BufferStore, // the bytes of buffer terms
+  pub labs: LabelSpace, // the dup labels not taken by any thread
+  pub memo: MemoTable, // the shared values of memoized functions
+  pub prof: Option<Box<[CachePadded<ProfVars>]>>, // profiling counters, if enabled
+  pub gc: Option<Collector>, // the tracing collector, if enabled
+  pub tele: Option<Telemetry>, // samples of what the reducers are doing, if enabled
+  pub io: Reactor, // performs the IO of effects
+}
+
+// Which allocator the heap uses
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum AllocMode {
+  Scan,  // free lists, falling back to scanning for empty cells
+  Arena, // page-granular bump allocation (see `data::allocator`)
 }
 
 // Pointer Constructors
@@ -225,6 +263,8 @@ pub const FUN: u64 = 0x9;
 pub const OP2: u64 = 0xA;
 pub const U60: u64 = 0xB;
 pub const F60: u64 = 0xC;
+pub const LCK: u64 = 0xD;
+pub const BUF: u64 = 0xE;
 pub const NIL: u64 = 0xF;
 
 pub const ADD: u64 = 0x0;
@@ -299,6 +339,18 @@ pub fn Fun(fun: u64, pos: u64) -> Ptr {
   (FUN * TAG) | (fun * EXT) | pos
 }
 
+pub fn Buf(kind: u64, pos: u64) -> Ptr {
+  (BUF * TAG) | (kind * EXT) | pos
+}
+
+pub fn Lck(tid: u64) -> Ptr {
+  (LCK * TAG) | tid
+}
+
+pub fn Nil(pos: u64) -> Ptr {
+  (NIL * TAG) | pos
+}
+
 // Pointer Getters
 // ---------------
 
@@ -330,12 +382,30 @@ pub fn get_used(heap: &Heap) -> i64 {
   heap.lvar.iter().map(|x| x.used.load(Ordering::Relaxed)).sum()
 }
 
+// One past the last cell that was ever handed to a thread
+pub fn get_heap_end(heap: &Heap) -> usize {
+  std::cmp::min(heap.grow.load(Ordering::Relaxed) as usize, heap.node.len())
+}
+
 pub fn inc_cost(heap: &Heap, tid: usize) {
   unsafe { heap.lvar.get_unchecked(tid) }.cost.fetch_add(1, Ordering::Relaxed);
 }
 
 pub fn gen_dup(heap: &Heap, tid: usize) -> u64 {
-  return unsafe { heap.lvar.get_unchecked(tid) }.dups.fetch_add(1, Ordering::Relaxed) & 0xFFF_FFFF;
+  let lvar = unsafe { heap.lvar.get_unchecked(tid) };
+  if lvar.dups.load(Ordering::Relaxed) >= lvar.dmax.load(Ordering::Relaxed) {
+    take_labels(heap, tid, 1);
+  }
+  return lvar.dups.fetch_add(1, Ordering::Relaxed) & 0xFFF_FFFF;
+}
+
+// Gives the thread a new range of dup labels, with room for at least `count` of them
+#[inline(never)]
+pub fn take_labels(heap: &Heap, tid: usize, count: u64) {
+  let lvar = unsafe { heap.lvar.get_unchecked(tid) };
+  let (init, last) = heap.labs.take(count);
+  lvar.dups.store(init, Ordering::Relaxed);
+  lvar.dmax.store(last, Ordering::Relaxed);
 }
 
 pub fn arity_of(arit: &ArityMap, lnk: Ptr) -> u64 {
@@ -360,9 +430,10 @@ pub fn load_arg(heap: &Heap, term: Ptr, arg: u64) -> Ptr {
   load_ptr(heap, get_loc(term, arg))
 }
 
-// Given a location, takes the ptr stored on it
+// Given a location, takes the ptr stored on it. The cell is left as `Nil(0)`, not 0, since its node
+// is only freed once the rewrite is done, and the scanner would hand an empty cell out meanwhile.
 pub fn take_ptr(heap: &Heap, loc: u64) -> Ptr {
-  unsafe { heap.node.get_unchecked(loc as usize).swap(0, Ordering::Relaxed) }
+  unsafe { heap.node.get_unchecked(loc as usize).swap(Nil(0), Ordering::Relaxed) }
 }
 
 // Given a pointer to a node, takes its nth arg
@@ -386,7 +457,7 @@ pub fn link(heap: &Heap, loc: u64, ptr: Ptr) -> Ptr {
 // -----------------
 
 pub fn new_atomic_u8_array(size: usize) -> Box<[AtomicU8]> {
-  return unsafe { Box::from_raw(AtomicU8::from_mut_slice(Box::leak(vec![0xFFu8; size].into_boxed_slice()))) }
+  return unsafe { Box::from_raw(AtomicU8::from_mut_slice(Box::leak(vec![0u8; size].into_boxed_slice()))) }
 }
 
 pub fn new_atomic_u64_array(size: usize) -> Box<[AtomicU64]> {
@@ -397,7 +468,27 @@ pub fn new_tids(tids: usize) -> Box<[usize]> {
   return (0 .. tids).collect::<Vec<usize>>().into_boxed_slice();
 }
 
-pub fn new_heap(size: usize, tids: usize) -> Heap {
+// Locations are 32-bit, so the heap can't have more cells than this
+pub const HEAP_MAX_CELLS : usize = 1 << 32;
+
+// How many cells a thread takes from the reserved space when its areas are full
+pub const HEAP_GROWTH : u64 = 1 << 24;
+
+// The node and mark arrays are reserved for HEAP_MAX_CELLS cells, of which the first `size` are
+// split between threads. Memory is only committed as cells are touched, and threads whose areas
+// fill up take new chunks of HEAP_GROWTH cells from the rest of the reserved space, which become
+// areas of theirs too (see `alloc`). If the address space can't be reserved, the heap is limited
+// to `size` cells. Since a thread is the first to write to its areas, the OS places their pages on
+// that thread's NUMA node, which is stable once workers are pinned.
+pub fn new_heap_maps(size: usize) -> (MemMap<AtomicU64>, MemMap<AtomicU64>) {
+  let cells = std::cmp::max(size, HEAP_MAX_CELLS);
+  if let (Some(node), Some(mark)) = (MemMap::reserve(cells), MemMap::reserve(cells / 64)) {
+    return (node, mark);
+  }
+  return (MemMap::new(size), MemMap::new((size + 63) / 64));
+}
+
+pub fn new_heap(size: usize, tids: usize, mode: AllocMode) -> Heap {
   let mut lvar = vec![];
   for tid in 0 .. tids {
     lvar.push(CachePadded::new(LocalVars {
@@ -406,36 +497,96 @@ pub fn new_heap(size: usize, tids: usize) -> Heap {
       next: AtomicU64::new((size / tids * (tid + 0)) as u64),
       amin: AtomicU64::new((size / tids * (tid + 0)) as u64),
       amax: AtomicU64::new((size / tids * (tid + 1)) as u64),
-      dups: AtomicU64::new(((1 << 28) / tids * tid) as u64),
+      room: AtomicU64::new((size / tids) as u64),
+      dups: AtomicU64::new(0),
+      dmax: AtomicU64::new(0),
       cost: AtomicU64::new(0),
+      fcnt: AtomicU64::new(0),
+      free: std::array::from_fn(|_| AtomicU64::new(FREE_LIST_END)),
     }))
   }
-  let node = new_atomic_u64_array(size);
-  let lock = new_atomic_u8_array(size);
+  let (node, mark) = new_heap_maps(size);
+  // The arena grows by whole pages, so its chunks start at a page boundary
+  let base = if mode == AllocMode::Arena { std::cmp::min(size.next_multiple_of(PAGE_SIZE), node.len()) as u64 } else { size as u64 };
+  let grow = AtomicU64::new(base);
+  let owns = (0 .. (node.len() as u64 - base) / HEAP_GROWTH).map(|_| AtomicU64::new(0)).collect();
   let lvar = lvar.into_boxed_slice();
   let rbag = RedexBag::new(tids);
-  let aloc = (0 .. tids).map(|x| new_atomic_u64_array(1 << 20)).collect::<Vec<Box<[AtomicU64]>>>().into_boxed_slice();
-  let vbuf = (0 .. tids).map(|x| new_atomic_u64_array(1 << 16)).collect::<Vec<Box<[AtomicU64]>>>().into_boxed_slice();
+  // Per-thread buffers are committed lazily too, so that their owners place them
+  let aloc = (0 .. tids).map(|x| MemMap::new(1 << 20)).collect::<Vec<MemMap<AtomicU64>>>().into_boxed_slice();
+  let vbuf = (0 .. tids).map(|x| MemMap::new(1 << 16)).collect::<Vec<MemMap<AtomicU64>>>().into_boxed_slice();
   let vstk = (0 .. tids).map(|x| VisitQueue::new()).collect::<Vec<VisitQueue>>().into_boxed_slice();
-  return Heap { tids, node, lock, lvar, rbag, aloc, vbuf, vstk };
+  let arena = if mode == AllocMode::Arena { Some(Allocator::new(size, tids, node.len())) } else { None };
+  let steal = StealMode::Random;
+  let dirt = AtomicBool::new(false);
+  let pool = Pool::new(tids);
+  let bufs = BufferStore::new();
+  let labs = LabelSpace::new();
+  let memo = MemoTable::new();
+  let prof = None;
+  let gc = None;
+  let tele = None;
+  let io = Reactor::new();
+  return Heap { tids, node, grow, base, owns, lvar, rbag, aloc, vbuf, vstk, arena, steal, mark, dirt, pool, bufs, labs, memo, prof, gc, tele, io };
 }
 
 // Allocator
 // ---------
 
+// Each thread keeps one free list per node size (1 up to FREE_LIST_SIZES - 1 cells), so freed
+// nodes can be reused in O(1). A node sitting on a free list has its 1st cell set to `Nil(next)`,
+// where `next` is the location of the next free node of the same size (or FREE_LIST_END), and its
+// remaining cells set to `Nil(0)`. Since these cells are never 0, the scanning allocator, which is
+// still used when the free list of a size is empty, won't hand them out twice. To avoid a thread
+// hoarding space that other threads' scanners could use, a free list only keeps up to 1/16 of the
+// thread's area; beyond that, and for larger nodes, `free()` zeroes the cells as before. A node
+// popped from a free list keeps its `Nil` cells until it is linked: zeroing them would let the
+// scanner, once it wraps around, hand the same cells out again before they're written. For the
+// same reason, the scanner sets the cells it hands out to `Nil(0)`, since a rule body allocates
+// all of its nodes before writing any.
+
+pub const FREE_LIST_SIZES : usize = 32;
+pub const FREE_LIST_END   : u64 = 0xFFFF_FFFF;
+pub const FREE_LIST_RATIO : u64 = 16;
+
 pub fn alloc(heap: &Heap, tid: usize, arity: u64) -> u64 {
+  prof_inc(heap, tid, PROF_ALLOC, 1);
+  unsafe { *heap.lvar.get_unchecked(tid).used.as_mut_ptr() += arity as i64 };
+  if let Some(arena) = &heap.arena {
+    loop {
+      if let Some(loc) = arena.alloc(tid, arity) {
+        return loc;
+      }
+      if !take_pages(heap) {
+        panic!("arena allocator: out of memory");
+      }
+    }
+  }
   unsafe {
     let lvar = &heap.lvar.get_unchecked(tid);
     if arity == 0 {
       0
     } else {
+      // Pops a node of this size from the free list, if any
+      if arity < FREE_LIST_SIZES as u64 {
+        let head = lvar.free.get_unchecked(arity as usize).as_mut_ptr();
+        if *head != FREE_LIST_END {
+          let loc = *head;
+          let lnk = heap.node.get_unchecked(loc as usize).load(Ordering::Relaxed);
+          // Nothing points to a freed node, so nothing writes its first cell until it's popped. The
+          // only write that doesn't need a pointer, `release_lock`, goes to a dup's last cell.
+          debug_assert!(get_tag(lnk) == NIL, "free list node {} of size {} was written after being freed", loc, arity);
+          *head = get_val(lnk);
+          *lvar.fcnt.as_mut_ptr() -= arity;
+          prof_inc(heap, tid, PROF_ALLOC_REUSE, 1);
+          return loc;
+        }
+      }
+      // Otherwise, scans this thread's area for `arity` empty cells in a row
       let mut length = 0;
-      //let mut count = 0;
+      let mut steps = 0;
       loop {
-        //count += 1;
-        //if tid == 9 && count > 5000000 {
-          //println!("[9] slow-alloc {} | {}", count, *lvar.next.as_mut_ptr());
-        //}
+        steps += 1;
         // Loads value on cursor
         let val = heap.node.get_unchecked(*lvar.next.as_mut_ptr() as usize).load(Ordering::Relaxed);
         // If it is empty, increment length
@@ -447,29 +598,133 @@ pub fn alloc(heap: &Heap, tid: usize, arity: u64) -> u64 {
         };
         // Moves cursor right
         *lvar.next.as_mut_ptr() += 1;
-        // If it is out of bounds, warp around
+        // If it is out of bounds, moves on to the thread's next area, wrapping around. Only once a
+        // whole pass over them found no room does it take a new area from the reserved space.
         if *lvar.next.as_mut_ptr() >= *lvar.amax.as_mut_ptr() {
           length = 0;
-          *lvar.next.as_mut_ptr() = *lvar.amin.as_mut_ptr();
+          let full = steps >= *lvar.room.as_mut_ptr() && take_chunk(heap, tid);
+          if !full {
+            next_area(heap, tid);
+          }
         }
         // If length equals arity, allocate that space
         if length == arity {
-          //println!("[{}] return", lvar.tid);
-          //println!("[{}] alloc {} at {}", lvar.tid, arity, lvar.next - length);
-          //lvar.used.fetch_add(arity as i64, Ordering::Relaxed);
-          //if tid == 9 && count > 50000 {
-            //println!("[{}] allocated {}! {}", 9, length, *lvar.next.as_mut_ptr() - length);
-          //}
-          return *lvar.next.as_mut_ptr() - length;
+          let loc = *lvar.next.as_mut_ptr() - length;
+          for i in 0 .. arity {
+            heap.node.get_unchecked((loc + i) as usize).store(Nil(0), Ordering::Relaxed);
+          }
+          prof_inc(heap, tid, PROF_ALLOC_SCAN, steps);
+          return loc;
         }
       }
     }
   }
 }
 
+// A thread's areas are its part of the initial heap, then the chunks it took, in order. Rescanning
+// them is safe: a cell is only zeroed by `free`, once the rewrite that consumed its node is done
+// with it, and a node that was handed out holds `Nil` cells until it is written.
+
+// Makes a chunk past the initial heap the thread's current area. Returns false if the reserved
+// space is used up.
+pub fn take_chunk(heap: &Heap, tid: usize) -> bool {
+  unsafe {
+    let lvar = &heap.lvar.get_unchecked(tid);
+    let init = heap.grow.load(Ordering::Relaxed);
+    if init + HEAP_GROWTH > heap.node.len() as u64 {
+      return false;
+    }
+    let init = heap.grow.fetch_add(HEAP_GROWTH, Ordering::Relaxed);
+    if init + HEAP_GROWTH > heap.node.len() as u64 {
+      return false;
+    }
+    heap.owns[((init - heap.base) / HEAP_GROWTH) as usize].store(tid as u64 + 1, Ordering::Relaxed);
+    *lvar.amin.as_mut_ptr() = init;
+    *lvar.amax.as_mut_ptr() = init + HEAP_GROWTH;
+    *lvar.next.as_mut_ptr() = init;
+    *lvar.room.as_mut_ptr() += HEAP_GROWTH;
+    return true;
+  }
+}
+
+// Grows the arena by a chunk past the initial heap. Returns false if the reserved space is used up.
+pub fn take_pages(heap: &Heap) -> bool {
+  if let Some(arena) = &heap.arena {
+    let init = heap.grow.load(Ordering::Relaxed);
+    if init + HEAP_GROWTH > heap.node.len() as u64 {
+      return false;
+    }
+    let init = heap.grow.fetch_add(HEAP_GROWTH, Ordering::Relaxed);
+    if init + HEAP_GROWTH > heap.node.len() as u64 {
+      return false;
+    }
+    arena.extend((init + HEAP_GROWTH) / PAGE_SIZE as u64);
+    return true;
+  }
+  return false;
+}
+
+// Moves the thread's cursor to the start of its area after the current one, or of its first area
+pub fn next_area(heap: &Heap, tid: usize) {
+  unsafe {
+    let lvar = &heap.lvar.get_unchecked(tid);
+    let amin = *lvar.amin.as_mut_ptr();
+    let from = if amin >= heap.base { (amin - heap.base) / HEAP_GROWTH + 1 } else { 0 };
+    let (amin, amax) = (from as usize .. heap.owns.len())
+      .find(|chunk| heap.owns[*chunk].load(Ordering::Relaxed) == tid as u64 + 1)
+      .map(|chunk| (heap.base + chunk as u64 * HEAP_GROWTH, heap.base + (chunk as u64 + 1) * HEAP_GROWTH))
+      .unwrap_or_else(|| first_area(heap, tid));
+    *lvar.amin.as_mut_ptr() = amin;
+    *lvar.amax.as_mut_ptr() = amax;
+    *lvar.next.as_mut_ptr() = amin;
+  }
+}
+
+// Moves the thread's cursor back to the start of its first area
+pub fn rewind_area(heap: &Heap, tid: usize) {
+  unsafe {
+    let lvar = &heap.lvar.get_unchecked(tid);
+    let (amin, amax) = first_area(heap, tid);
+    *lvar.amin.as_mut_ptr() = amin;
+    *lvar.amax.as_mut_ptr() = amax;
+    *lvar.next.as_mut_ptr() = amin;
+  }
+}
+
+// The thread's part of the initial heap
+pub fn first_area(heap: &Heap, tid: usize) -> (u64, u64) {
+  let size = heap.base / heap.tids as u64;
+  return (size * tid as u64, size * (tid as u64 + 1));
+}
+
 pub fn free(heap: &Heap, tid: usize, loc: u64, arity: u64) {
-  for i in 0 .. arity {
-    unsafe { heap.node.get_unchecked((loc + i) as usize) }.store(0, Ordering::Relaxed);
+  unsafe { *heap.lvar.get_unchecked(tid).used.as_mut_ptr() -= arity as i64 };
+  if let Some(arena) = &heap.arena {
+    for i in 0 .. arity {
+      unsafe { heap.node.get_unchecked((loc + i) as usize) }.store(0, Ordering::Relaxed);
+    }
+    return arena.free(tid, loc, arity);
+  }
+  unsafe {
+    let lvar = &heap.lvar.get_unchecked(tid);
+    // Pushes the node to the free list of its size, if it isn't full
+    if arity > 0 && arity < FREE_LIST_SIZES as u64 {
+      let fcnt = lvar.fcnt.as_mut_ptr();
+      if *fcnt + arity <= (*lvar.amax.as_mut_ptr() - *lvar.amin.as_mut_ptr()) / FREE_LIST_RATIO {
+        let head = lvar.free.get_unchecked(arity as usize).as_mut_ptr();
+        heap.node.get_unchecked(loc as usize).store(Nil(*head), Ordering::Relaxed);
+        for i in 1 .. arity {
+          heap.node.get_unchecked((loc + i) as usize).store(Nil(0), Ordering::Relaxed);
+        }
+        *head = loc;
+        *fcnt += arity;
+        return;
+      }
+    }
+    // Otherwise, gives the cells back to the arena
+    for i in 0 .. arity {
+      heap.node.get_unchecked((loc + i) as usize).store(0, Ordering::Relaxed);
+    }
   }
 }
 
@@ -493,6 +748,9 @@ pub fn atomic_subst(heap: &Heap, arit: &ArityMap, tid: usize, var: Ptr, val: Ptr
   loop {
     let arg_ptr = load_ptr(heap, get_loc(var, get_tag(var) & 0x01));
     if get_tag(arg_ptr) == ARG {
+      if get_mark(heap, get_loc(arg_ptr, 0)) {
+        heap.dirt.store(true, Ordering::Relaxed);
+      }
       if heap.tids == 1 {
         link(heap, get_loc(arg_ptr, 0), val);
         return;
@@ -513,19 +771,77 @@ pub fn atomic_subst(heap: &Heap, arit: &ArityMap, tid: usize, var: Ptr, val: Ptr
 
 // Locks
 // -----
+// A dup node is locked while it is reduced, or collected, since it can be reached through both of
+// its variables. The lock is the node's 4th cell, so taking it touches the cache line the rewrite
+// reads anyway, and there's no per-cell lock array. It holds a LCK pointer: LOCK_OPEN, or one with
+// the holder's id (plus one). It isn't 0 nor NIL, so that neither the scanning allocator nor a
+// snapshot take it for an empty cell. Since `free` writes over the node, freeing a dup node releases its lock, and the
+// holder must not release it again. A node is reused with arbitrary cells, so dup nodes are made
+// with `alloc_dup`, which opens the lock.
 
-pub const LOCK_OPEN : u8 = 0xFF;
+pub const LOCK_OPEN : u64 = LCK * TAG;
 
-pub fn acquire_lock(heap: &Heap, tid: usize, term: Ptr) -> Result<u8, u8> {
-  let locker = unsafe { heap.lock.get_unchecked(get_loc(term, 0) as usize) };
-  locker.compare_exchange_weak(LOCK_OPEN, tid as u8, Ordering::Acquire, Ordering::Relaxed)
+pub fn alloc_dup(heap: &Heap, tid: usize) -> u64 {
+  let loc = alloc(heap, tid, 4);
+  open_lock(heap, loc);
+  return loc;
+}
+
+pub fn open_lock(heap: &Heap, loc: u64) {
+  unsafe { heap.node.get_unchecked((loc + 3) as usize) }.store(LOCK_OPEN, Ordering::Relaxed);
+}
+
+pub fn acquire_lock(heap: &Heap, tid: usize, term: Ptr) -> Result<u64, u64> {
+  let locker = unsafe { heap.node.get_unchecked(get_loc(term, 3) as usize) };
+  let got = locker.compare_exchange_weak(LOCK_OPEN, Lck(tid as u64 + 1), Ordering::Acquire, Ordering::Relaxed);
+  if got.is_err() {
+    prof_inc(heap, tid, PROF_LOCK_FAIL, 1);
+  }
+  return got;
 }
 
 pub fn release_lock(heap: &Heap, tid: usize, term: Ptr) {
-  let locker = unsafe { heap.lock.get_unchecked(get_loc(term, 0) as usize) };
+  let locker = unsafe { heap.node.get_unchecked(get_loc(term, 3) as usize) };
   locker.store(LOCK_OPEN, Ordering::Release)
 }
 
+pub fn is_locked(heap: &Heap, term: Ptr) -> bool {
+  return load_arg(heap, term, 3) != LOCK_OPEN;
+}
+
+// Normalization Marks
+// -------------------
+
+// While normalizing, a location is marked once its term is on WHNF and its children were queued,
+// so it isn't visited again. Marks are kept in a bitset, one bit per cell, and cleared by the
+// threads that set them at the end of each pass. If a substitution writes to a marked location,
+// the heap is flagged as dirty, since that part of the normal form changed, and `normalize` runs
+// another pass. A normalized node can only be freed after such a change, so a stale mark on a
+// reused location is also covered by that extra pass.
+
+// Marks a location, returning false if it was already marked. Words that were empty are pushed to
+// `seen`, so that the caller can clear them when it is done.
+pub fn set_mark(heap: &Heap, loc: u64, seen: &mut Vec<u64>) -> bool {
+  let word = unsafe { heap.mark.get_unchecked((loc / 64) as usize) };
+  if (word.load(Ordering::Relaxed) >> (loc % 64)) & 1 == 1 {
+    return false;
+  }
+  let old = word.fetch_or(1 << (loc % 64), Ordering::Relaxed);
+  if old == 0 {
+    seen.push(loc / 64);
+  }
+  return (old >> (loc % 64)) & 1 == 0;
+}
+
+pub fn get_mark(heap: &Heap, loc: u64) -> bool {
+  let word = unsafe { heap.mark.get_unchecked((loc / 64) as usize) };
+  return (word.load(Ordering::Relaxed) >> (loc % 64)) & 1 == 1;
+}
+
+pub fn clear_mark_word(heap: &Heap, index: u64) {
+  unsafe { heap.mark.get_unchecked(index as usize) }.store(0, Ordering::Relaxed);
+}
+
 // Garbage Collection
 // ------------------
 
@@ -587,8 +903,8 @@ pub fn release_lock(heap: &Heap, tid: usize, term: Ptr) {
 // the owner of `b1` decide what to do. But `b1` is contained inside the expression, so it has no
 // owner anymore; it forms a cycle, and no other part of the program will access it! This will not
 // be handled by HVM's automatic collector and will be left as a memory leak. Under normal
-// circumstances, the leak is too minimal to be a problem. It could be eliminated by enabling an
-// external garbage collector (which would rarely need to be triggered), or avoided altogether by
+// circumstances, the leak is too minimal to be a problem. It is eliminated by enabling the tracing
+// collector (see `gc.rs`), which rarely needs to be triggered, or avoided altogether by
 // not allowing inputs that can result in self-referential clones on the input language's type
 // system. Sadly, it is an issue that exists, and, for the time being, I'm not aware of a good
 // solution that maintains HVM philosophy of only including constant-time compute primitives.
@@ -604,9 +920,10 @@ pub fn collect(heap: &Heap, arit: &ArityMap, tid: usize, term: Ptr) {
         if acquire_lock(heap, tid, term).is_ok() {
           if get_tag(load_arg(heap, term, 1)) == ERA {
             coll.push(take_arg(heap, term, 2));
-            free(heap, tid, get_loc(term, 0), 3);
+            free(heap, tid, get_loc(term, 0), 4);
+          } else {
+            release_lock(heap, tid, term);
           }
-          release_lock(heap, tid, term);
         }
       }
       DP1 => {
@@ -614,9 +931,10 @@ pub fn collect(heap: &Heap, arit: &ArityMap, tid: usize, term: Ptr) {
         if acquire_lock(heap, tid, term).is_ok() {
           if get_tag(load_arg(heap, term, 0)) == ERA {
             coll.push(take_arg(heap, term, 2));
-            free(heap, tid, get_loc(term, 0), 3);
+            free(heap, tid, get_loc(term, 0), 4);
+          } else {
+            release_lock(heap, tid, term);
           }
-          release_lock(heap, tid, term);
         }
       }
       VAR => {
@@ -648,6 +966,9 @@ pub fn collect(heap: &Heap, arit: &ArityMap, tid: usize, term: Ptr) {
       }
       U60 => {}
       F60 => {}
+      BUF => {
+        free_buffer(heap, tid, term);
+      }
       CTR | FUN => {
         let arity = arity_of(arit, term);
         for i in 0 .. arity {
@@ -671,3 +992,38 @@ pub fn collect(heap: &Heap, arit: &ArityMap, tid: usize, term: Ptr) {
     }
   }
 }
+
+#[cfg(test)]
+mod tests {
+  use crate::runtime::{*};
+
+  // Allocates far more cells in total than the heap has, but only a few hundred at a time
+  pub const CHURN : &str = "
+    (Range 0 xs) = xs
+    (Range n xs) = (Range (- n 1) (List.cons n xs))
+    (Len List.nil) = 0
+    (Len (List.cons x xs)) = (+ 1 (Len xs))
+    (Loop 0 !acc) = acc
+    (Loop n !acc) = (Loop (- n 1) (+ acc (Len (Range 100 List.nil))))
+  ";
+
+  #[test]
+  fn test_alloc_rescans_its_area() {
+    let size = 1 << 16;
+    let mut rt = Runtime::from_code_with(CHURN, size, 1, false).unwrap();
+    let host = rt.normalize_code("(Loop 20000 0)");
+    assert_eq!(get_num(rt.load_ptr(host)), 2000000);
+    // The scanner found room by wrapping around, without taking chunks of the reserved space
+    assert_eq!(get_heap_end(&rt.heap), size);
+  }
+
+  #[test]
+  fn test_arena_grows_past_its_pages() {
+    let size = PAGE_SIZE * 2;
+    let mut rt = Runtime::from_code_with(CHURN, size, 1, false).unwrap();
+    rt.heap = new_heap(size, 1, AllocMode::Arena);
+    let host = rt.normalize_code("(Len (Range 10000 List.nil))");
+    assert_eq!(get_num(rt.load_ptr(host)), 10000);
+    assert!(get_heap_end(&rt.heap) > size);
+  }
+}
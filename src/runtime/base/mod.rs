@@ -1,12 +1,28 @@
+pub mod array;
+pub mod buffer;
+pub mod cache;
 pub mod debug;
+pub mod gc;
+pub mod jit;
 pub mod memory;
 pub mod precomp;
+pub mod profile;
 pub mod program;
 pub mod reducer;
+pub mod snapshot;
+pub mod telemetry;
 
+pub use array::{*};
+pub use buffer::{*};
+pub use cache::{*};
 pub use debug::{*};
+pub use gc::{*};
+pub use jit::{*};
 pub use memory::{*};
 pub use precomp::{*};
+pub use profile::{*};
 pub use program::{*};
 pub use reducer::{*};
+pub use snapshot::{*};
+pub use telemetry::{*};
 
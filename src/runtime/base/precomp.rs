@@ -46,6 +46,16 @@ pub const HVM_PRINT : u64 = 26;
 pub const HVM_SLEEP : u64 = 27;
 pub const HVM_STORE : u64 = 28;
 pub const HVM_LOAD : u64 = 29;
+pub const BUFFER_PACK : u64 = 30;
+pub const BUFFER_LENGTH : u64 = 31;
+pub const BUFFER_GET : u64 = 32;
+pub const BUFFER_SLICE : u64 = 33;
+pub const ARRAY_PACK : u64 = 34;
+pub const ARRAY_NEW : u64 = 35;
+pub const ARRAY_MAP : u64 = 36;
+pub const ARRAY_ZIP : u64 = 37;
+pub const ARRAY_FOLD : u64 = 38;
+pub const HVM_WAIT : u64 = 39;
 //[[CODEGEN:PRECOMP-IDS]]//
 
 pub const PRECOMP : &[Precomp] = &[
@@ -229,7 +239,7 @@ pub const PRECOMP : &[Precomp] = &[
   Precomp {
     id: HVM_SLEEP,
     name: "HVM.sleep",
-    smap: &[false; 2],
+    smap: &[true, false],
     funs: Some(PrecompFuns {
       visit: hvm_sleep_visit,
       apply: hvm_sleep_apply,
@@ -253,6 +263,96 @@ pub const PRECOMP : &[Precomp] = &[
       apply: hvm_load_apply,
     }),
   },
+  Precomp {
+    id: BUFFER_PACK,
+    name: "Buffer.pack",
+    smap: &[false; 1],
+    funs: Some(PrecompFuns {
+      visit: buffer_pack_visit,
+      apply: buffer_pack_apply,
+    }),
+  },
+  Precomp {
+    id: BUFFER_LENGTH,
+    name: "Buffer.length",
+    smap: &[true],
+    funs: Some(PrecompFuns {
+      visit: buffer_length_visit,
+      apply: buffer_length_apply,
+    }),
+  },
+  Precomp {
+    id: BUFFER_GET,
+    name: "Buffer.get",
+    smap: &[true, true],
+    funs: Some(PrecompFuns {
+      visit: buffer_get_visit,
+      apply: buffer_get_apply,
+    }),
+  },
+  Precomp {
+    id: BUFFER_SLICE,
+    name: "Buffer.slice",
+    smap: &[true, true, true],
+    funs: Some(PrecompFuns {
+      visit: buffer_slice_visit,
+      apply: buffer_slice_apply,
+    }),
+  },
+  Precomp {
+    id: ARRAY_PACK,
+    name: "Array.pack",
+    smap: &[false; 1],
+    funs: Some(PrecompFuns {
+      visit: array_pack_visit,
+      apply: array_pack_apply,
+    }),
+  },
+  Precomp {
+    id: ARRAY_NEW,
+    name: "Array.new",
+    smap: &[true, true],
+    funs: Some(PrecompFuns {
+      visit: array_new_visit,
+      apply: array_new_apply,
+    }),
+  },
+  Precomp {
+    id: ARRAY_MAP,
+    name: "Array.map",
+    smap: &[true, true],
+    funs: Some(PrecompFuns {
+      visit: array_map_visit,
+      apply: array_map_apply,
+    }),
+  },
+  Precomp {
+    id: ARRAY_ZIP,
+    name: "Array.zip",
+    smap: &[true, true, true],
+    funs: Some(PrecompFuns {
+      visit: array_zip_visit,
+      apply: array_zip_apply,
+    }),
+  },
+  Precomp {
+    id: ARRAY_FOLD,
+    name: "Array.fold",
+    smap: &[true, true, true],
+    funs: Some(PrecompFuns {
+      visit: array_fold_visit,
+      apply: array_fold_apply,
+    }),
+  },
+  Precomp {
+    id: HVM_WAIT,
+    name: "HVM.wait",
+    smap: &[false; 2],
+    funs: Some(PrecompFuns {
+      visit: hvm_wait_visit,
+      apply: hvm_wait_apply,
+    }),
+  },
 //[[CODEGEN:PRECOMP-ELS]]//
 ];
 
@@ -373,22 +473,9 @@ fn hvm_query_visit(ctx: ReduceCtx) -> bool {
 }
 
 fn hvm_query_apply(ctx: ReduceCtx) -> bool {
-  fn read_input() -> String {
-    use std::io::{stdin,stdout,Write};
-    let mut input = String::new();
-    stdin().read_line(&mut input).expect("string");
-    if let Some('\n') = input.chars().next_back() { input.pop(); }
-    if let Some('\r') = input.chars().next_back() { input.pop(); }
-    return input;
-  }
   let cont = load_arg(ctx.heap, ctx.term, 0);
-  let text = make_string(ctx.heap, ctx.tid, &read_input());
-  let app0 = alloc(ctx.heap, ctx.tid, 2);
-  link(ctx.heap, app0 + 0, cont);
-  link(ctx.heap, app0 + 1, text);
-  free(ctx.heap, 0, get_loc(ctx.term, 0), 1);
-  let done = App(app0);
-  link(ctx.heap, *ctx.host, done);
+  free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 1);
+  await_effect(&ctx, Effect::Query, cont);
   return true;
 }
 
@@ -400,13 +487,15 @@ fn hvm_print_visit(ctx: ReduceCtx) -> bool {
 }
 
 fn hvm_print_apply(ctx: ReduceCtx) -> bool {
-  //normalize(ctx.heap, ctx.prog, &[ctx.tid], get_loc(ctx.term, 0), false);
-  if let Some(text) = crate::language::readback::as_string(ctx.heap, ctx.prog, &[ctx.tid], get_loc(ctx.term, 0)) {
-    println!("{}", text);
-  }
-  link(ctx.heap, *ctx.host, load_arg(ctx.heap, ctx.term, 1));
+  let text = crate::language::readback::as_bytes(ctx.heap, ctx.prog, &[ctx.tid], get_loc(ctx.term, 0)).map(|text| text.into_owned());
+  let cont = load_arg(ctx.heap, ctx.term, 1);
   collect(ctx.heap, &ctx.prog.aris, ctx.tid, load_ptr(ctx.heap, get_loc(ctx.term, 0)));
   free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 2);
+  if let Some(text) = text {
+    await_effect(&ctx, Effect::Print(text), cont);
+  } else {
+    link(ctx.heap, *ctx.host, cont);
+  }
   return true;
 }
 
@@ -414,18 +503,25 @@ fn hvm_print_apply(ctx: ReduceCtx) -> bool {
 // ----------------------------------
 
 fn hvm_sleep_visit(ctx: ReduceCtx) -> bool {
-  return false;
+  return fun::visit(ctx, &[0]);
 }
 
 fn hvm_sleep_apply(ctx: ReduceCtx) -> bool {
-  let time = reduce(ctx.heap, ctx.prog, &[ctx.tid], get_loc(ctx.term, 0), true, false);
-  std::thread::sleep(std::time::Duration::from_nanos(get_num(time)));
-  link(ctx.heap, *ctx.host, load_ptr(ctx.heap, get_loc(ctx.term, 1)));
-  free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 2);
-  return true;
+  let arg0 = load_arg(ctx.heap, ctx.term, 0);
+  if get_tag(arg0) == SUP {
+    fun::superpose(ctx.heap, &ctx.prog.aris, ctx.tid, *ctx.host, ctx.term, arg0, 0);
+    return true;
+  }
+  if get_tag(arg0) == U60 {
+    let cont = load_arg(ctx.heap, ctx.term, 1);
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 2);
+    await_effect(&ctx, Effect::Sleep(get_num(arg0)), cont);
+    return true;
+  }
+  return false;
 }
 
-// HVM.store (key: String) (val: String) (cont: Term)
+// HVM.store (key: String) (val: String | Buffer) (cont: Term)
 // --------------------------------------------------
 
 fn hvm_store_visit(ctx: ReduceCtx) -> bool {
@@ -434,26 +530,21 @@ fn hvm_store_visit(ctx: ReduceCtx) -> bool {
 
 fn hvm_store_apply(ctx: ReduceCtx) -> bool {
   if let Some(key) = crate::language::readback::as_string(ctx.heap, ctx.prog, &[ctx.tid], get_loc(ctx.term, 0)) {
-    if let Some(val) = crate::language::readback::as_string(ctx.heap, ctx.prog, &[ctx.tid], get_loc(ctx.term, 1)) {
-      if std::fs::write(key, val).is_ok() {
-        //let app0 = alloc(ctx.heap, ctx.tid, 2);
-        //link(ctx.heap, app0 + 0, cont);
-        //link(ctx.heap, app0 + 1, U6O(0));
-        //free(ctx.heap, 0, get_loc(ctx.term, 0), 2);
-        let done = load_arg(ctx.heap, ctx.term, 2);
-        link(ctx.heap, *ctx.host, done);
-        collect(ctx.heap, &ctx.prog.aris, ctx.tid, load_arg(ctx.heap, ctx.term, 0));
-        collect(ctx.heap, &ctx.prog.aris, ctx.tid, load_arg(ctx.heap, ctx.term, 1));
-        free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 3);
-        return true;
-      }
+    if let Some(val) = crate::language::readback::as_bytes(ctx.heap, ctx.prog, &[ctx.tid], get_loc(ctx.term, 1)) {
+      let val = val.into_owned();
+      let cont = load_arg(ctx.heap, ctx.term, 2);
+      collect(ctx.heap, &ctx.prog.aris, ctx.tid, load_arg(ctx.heap, ctx.term, 0));
+      collect(ctx.heap, &ctx.prog.aris, ctx.tid, load_arg(ctx.heap, ctx.term, 1));
+      free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 3);
+      await_effect(&ctx, Effect::Store(key, val), cont);
+      return true;
     }
   }
   println!("Runtime failure on: {}", show_at(ctx.heap, ctx.prog, *ctx.host, &[]));
   std::process::exit(0);
 }
 
-// HVM.load (key: String) (cont: String -> Term)
+// HVM.load (key: String) (cont: Buffer -> Term)
 // ---------------------------------------------
 
 fn hvm_load_visit(ctx: ReduceCtx) -> bool {
@@ -462,22 +553,381 @@ fn hvm_load_visit(ctx: ReduceCtx) -> bool {
 
 fn hvm_load_apply(ctx: ReduceCtx) -> bool {
   if let Some(key) = crate::language::readback::as_string(ctx.heap, ctx.prog, &[ctx.tid], get_loc(ctx.term, 0)) {
-    if let Ok(file) = std::fs::read(key) {
-      if let Ok(file) = std::str::from_utf8(&file) {
-        let cont = load_arg(ctx.heap, ctx.term, 1); 
-        let text = make_string(ctx.heap, ctx.tid, file);
-        let app0 = alloc(ctx.heap, ctx.tid, 2);
-        link(ctx.heap, app0 + 0, cont);
-        link(ctx.heap, app0 + 1, text);
-        free(ctx.heap, 0, get_loc(ctx.term, 0), 2);
-        let done = App(app0);
+    let cont = load_arg(ctx.heap, ctx.term, 1);
+    collect(ctx.heap, &ctx.prog.aris, ctx.tid, load_arg(ctx.heap, ctx.term, 0));
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 2);
+    await_effect(&ctx, Effect::Load(key), cont);
+    return true;
+  }
+  println!("Runtime failure on: {}", show_at(ctx.heap, ctx.prog, *ctx.host, &[]));
+  std::process::exit(0);
+}
+
+// HVM.wait (slot: U60) (cont: Term)
+// ---------------------------------
+// Passes the result of an effect the reactor performs to `cont`. Until the effect completes, the
+// reducer parks the tasks that visit it, instead of applying it (see `park_effect`).
+
+fn hvm_wait_visit(ctx: ReduceCtx) -> bool {
+  return false;
+}
+
+fn hvm_wait_apply(ctx: ReduceCtx) -> bool {
+  if let Some(done) = ctx.heap.io.take(get_num(load_arg(ctx.heap, ctx.term, 0))) {
+    let cont = load_arg(ctx.heap, ctx.term, 1);
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 2);
+    finish_effect(ctx.heap, ctx.tid, *ctx.host, cont, done);
+    return true;
+  }
+  return false;
+}
+
+// Effects
+// -------
+// The IO of an effect is performed by the heap's reactor (see `data::reactor`), off the reducer
+// threads. Its term is replaced by `(HVM.wait slot cont)`, which the reducer parks until the IO
+// completes, so that the thread goes on reducing other terms meanwhile. Reducers started by a
+// primitive can't park their tasks, so they perform effects in place.
+
+fn await_effect(ctx: &ReduceCtx, effect: Effect, cont: Ptr) {
+  if is_nested() {
+    finish_effect(ctx.heap, ctx.tid, *ctx.host, cont, run_effect(effect));
+  } else {
+    let slot = ctx.heap.io.submit(effect);
+    let wait = alloc(ctx.heap, ctx.tid, 2);
+    link(ctx.heap, wait + 0, U6O(slot));
+    link(ctx.heap, wait + 1, cont);
+    link(ctx.heap, *ctx.host, Fun(HVM_WAIT, wait));
+  }
+}
+
+// Replaces `host` by `cont`, applied to the effect's result, if it has one
+fn finish_effect(heap: &Heap, tid: usize, host: u64, cont: Ptr, done: EffectDone) {
+  let data = match done {
+    EffectDone::Unit => {
+      link(heap, host, cont);
+      return;
+    }
+    EffectDone::Text(text) => make_string(heap, tid, &text),
+    EffectDone::Bytes(data) => make_buffer(heap, tid, BUFFER_BYTES, data),
+    EffectDone::Fail(err) => {
+      println!("Runtime failure: {}", err);
+      std::process::exit(0);
+    }
+  };
+  let app0 = alloc(heap, tid, 2);
+  link(heap, app0 + 0, cont);
+  link(heap, app0 + 1, data);
+  link(heap, host, App(app0));
+}
+
+// Parks the task at `host` if the effect its `HVM.wait` waits on didn't complete, returning whether
+// it did. The reactor hands its redex back once the effect completes (see the reducer's steal loop).
+pub fn park_effect(heap: &Heap, redex: &RedexBag, tid: usize, host: u64, cont: u64, term: Ptr) -> bool {
+  let slot = get_num(load_arg(heap, term, 0));
+  if heap.io.is_done(slot) {
+    return false;
+  }
+  heap.io.park(slot, redex.insert(tid, new_redex(host, cont, 1)));
+  return true;
+}
+
+// Buffer.pack (text: String) -> Buffer
+// ------------------------------------
+
+fn buffer_pack_visit(ctx: ReduceCtx) -> bool {
+  return false;
+}
+
+fn buffer_pack_apply(ctx: ReduceCtx) -> bool {
+  if let Some(text) = crate::language::readback::as_string(ctx.heap, ctx.prog, &[ctx.tid], get_loc(ctx.term, 0)) {
+    inc_cost(ctx.heap, ctx.tid);
+    collect(ctx.heap, &ctx.prog.aris, ctx.tid, load_arg(ctx.heap, ctx.term, 0));
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 1);
+    let done = make_buffer(ctx.heap, ctx.tid, BUFFER_BYTES, text.into_bytes());
+    link(ctx.heap, *ctx.host, done);
+    return true;
+  }
+  return false;
+}
+
+// Buffer.length (buff: Buffer) -> U60
+// -----------------------------------
+// The number of elements: bytes, or numbers of an array
+
+#[inline(always)]
+pub fn buffer_length_visit(ctx: ReduceCtx) -> bool {
+  return fun::visit(ctx, &[0]);
+}
+
+#[inline(always)]
+pub fn buffer_length_apply(ctx: ReduceCtx) -> bool {
+  let arg0 = load_arg(ctx.heap, ctx.term, 0);
+  if get_tag(arg0) == SUP {
+    fun::superpose(ctx.heap, &ctx.prog.aris, ctx.tid, *ctx.host, ctx.term, arg0, 0);
+    return true;
+  }
+  if get_tag(arg0) == BUF {
+    inc_cost(ctx.heap, ctx.tid);
+    let done = U6O(get_buffer_size(ctx.heap, arg0));
+    link(ctx.heap, *ctx.host, done);
+    free_buffer(ctx.heap, ctx.tid, arg0);
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 1);
+    return true;
+  }
+  return false;
+}
+
+// Buffer.get (buff: Buffer) (index: U60) -> U60
+// ---------------------------------------------
+// The element at `index`, or 0 past the end
+
+#[inline(always)]
+pub fn buffer_get_visit(ctx: ReduceCtx) -> bool {
+  return fun::visit(ctx, &[0, 1]);
+}
+
+#[inline(always)]
+pub fn buffer_get_apply(ctx: ReduceCtx) -> bool {
+  let arg0 = load_arg(ctx.heap, ctx.term, 0);
+  let arg1 = load_arg(ctx.heap, ctx.term, 1);
+  if get_tag(arg0) == SUP {
+    fun::superpose(ctx.heap, &ctx.prog.aris, ctx.tid, *ctx.host, ctx.term, arg0, 0);
+    return true;
+  }
+  if get_tag(arg1) == SUP {
+    fun::superpose(ctx.heap, &ctx.prog.aris, ctx.tid, *ctx.host, ctx.term, arg1, 1);
+    return true;
+  }
+  if get_tag(arg0) == BUF && get_tag(arg1) == U60 {
+    inc_cost(ctx.heap, ctx.tid);
+    let done = get_buffer_elem(ctx.heap, arg0, get_num(arg1)).unwrap_or(U6O(0));
+    link(ctx.heap, *ctx.host, done);
+    free_buffer(ctx.heap, ctx.tid, arg0);
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 2);
+    return true;
+  }
+  return false;
+}
+
+// Buffer.slice (buff: Buffer) (init: U60) (size: U60) -> Buffer
+// -------------------------------------------------------------
+// The `size` elements from the `init`th, clamped to the buffer's bounds. Shares the bytes.
+
+#[inline(always)]
+pub fn buffer_slice_visit(ctx: ReduceCtx) -> bool {
+  return fun::visit(ctx, &[0, 1, 2]);
+}
+
+#[inline(always)]
+pub fn buffer_slice_apply(ctx: ReduceCtx) -> bool {
+  let arg0 = load_arg(ctx.heap, ctx.term, 0);
+  let arg1 = load_arg(ctx.heap, ctx.term, 1);
+  let arg2 = load_arg(ctx.heap, ctx.term, 2);
+  for (i, arg) in [arg0, arg1, arg2].iter().enumerate() {
+    if get_tag(*arg) == SUP {
+      fun::superpose(ctx.heap, &ctx.prog.aris, ctx.tid, *ctx.host, ctx.term, *arg, i as u64);
+      return true;
+    }
+  }
+  if get_tag(arg0) == BUF && get_tag(arg1) == U60 && get_tag(arg2) == U60 {
+    inc_cost(ctx.heap, ctx.tid);
+    slice_buffer(ctx.heap, arg0, get_num(arg1), get_num(arg2));
+    link(ctx.heap, *ctx.host, arg0);
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 3);
+    return true;
+  }
+  return false;
+}
+
+// Array.pack (list: (List U60)) -> Array
+// ---------------------------------------
+// An array of the list's numbers, which must all be U60s or all F60s
+
+fn array_pack_visit(ctx: ReduceCtx) -> bool {
+  return false;
+}
+
+fn array_pack_apply(ctx: ReduceCtx) -> bool {
+  if let Some((tag, elems)) = crate::language::readback::as_numbers(ctx.heap, ctx.prog, &[ctx.tid], get_loc(ctx.term, 0)) {
+    inc_cost(ctx.heap, ctx.tid);
+    collect(ctx.heap, &ctx.prog.aris, ctx.tid, load_arg(ctx.heap, ctx.term, 0));
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 1);
+    let kind = if tag == F60 { BUFFER_F60 } else { BUFFER_U60 };
+    let done = make_buffer(ctx.heap, ctx.tid, kind, array_bytes(&elems));
+    link(ctx.heap, *ctx.host, done);
+    return true;
+  }
+  return false;
+}
+
+// Array.new (size: U60) (value: U60) -> Array
+// -------------------------------------------
+// An array of `size` copies of `value`, which can also be an F60
+
+#[inline(always)]
+pub fn array_new_visit(ctx: ReduceCtx) -> bool {
+  return fun::visit(ctx, &[0, 1]);
+}
+
+#[inline(always)]
+pub fn array_new_apply(ctx: ReduceCtx) -> bool {
+  let arg0 = load_arg(ctx.heap, ctx.term, 0);
+  let arg1 = load_arg(ctx.heap, ctx.term, 1);
+  for (i, arg) in [arg0, arg1].iter().enumerate() {
+    if get_tag(*arg) == SUP {
+      fun::superpose(ctx.heap, &ctx.prog.aris, ctx.tid, *ctx.host, ctx.term, *arg, i as u64);
+      return true;
+    }
+  }
+  if get_tag(arg0) == U60 && (get_tag(arg1) == U60 || get_tag(arg1) == F60) {
+    inc_cost(ctx.heap, ctx.tid);
+    let kind = if get_tag(arg1) == F60 { BUFFER_F60 } else { BUFFER_U60 };
+    let done = make_buffer(ctx.heap, ctx.tid, kind, array_bytes(&vec![get_num(arg1); get_num(arg0) as usize]));
+    link(ctx.heap, *ctx.host, done);
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 2);
+    return true;
+  }
+  return false;
+}
+
+// The tag of an array's elements, if `term` is one
+fn array_tag(term: Ptr) -> Option<u64> {
+  if get_tag(term) == BUF {
+    match get_buffer_kind(term) {
+      BUFFER_U60 => { return Some(U60); }
+      BUFFER_F60 => { return Some(F60); }
+      _ => {}
+    }
+  }
+  return None;
+}
+
+// Array.map (f: U60 -> U60) (xs: Array) -> Array
+// ----------------------------------------------
+// Applies `f` to each element. `f` must be an operator lambda, like `λx (* x 2)`, whose operands
+// are `x` or numbers of the elements' type (see `get_array_oper`); other functions don't reduce.
+
+#[inline(always)]
+pub fn array_map_visit(ctx: ReduceCtx) -> bool {
+  return fun::visit(ctx, &[0, 1]);
+}
+
+#[inline(always)]
+pub fn array_map_apply(ctx: ReduceCtx) -> bool {
+  let arg0 = load_arg(ctx.heap, ctx.term, 0);
+  let arg1 = load_arg(ctx.heap, ctx.term, 1);
+  for (i, arg) in [arg0, arg1].iter().enumerate() {
+    if get_tag(*arg) == SUP {
+      fun::superpose(ctx.heap, &ctx.prog.aris, ctx.tid, *ctx.host, ctx.term, *arg, i as u64);
+      return true;
+    }
+  }
+  if let Some(tag) = array_tag(arg1) {
+    if let Some((oper, args)) = get_array_oper(ctx.heap, ctx.prog, ctx.tid, get_loc(ctx.term, 0), 1, tag) {
+      inc_cost(ctx.heap, ctx.tid);
+      let kind = get_buffer_kind(arg1);
+      let xs = get_buffer_bytes(ctx.heap, arg1);
+      let [a, b] = args.map(|arg| match arg { OperArg::Var(_) => Operand::Elems(xs), OperArg::Num(n) => Operand::Num(n) });
+      let done = make_buffer(ctx.heap, ctx.tid, kind, array_zip(kind, oper, a, b, xs.len() / 8));
+      link(ctx.heap, *ctx.host, done);
+      collect(ctx.heap, &ctx.prog.aris, ctx.tid, load_arg(ctx.heap, ctx.term, 0));
+      free_buffer(ctx.heap, ctx.tid, arg1);
+      free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 2);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Array.zip (f: U60 -> U60 -> U60) (xs: Array) (ys: Array) -> Array
+// -----------------------------------------------------------------
+// Applies `f` to each pair of elements, up to the shortest array's length. `f` must be an
+// operator lambda, like `λx λy (+ x y)`, as on `Array.map`. Both arrays must have the same type.
+
+#[inline(always)]
+pub fn array_zip_visit(ctx: ReduceCtx) -> bool {
+  return fun::visit(ctx, &[0, 1, 2]);
+}
+
+#[inline(always)]
+pub fn array_zip_apply(ctx: ReduceCtx) -> bool {
+  let arg0 = load_arg(ctx.heap, ctx.term, 0);
+  let arg1 = load_arg(ctx.heap, ctx.term, 1);
+  let arg2 = load_arg(ctx.heap, ctx.term, 2);
+  for (i, arg) in [arg0, arg1, arg2].iter().enumerate() {
+    if get_tag(*arg) == SUP {
+      fun::superpose(ctx.heap, &ctx.prog.aris, ctx.tid, *ctx.host, ctx.term, *arg, i as u64);
+      return true;
+    }
+  }
+  if let (Some(tag), Some(ys_tag)) = (array_tag(arg1), array_tag(arg2)) {
+    if tag == ys_tag {
+      if let Some((oper, args)) = get_array_oper(ctx.heap, ctx.prog, ctx.tid, get_loc(ctx.term, 0), 2, tag) {
+        inc_cost(ctx.heap, ctx.tid);
+        let kind = get_buffer_kind(arg1);
+        let xs = get_buffer_bytes(ctx.heap, arg1);
+        let ys = get_buffer_bytes(ctx.heap, arg2);
+        let size = std::cmp::min(xs.len(), ys.len()) / 8;
+        let [a, b] = args.map(|arg| match arg {
+          OperArg::Var(0) => Operand::Elems(xs),
+          OperArg::Var(_) => Operand::Elems(ys),
+          OperArg::Num(n) => Operand::Num(n),
+        });
+        let done = make_buffer(ctx.heap, ctx.tid, kind, array_zip(kind, oper, a, b, size));
         link(ctx.heap, *ctx.host, done);
+        collect(ctx.heap, &ctx.prog.aris, ctx.tid, load_arg(ctx.heap, ctx.term, 0));
+        free_buffer(ctx.heap, ctx.tid, arg1);
+        free_buffer(ctx.heap, ctx.tid, arg2);
+        free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 3);
         return true;
       }
     }
   }
-  println!("Runtime failure on: {}", show_at(ctx.heap, ctx.prog, *ctx.host, &[]));
-  std::process::exit(0);
+  return false;
+}
+
+// Array.fold (f: U60 -> U60 -> U60) (init: U60) (xs: Array) -> U60
+// -----------------------------------------------------------------
+// Folds the elements from the left, starting with `init`. `f` must be `λacc λx (op acc x)`, or
+// `λacc λx (op x acc)`, for any operator.
+
+#[inline(always)]
+pub fn array_fold_visit(ctx: ReduceCtx) -> bool {
+  return fun::visit(ctx, &[0, 1, 2]);
+}
+
+#[inline(always)]
+pub fn array_fold_apply(ctx: ReduceCtx) -> bool {
+  let arg0 = load_arg(ctx.heap, ctx.term, 0);
+  let arg1 = load_arg(ctx.heap, ctx.term, 1);
+  let arg2 = load_arg(ctx.heap, ctx.term, 2);
+  for (i, arg) in [arg0, arg1, arg2].iter().enumerate() {
+    if get_tag(*arg) == SUP {
+      fun::superpose(ctx.heap, &ctx.prog.aris, ctx.tid, *ctx.host, ctx.term, *arg, i as u64);
+      return true;
+    }
+  }
+  if let Some(tag) = array_tag(arg2) {
+    if get_tag(arg1) == tag {
+      let flip = match get_array_oper(ctx.heap, ctx.prog, ctx.tid, get_loc(ctx.term, 0), 2, tag) {
+        Some((oper, [OperArg::Var(0), OperArg::Var(1)])) => Some((oper, false)),
+        Some((oper, [OperArg::Var(1), OperArg::Var(0)])) => Some((oper, true)),
+        _ => None,
+      };
+      if let Some((oper, flip)) = flip {
+        inc_cost(ctx.heap, ctx.tid);
+        let numb = array_fold(get_buffer_kind(arg2), oper, get_num(arg1), get_buffer_bytes(ctx.heap, arg2), flip);
+        let done = if tag == F60 { F6O(numb) } else { U6O(numb) };
+        link(ctx.heap, *ctx.host, done);
+        collect(ctx.heap, &ctx.prog.aris, ctx.tid, load_arg(ctx.heap, ctx.term, 0));
+        free_buffer(ctx.heap, ctx.tid, arg2);
+        free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 3);
+        return true;
+      }
+    }
+  }
+  return false;
 }
 
 //[[CODEGEN:PRECOMP-FNS]]//
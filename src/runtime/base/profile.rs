@@ -0,0 +1,144 @@
+// Profile
+// -------
+// Opt-in counters, kept per thread so that recording them doesn't cause contention. When the
+// heap's `prof` is None, which is the default, every counting function is a single branch.
+// - kind: rewrites per rule kind, and scheduler/allocator events
+// - rule: rewrites per (interpreted function, rule index), for the first PROF_MAX_FUNS ids and
+//   PROF_MAX_RULES rules of each; the others go to PROF_FUN_OTHER
+// Functions compiled to Rust only count towards the global cost.
+
+use crate::runtime::{*};
+use crossbeam::utils::{CachePadded};
+use std::sync::atomic::{AtomicU64, Ordering};
+
+pub const PROF_APP_LAM      : usize = 0;
+pub const PROF_APP_SUP      : usize = 1;
+pub const PROF_OP2_U60      : usize = 2;
+pub const PROF_OP2_F60      : usize = 3;
+pub const PROF_OP2_SUP_0    : usize = 4;
+pub const PROF_OP2_SUP_1    : usize = 5;
+pub const PROF_DUP_LAM      : usize = 6;
+pub const PROF_DUP_SUP_EQ   : usize = 7;
+pub const PROF_DUP_SUP_NE   : usize = 8;
+pub const PROF_DUP_U60      : usize = 9;
+pub const PROF_DUP_F60      : usize = 10;
+pub const PROF_DUP_BUF      : usize = 11;
+pub const PROF_DUP_CTR      : usize = 12;
+pub const PROF_DUP_ERA      : usize = 13;
+pub const PROF_FUN_SUP      : usize = 14;
+pub const PROF_FUN_CTR      : usize = 15;
+pub const PROF_FUN_OTHER    : usize = 16;
+pub const PROF_STEAL_TRY    : usize = 17; // calls to steal a victim's visits
+pub const PROF_STEAL_OK     : usize = 18; // successful steals
+pub const PROF_STEAL_NANOS  : usize = 19; // time spent without work, stealing or parked
+pub const PROF_DELAY        : usize = 20; // visits delayed because their dup was locked
+pub const PROF_LOCK_FAIL    : usize = 21; // failed `acquire_lock` calls
+pub const PROF_ALLOC        : usize = 22; // calls to `alloc`
+pub const PROF_ALLOC_REUSE  : usize = 23; // allocations served by a free list
+pub const PROF_ALLOC_SCAN   : usize = 24; // cells visited by the scanning allocator
+pub const PROF_KINDS        : usize = 25;
+
+pub const PROF_NAMES : [&str; PROF_KINDS] = [
+  "APP-LAM", "APP-SUP", "OP2-U60", "OP2-F60", "OP2-SUP-0", "OP2-SUP-1",
+  "DUP-LAM", "DUP-SUP-EQ", "DUP-SUP-NE", "DUP-U60", "DUP-F60", "DUP-BUF", "DUP-CTR", "DUP-ERA",
+  "FUN-SUP", "FUN-CTR", "FUN-OTHER",
+  "steal_try", "steal_ok", "steal_nanos", "delay", "lock_fail",
+  "alloc", "alloc_reuse", "alloc_scan",
+];
+
+pub const PROF_MAX_FUNS  : usize = 1 << 12;
+pub const PROF_MAX_RULES : usize = 1 << 4;
+
+pub struct ProfVars {
+  pub kind: [AtomicU64; PROF_KINDS],
+  pub rule: Box<[AtomicU64]>,
+}
+
+pub fn new_prof(tids: usize) -> Box<[CachePadded<ProfVars>]> {
+  return (0 .. tids).map(|_| CachePadded::new(ProfVars {
+    kind: std::array::from_fn(|_| AtomicU64::new(0)),
+    rule: new_atomic_u64_array(PROF_MAX_FUNS * PROF_MAX_RULES),
+  })).collect::<Vec<CachePadded<ProfVars>>>().into_boxed_slice();
+}
+
+#[inline(always)]
+pub fn prof_inc(heap: &Heap, tid: usize, kind: usize, count: u64) {
+  if let Some(prof) = &heap.prof {
+    unsafe { *prof.get_unchecked(tid).kind.get_unchecked(kind).as_mut_ptr() += count };
+  }
+}
+
+// Counts a match of the `rule`-th rule of function `fid`
+#[inline(always)]
+pub fn prof_rule(heap: &Heap, tid: usize, fid: u64, rule: usize) {
+  if let Some(prof) = &heap.prof {
+    let fid = fid as usize;
+    let prof = unsafe { prof.get_unchecked(tid) };
+    if fid < PROF_MAX_FUNS && rule < PROF_MAX_RULES {
+      unsafe { *prof.rule.get_unchecked(fid * PROF_MAX_RULES + rule).as_mut_ptr() += 1 };
+    } else {
+      unsafe { *prof.kind.get_unchecked(PROF_FUN_OTHER).as_mut_ptr() += 1 };
+    }
+  }
+}
+
+// Adds the time since a thread ran out of work, if it did
+#[inline(always)]
+pub fn prof_idle(heap: &Heap, tid: usize, idle: &mut Option<instant::Instant>) {
+  if let Some(init) = idle.take() {
+    prof_inc(heap, tid, PROF_STEAL_NANOS, init.elapsed().as_nanos() as u64);
+  }
+}
+
+// Increments the rewrite count, attributing the rewrite to a rule kind when profiling
+#[inline(always)]
+pub fn inc_rule_cost(heap: &Heap, tid: usize, kind: usize) {
+  inc_cost(heap, tid);
+  prof_inc(heap, tid, kind, 1);
+}
+
+// The counters as JSON: totals, per thread, and per function rule (with `prog`'s names)
+pub fn show_profile(heap: &Heap, prog: &Program) -> String {
+  let prof = match &heap.prof {
+    Some(prof) => prof,
+    None => {
+      return "null".to_string();
+    }
+  };
+  fn show_kinds(vals: &[u64]) -> String {
+    let vals = PROF_NAMES.iter().zip(vals).map(|(name, val)| format!("\"{}\": {}", name, val)).collect::<Vec<String>>();
+    return format!("{{{}}}", vals.join(", "));
+  }
+  let mut total = vec![0; PROF_KINDS];
+  let mut threads = vec![];
+  for vars in prof.iter() {
+    let vals = vars.kind.iter().map(|x| x.load(Ordering::Relaxed)).collect::<Vec<u64>>();
+    for (kind, val) in vals.iter().enumerate() {
+      total[kind] += val;
+    }
+    threads.push(format!("    {}", show_kinds(&vals)));
+  }
+  let mut rules = vec![];
+  for fid in 0 .. PROF_MAX_FUNS {
+    for rule in 0 .. PROF_MAX_RULES {
+      let count = prof.iter().map(|x| x.rule[fid * PROF_MAX_RULES + rule].load(Ordering::Relaxed)).sum::<u64>();
+      if count > 0 {
+        let name = prog.nams.get(&(fid as u64)).cloned().unwrap_or_else(|| format!("#{}", fid));
+        let name = name.replace('\\', "\\\\").replace('"', "\\\"");
+        rules.push(format!("    {{\"function\": \"{}\", \"rule\": {}, \"count\": {}}}", name, rule, count));
+      }
+    }
+  }
+  let mut text = String::new();
+  text.push_str("{\n");
+  text.push_str(&format!("  \"cost\": {},\n", get_cost(heap)));
+  text.push_str(&format!("  \"total\": {},\n", show_kinds(&total)));
+  if let Some(gc) = &heap.gc {
+    text.push_str(&format!("  \"gc\": {{\"runs\": {}, \"freed\": {}}},\n", gc.runs.load(Ordering::Relaxed), gc.freed.load(Ordering::Relaxed)));
+  }
+  text.push_str(&format!("  \"labels\": {{\"batches\": {}, \"free\": {}}},\n", heap.labs.get_next() - 1, heap.labs.get_free()));
+  text.push_str(&format!("  \"threads\": [\n{}\n  ],\n", threads.join(",\n")));
+  text.push_str(&format!("  \"rules\": [\n{}\n  ]\n", rules.join(",\n")));
+  text.push_str("}");
+  return text;
+}
@@ -29,6 +29,7 @@ pub struct Rule {
   pub core: Core,
   pub body: RuleBody,
   pub free: Vec<(u64, u64)>,
+  pub reuse: Vec<(u64, u64)>,
 }
 
 // A rule left-hand side variable
@@ -39,10 +40,42 @@ pub struct RuleVar {
   pub erase: bool,
 }
 
-// The rule right-hand side body (TODO: can the RuleBodyNode Vec be unboxed?)
-pub type RuleBody = (RuleBodyCell, Vec<RuleBodyNode>, u64);
+// The rule right-hand side body. Its nodes are flattened into a single cell array, so that the
+// whole body can be allocated at once (see `place_nodes`) and written in one pass.
+#[derive(Clone, Debug)]
+pub struct RuleBody {
+  pub root: RuleBodyCell,       // the body's root, which is linked to the host
+  pub cells: Vec<RuleBodyCell>, // the cells of every node, in order
+  pub nodes: Vec<u64>,          // where each node starts on `cells`, then the total size
+  pub dupk: u64,                // the number of dup labels it uses
+}
+
+impl RuleBody {
+  pub fn new(root: RuleBodyCell, nodes: Vec<RuleBodyNode>, dupk: u64) -> RuleBody {
+    let mut starts = vec![0];
+    for node in &nodes {
+      starts.push(starts[starts.len() - 1] + node.len() as u64);
+    }
+    return RuleBody { root, cells: nodes.concat(), nodes: starts, dupk };
+  }
+
+  #[inline(always)]
+  pub fn node_count(&self) -> usize {
+    return self.nodes.len() - 1;
+  }
+
+  #[inline(always)]
+  pub fn node_size(&self, node: usize) -> u64 {
+    return unsafe { *self.nodes.get_unchecked(node + 1) - *self.nodes.get_unchecked(node) };
+  }
+
+  #[inline(always)]
+  pub fn node(&self, node: usize) -> &[RuleBodyCell] {
+    return unsafe { self.cells.get_unchecked(*self.nodes.get_unchecked(node) as usize .. *self.nodes.get_unchecked(node + 1) as usize) };
+  }
+}
 
-// A body node
+// A body node, while the body is built
 pub type RuleBodyNode = Vec<RuleBodyCell>;
 
 // A body cell
@@ -63,6 +96,21 @@ pub struct VisitObj {
 
 pub struct ApplyObj {
   pub rules: Vec<Rule>,
+  pub tree: Option<Vec<MatchNode>>,
+  pub jit: Option<JitCode>, // set by `jit_program`
+  pub memo: bool, // whether its calls share a single value (see `gen_memo_functions`)
+}
+
+// A node of a function's match tree, which finds the first rule matching a call by switching on
+// its strict arguments, one at a time, instead of testing every rule. The nodes are kept in a Vec,
+// with the root at 0.
+#[derive(Clone, Debug)]
+pub enum MatchNode {
+  // Switches on argument `arg`: if it is a CTR, U60 or F60, goes to the case whose key is its
+  // `match_key`, or to `other` if there is none. Otherwise, no rule matches.
+  Switch { arg: u64, cases: Vec<(Ptr, usize)>, other: usize },
+  // All strict arguments were tested; the first remaining rule, if any, matches
+  Leaf { rule: Option<usize> },
 }
 
 pub enum Function {
@@ -111,7 +159,11 @@ impl Program {
   }
 
   pub fn add_book(&mut self, book: &language::rulebook::RuleBook) {
-    let funs : &mut Funs = &mut gen_functions(&book);
+    self.add_book_with(book, gen_functions(&book));
+  }
+
+  // Like `add_book`, with the book's functions already built (see `load_book`)
+  pub fn add_book_with(&mut self, book: &language::rulebook::RuleBook, mut funs: Funs) {
     let nams : &mut Nams = &mut gen_names(&book);
     let aris : &mut Aris = &mut U64Map::new();
     for (fid, fun) in funs.data.drain(0..).enumerate() {
@@ -144,15 +196,90 @@ pub fn get_var(heap: &Heap, term: Ptr, var: &RuleVar) -> Ptr {
 }
 
 pub fn alloc_body(heap: &Heap, prog: &Program, tid: usize, term: Ptr, vars: &[RuleVar], body: &RuleBody) -> Ptr {
+  unsafe {
+    place_nodes(heap, tid, body, &[], |_| 0);
+    return write_body(heap, tid, body, |index| get_var(heap, term, vars.get_unchecked(index as usize)));
+  }
+}
+
+// Allocates the right-hand side of a rule that matched `term`, writing the nodes on `rule.reuse`
+// over the matched constructors (or the call itself) instead of allocating them, and freeing the
+// matched nodes that weren't reused. Since that overwrites the left-hand side, every variable is
+// taken first; they're kept on `aloc`, after the body's nodes (see `get_rule_var`).
+#[inline(always)]
+pub fn alloc_rule_body(heap: &Heap, prog: &Program, tid: usize, term: Ptr, rule: &Rule) -> Ptr {
+  unsafe {
+    let aloc = &heap.aloc[tid];
+    let size = rule.body.node_count();
+    for (index, var) in rule.vars.iter().enumerate() {
+      *aloc.get_unchecked(size + index).as_mut_ptr() = get_var(heap, term, var);
+    }
+    // A source is the `s`-th matched constructor on `rule.free`, or the call when `s` is its length
+    let source = |s: u64| -> u64 {
+      match rule.free.get(s as usize) {
+        Some((param, _)) => get_loc(load_arg(heap, term, *param), 0),
+        None => get_loc(term, 0),
+      }
+    };
+    place_nodes(heap, tid, &rule.body, &rule.reuse, source);
+    for s in 0 ..= rule.free.len() as u64 {
+      if !rule.reuse.iter().any(|(_, used)| *used == s) {
+        let arity = match rule.free.get(s as usize) { Some((_, arity)) => *arity, None => rule.cond.len() as u64 };
+        free(heap, tid, source(s), arity);
+      }
+    }
+    return write_body(heap, tid, &rule.body, |index| *aloc.get_unchecked(size + index as usize).as_mut_ptr());
+  }
+}
+
+// The value of the `index`-th variable of a rule, after `alloc_rule_body`
+#[inline(always)]
+pub fn get_rule_var(heap: &Heap, tid: usize, rule: &Rule, index: usize) -> Ptr {
+  return unsafe { *heap.aloc[tid].get_unchecked(rule.body.node_count() + index).as_mut_ptr() };
+}
+
+// With the arena allocator, bodies up to this size are allocated as a single block, since that is
+// one bump instead of one per node. It is kept within a page, which is the largest block the arena
+// can hand out.
+pub const BODY_BLOCK_MAX : u64 = PAGE_SIZE as u64;
+
+// Writes the location of each node of a body to `aloc`. The nodes on `reuse` go to the location
+// of their source. With the arena allocator, the others are allocated together, as one block, and
+// freed separately later. The scanning allocator allocates them one by one instead: its free lists
+// hold nodes by size, so a block would rarely be found on them, and it would have to be scanned.
+#[inline(always)]
+pub fn place_nodes(heap: &Heap, tid: usize, body: &RuleBody, reuse: &[(u64, u64)], source: impl Fn(u64) -> u64) {
+  unsafe {
+    let aloc = &heap.aloc[tid];
+    let mut size = body.cells.len() as u64;
+    for (node, _) in reuse {
+      size -= body.node_size(*node as usize);
+    }
+    let block = heap.arena.is_some() && size <= BODY_BLOCK_MAX;
+    let mut next = if block { alloc(heap, tid, size) } else { 0 };
+    let mut reuse = reuse.iter().peekable();
+    for i in 0 .. body.node_count() {
+      *aloc.get_unchecked(i).as_mut_ptr() = match reuse.next_if(|(node, _)| *node == i as u64) {
+        Some((_, s)) => source(*s),
+        None if block => { next += body.node_size(i); next - body.node_size(i) }
+        None => alloc(heap, tid, body.node_size(i)),
+      };
+    }
+  }
+}
+
+// Fills the cells of a body whose nodes are on `aloc`, returning its root
+#[inline(always)]
+fn write_body(heap: &Heap, tid: usize, body: &RuleBody, var: impl Fn(u64) -> Ptr) -> Ptr {
   //#[inline(always)]
-  fn cell_to_ptr(heap: &Heap, lvar: &LocalVars, aloc: &[AtomicU64], term: Ptr, vars: &[RuleVar], cell: &RuleBodyCell) -> Ptr {
+  fn cell_to_ptr(lvar: &LocalVars, aloc: &[AtomicU64], var: &impl Fn(u64) -> Ptr, cell: &RuleBodyCell) -> Ptr {
     unsafe {
       match cell {
         RuleBodyCell::Val { value } => {
           *value
         },
         RuleBodyCell::Var { index } => {
-          get_var(heap, term, vars.get_unchecked(*index as usize))
+          var(*index)
         },
         RuleBodyCell::Ptr { value, targ, slot } => {
           let mut val = value + *aloc.get_unchecked(*targ as usize).as_mut_ptr() + slot;
@@ -167,20 +294,17 @@ pub fn alloc_body(heap: &Heap, prog: &Program, tid: usize, term: Ptr, vars: &[Ru
   }
   // FIXME: verify the use of get_unchecked
   unsafe {
-    let (cell, nodes, dupk) = body;
+    let RuleBody { root, dupk, .. } = body;
     let aloc = &heap.aloc[tid];
     let lvar = &heap.lvar[tid];
-    for i in 0 .. nodes.len() {
-      *aloc.get_unchecked(i).as_mut_ptr() = alloc(heap, tid, (*nodes.get_unchecked(i)).len() as u64);
-    };
-    if *lvar.dups.as_mut_ptr() + dupk >= (1 << 28) {
-      *lvar.dups.as_mut_ptr() = 0;
+    if *lvar.dups.as_mut_ptr() + dupk > *lvar.dmax.as_mut_ptr() {
+      take_labels(heap, tid, *dupk);
     }
-    for i in 0 .. nodes.len() {
+    // A single pass over the cells, which are contiguous, node by node
+    for i in 0 .. body.node_count() {
       let host = *aloc.get_unchecked(i).as_mut_ptr() as usize;
-      for j in 0 .. (*nodes.get_unchecked(i)).len() {
-        let cell = (*nodes.get_unchecked(i)).get_unchecked(j);
-        let ptr = cell_to_ptr(heap, lvar, aloc, term, vars, cell);
+      for (j, cell) in body.node(i).iter().enumerate() {
+        let ptr = cell_to_ptr(lvar, aloc, &var, cell);
         if let RuleBodyCell::Var { .. } = cell {
           link(heap, (host + j) as u64, ptr);
         } else {
@@ -188,13 +312,28 @@ pub fn alloc_body(heap: &Heap, prog: &Program, tid: usize, term: Ptr, vars: &[Ru
         }
       }
     }
-    let done = cell_to_ptr(heap, lvar, aloc, term, vars, cell);
+    let done = cell_to_ptr(lvar, aloc, &var, root);
     *lvar.dups.as_mut_ptr() += dupk;
     //println!("result: {}\n{}\n", show_ptr(done), show_term(heap, prog, done, 0));
     return done;
   }
 }
 
+// Pairs each matched node of a rule (see `alloc_rule_body`) with the first node of its body that
+// has the same size, in order. `free` are the matched constructors and `arity` is the call's.
+pub fn build_reuse(free: &[(u64, u64)], arity: u64, body: &RuleBody) -> Vec<(u64, u64)> {
+  let mut sizes = free.iter().map(|(_, arity)| Some(*arity)).collect::<Vec<Option<u64>>>();
+  sizes.push(Some(arity));
+  let mut reuse = vec![];
+  for node in 0 .. body.node_count() {
+    if let Some(s) = sizes.iter().position(|size| *size == Some(body.node_size(node))) {
+      sizes[s] = None;
+      reuse.push((node as u64, s as u64));
+    }
+  }
+  return reuse;
+}
+
 pub fn get_global_name_misc(name: &str) -> Option<u64> {
   if !name.is_empty() && name.starts_with(&"$") {
     if name.starts_with(&"$0") {
@@ -209,7 +348,7 @@ pub fn get_global_name_misc(name: &str) -> Option<u64> {
 }
 
 // todo: "dups" still needs to be moved out on `alloc_body` etc.
-pub fn build_function(book: &language::rulebook::RuleBook, fn_name: &str, rules: &[language::syntax::Rule]) -> Function {
+pub fn build_function(book: &language::rulebook::RuleBook, fn_name: &str, rules: &[language::syntax::Rule], memo: bool) -> Function {
   let hoas = fn_name.starts_with("F$");
   let dynrules = rules.iter().filter_map(|rule| {
     if let language::syntax::Term::Ctr { ref name, ref args } = *rule.lhs {
@@ -250,12 +389,13 @@ pub fn build_function(book: &language::rulebook::RuleBook, fn_name: &str, rules:
 
       let core = term_to_core(book, &rule.rhs, &inps);
       let body = build_body(&core, vars.len() as u64);
+      let reuse = build_reuse(&free, args.len() as u64, &body);
 
-      Some(Rule { hoas, cond, vars, core, body, free })
+      Some(Rule { hoas, cond, vars, core, body, free, reuse })
     } else {
       None
     }
-  }).collect();
+  }).collect::<Vec<Rule>>();
 
   let fnid = book.name_to_id.get(fn_name).unwrap();
   let smap = book.id_to_smap.get(fnid).unwrap().clone().into_boxed_slice();
@@ -268,13 +408,69 @@ pub fn build_function(book: &language::rulebook::RuleBook, fn_name: &str, rules:
     }
   }
 
+  let tree = build_match_tree(&dynrules, &strict_idx);
+
   Function::Interpreted {
     smap,
     visit: VisitObj { strict_map, strict_idx },
-    apply: ApplyObj { rules: dynrules },
+    apply: ApplyObj { rules: dynrules, tree, jit: None, memo },
+  }
+}
+
+// Match Trees
+// -----------
+
+// Trees larger than this are dropped, and the function matches its rules one by one instead
+pub const MATCH_TREE_MAX_NODES : usize = 1 << 12;
+
+// The key of an argument on a `MatchNode::Switch`: its tag and constructor id or number. Also
+// computed for the `cond` of a rule, so that both are compared the same way `match_rules` does.
+#[inline(always)]
+pub fn match_key(arg: Ptr) -> Ptr {
+  match get_tag(arg) {
+    CTR => Ctr(get_ext(arg), 0),
+    U60 => U6O(get_num(arg)),
+    F60 => F6O(get_num(arg)),
+    _   => arg,
   }
 }
 
+// Builds the match tree of a function by testing its strict arguments in order. A case of a switch
+// keeps the rules with that pattern or a variable on the argument, in the original order, and its
+// `other` branch keeps the rules with a variable. Returns None for HOAS functions, whose default
+// variables match differently (see `fun::match_rules`), and for trees over MATCH_TREE_MAX_NODES.
+pub fn build_match_tree(rules: &[Rule], strict_idx: &[u64]) -> Option<Vec<MatchNode>> {
+  fn build(rules: &[Rule], args: &[u64], cand: Vec<usize>, tree: &mut Vec<MatchNode>) -> Option<usize> {
+    if tree.len() >= MATCH_TREE_MAX_NODES {
+      return None;
+    }
+    let node = tree.len();
+    tree.push(MatchNode::Leaf { rule: cand.first().cloned() });
+    if cand.is_empty() || args.is_empty() {
+      return Some(node);
+    }
+    let arg = args[0];
+    let mut keys = cand.iter().map(|r| rules[*r].cond[arg as usize]).filter(|cond| get_tag(*cond) != VAR).map(match_key).collect::<Vec<Ptr>>();
+    keys.sort();
+    keys.dedup();
+    let mut cases = vec![];
+    for key in keys {
+      let case = cand.iter().cloned().filter(|r| { let cond = rules[*r].cond[arg as usize]; get_tag(cond) == VAR || match_key(cond) == key }).collect();
+      cases.push((key, build(rules, &args[1 ..], case, tree)?));
+    }
+    let other = cand.iter().cloned().filter(|r| get_tag(rules[*r].cond[arg as usize]) == VAR).collect();
+    let other = build(rules, &args[1 ..], other, tree)?;
+    tree[node] = MatchNode::Switch { arg, cases, other };
+    return Some(node);
+  }
+  if rules.iter().any(|rule| rule.hoas) {
+    return None;
+  }
+  let mut tree = vec![];
+  build(rules, strict_idx, (0 .. rules.len()).collect(), &mut tree)?;
+  return Some(tree);
+}
+
 pub fn hash<T: std::hash::Hash>(t: &T) -> u64 {
   use std::hash::Hasher;
   let mut s = std::collections::hash_map::DefaultHasher::new();
@@ -284,9 +480,12 @@ pub fn hash<T: std::hash::Hash>(t: &T) -> u64 {
 
 pub fn gen_functions(book: &language::rulebook::RuleBook) -> U64Map<Function> {
   let mut funs: U64Map<Function> = U64Map::new();
-  for (name, rules_info) in &book.rule_group {
-    let fnid = book.name_to_id.get(name).unwrap_or(&0);
-    let func = build_function(book, &name, &rules_info.1);
+  let memo = gen_memo_functions(book);
+  // Each function is built on its own, so they're built in parallel
+  let groups = book.rule_group.iter().collect::<Vec<_>>();
+  let built = par_map(&groups, |(name, rules_info)| build_function(book, name, &rules_info.1, memo.contains(*name)));
+  for ((name, _), func) in groups.iter().zip(built) {
+    let fnid = book.name_to_id.get(*name).unwrap_or(&0);
     funs.insert(*fnid, func);
   }
   funs
@@ -296,6 +495,73 @@ pub fn gen_names(book: &language::rulebook::RuleBook) -> U64Map<String> {
   return U64Map::from_hashmap(&mut book.id_to_name.clone());
 }
 
+// Memoized Functions
+// ------------------
+
+// The primitives that perform effects, which a memoized function must never reach
+pub const EFFECT_FUNCTIONS : &[&str] = &["HVM.log", "HVM.query", "HVM.print", "HVM.sleep", "HVM.store", "HVM.load", "HVM.wait"];
+
+// Finds the functions whose calls share a single value (see `fun::memo_call`): those without
+// arguments that some other function calls, and whose rules, and those of every function they can
+// call, make no lambdas, superpositions nor global variables, and perform no effects. Their values
+// are first-order data, which is copied the same whatever the labels of the dups that copy it, so
+// sharing one instance between calls, built once, gives the results fresh instances would. A
+// function only the entry point calls isn't memoized, as nothing would reuse its value.
+pub fn gen_memo_functions(book: &language::rulebook::RuleBook) -> std::collections::HashSet<String> {
+  // Whether a right-hand side makes anything that isn't data, pushing the functions it calls
+  fn scan(book: &language::rulebook::RuleBook, term: &language::syntax::Term, calls: &mut Vec<String>) -> bool {
+    match term {
+      language::syntax::Term::Var { name } => get_global_name_misc(name).is_some(),
+      language::syntax::Term::Dup { nam0, nam1, expr, body } => {
+        get_global_name_misc(nam0).is_some() || get_global_name_misc(nam1).is_some() || scan(book, expr, calls) | scan(book, body, calls)
+      }
+      language::syntax::Term::Sup { .. } => true,
+      language::syntax::Term::Lam { .. } => true,
+      language::syntax::Term::Let { expr, body, .. } => scan(book, expr, calls) | scan(book, body, calls),
+      language::syntax::Term::App { func, argm } => scan(book, func, calls) | scan(book, argm, calls),
+      language::syntax::Term::Ctr { name, args } => {
+        if *book.ctr_is_fun.get(name).unwrap_or(&false) {
+          calls.push(name.clone());
+        }
+        args.iter().fold(false, |bad, arg| scan(book, arg, calls) | bad)
+      }
+      language::syntax::Term::U6O { .. } => false,
+      language::syntax::Term::F6O { .. } => false,
+      language::syntax::Term::Op2 { val0, val1, .. } => scan(book, val0, calls) | scan(book, val1, calls),
+    }
+  }
+  let mut callers : HashMap<String, Vec<String>> = HashMap::new();
+  let mut unsafe_funs = EFFECT_FUNCTIONS.iter().map(|name| name.to_string()).collect::<Vec<String>>();
+  let mut called = std::collections::HashSet::new();
+  for (name, (_, rules)) in &book.rule_group {
+    let mut calls = vec![];
+    let mut bad = name.starts_with("F$");
+    for rule in rules {
+      bad = scan(book, &rule.rhs, &mut calls) || bad;
+    }
+    if bad {
+      unsafe_funs.push(name.clone());
+    }
+    for call in calls {
+      if call != *name && name != "HVM_MAIN_CALL" {
+        called.insert(call.clone());
+      }
+      callers.entry(call).or_default().push(name.clone());
+    }
+  }
+  // A function is unsafe if it calls one that is
+  let mut seen = std::collections::HashSet::new();
+  while let Some(name) = unsafe_funs.pop() {
+    if seen.insert(name.clone()) {
+      unsafe_funs.extend(callers.get(&name).into_iter().flatten().cloned());
+    }
+  }
+  return book.rule_group.keys().filter(|name| {
+    let arity = book.name_to_id.get(*name).and_then(|fid| book.id_to_smap.get(fid)).map_or(0, |smap| smap.len());
+    return arity == 0 && called.contains(*name) && !seen.contains(*name);
+  }).cloned().collect();
+}
+
 /// converts a language term to a runtime term
 pub fn term_to_core(book: &language::rulebook::RuleBook, term: &language::syntax::Term, inps: &[String]) -> Core {
   fn convert_oper(oper: &language::syntax::Oper) -> u64 {
@@ -429,7 +695,7 @@ pub fn build_body(term: &Core, free_vars: u64) -> RuleBody {
       let dupc = *dupk;
       let targ = nodes.len() as u64;
       *dupk += 1;
-      nodes.push(vec![RuleBodyCell::Val { value: 0 }; 3]);
+      nodes.push(vec![RuleBodyCell::Val { value: 0 }, RuleBodyCell::Val { value: 0 }, RuleBodyCell::Val { value: 0 }, RuleBodyCell::Val { value: LOCK_OPEN }]);
       links.push((targ, 0, RuleBodyCell::Val { value: Era() }));
       links.push((targ, 1, RuleBodyCell::Val { value: Era() }));
       if glob != 0 {
@@ -575,7 +841,7 @@ pub fn build_body(term: &Core, free_vars: u64) -> RuleBody {
     link(&mut nodes, targ, slot, elem);
   }
 
-  (elem, nodes, dupk)
+  RuleBody::new(elem, nodes, dupk)
 }
 
 pub fn alloc_closed_core(heap: &Heap, prog: &Program, tid: usize, term: &Core) -> u64 {
@@ -600,3 +866,81 @@ pub fn make_string(heap: &Heap, tid: usize, text: &str) -> Ptr {
   }
   return term;
 }
+
+#[cfg(test)]
+mod tests {
+  use crate::runtime::{*};
+  use crate::runtime::rule::fun::{match_rules, match_tree};
+
+  pub const EXAMPLES : [&str; 9] = [
+    include_str!("../../../examples/bugs/fib_dups.hvm"),
+    include_str!("../../../examples/bugs/fib_loop.hvm"),
+    include_str!("../../../examples/bugs/fib_tups.hvm"),
+    include_str!("../../../examples/bugs/lotto.hvm"),
+    include_str!("../../../examples/lambda/multiplication/main.hvm"),
+    include_str!("../../../examples/sort/bitonic/main.hvm"),
+    include_str!("../../../examples/sort/bubble/main.hvm"),
+    include_str!("../../../examples/sort/quick/main.hvm"),
+    include_str!("../../../examples/sort/radix/main.hvm"),
+  ];
+
+  // Calls to test per function, at most
+  pub const MAX_CALLS : usize = 1 << 12;
+
+  // Calls every function that has a match tree with each combination of the patterns of its rules
+  // on its strict arguments, plus a constructor, a number and a lambda that no rule names, and
+  // checks that the tree finds the same rule as testing them in order
+  #[test]
+  fn test_match_tree_agrees_with_match_rules() {
+    // lotto.hvm nests deeper than the parser fits in a test thread's stack
+    let tested = std::thread::Builder::new().stack_size(1 << 26).spawn(|| {
+      let mut tested = 0;
+      for code in EXAMPLES {
+        let rt = Runtime::from_code_with(code, 1 << 16, 1, false).unwrap();
+        let heap = &rt.heap;
+        let lam = alloc(heap, 0, 2);
+        link(heap, lam, Era());
+        link(heap, lam + 1, U6O(0));
+        let other = vec![Ctr(rt.prog.nams.data.len() as u64 + 1, 0), U6O(u64::MAX >> 8), F6O(7), Lam(lam)];
+        for (fid, fun) in rt.prog.funs.data.iter().enumerate() {
+          if let Some(Function::Interpreted { visit, apply: apply @ ApplyObj { tree: Some(tree), .. }, .. }) = fun {
+            let arity = visit.strict_map.len();
+            // The values tried on each argument
+            let vals = (0 .. arity).map(|i| {
+              if !visit.strict_map[i] {
+                return vec![Era()];
+              }
+              let mut vals = apply.rules.iter().map(|rule| rule.cond[i]).filter(|cond| get_tag(*cond) != VAR).collect::<Vec<Ptr>>();
+              vals.extend(other.iter().cloned());
+              vals.sort();
+              vals.dedup();
+              return vals;
+            }).collect::<Vec<Vec<Ptr>>>();
+            let call = alloc(heap, 0, arity as u64);
+            let term = Fun(fid as u64, call);
+            let mut pick = vec![0; arity];
+            for _ in 0 .. MAX_CALLS {
+              for i in 0 .. arity {
+                link(heap, call + i as u64, vals[i][pick[i]]);
+              }
+              assert_eq!(match_tree(heap, term, tree), match_rules(heap, &rt.prog, term, visit, apply), "{}", rt.get_name(fid as u64));
+              tested += 1;
+              // Moves on to the next combination, if any
+              let mut i = 0;
+              while i < arity && pick[i] + 1 == vals[i].len() {
+                pick[i] = 0;
+                i += 1;
+              }
+              if i == arity {
+                break;
+              }
+              pick[i] += 1;
+            }
+          }
+        }
+      }
+      return tested;
+    }).unwrap().join().unwrap();
+    assert!(tested > 100);
+  }
+}
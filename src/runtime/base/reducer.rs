@@ -1,6 +1,5 @@
 pub use crate::runtime::{*};
 use crossbeam::utils::{Backoff};
-use std::collections::HashSet;
 use std::sync::atomic::{AtomicBool, AtomicUsize, AtomicU64, Ordering};
 
 pub struct ReduceCtx<'a> {
@@ -31,6 +30,8 @@ pub struct ReduceCtx<'a> {
 //     blink { ... }
 //     steal { ... }
 //   }
+// How many visits a reducer does between checks for delayed visits that can be resumed
+pub const DELAY_TICKS : u64 = 1 << 8;
 
 pub fn is_whnf(term: Ptr) -> bool {
   match get_tag(term) {
@@ -40,28 +41,62 @@ pub fn is_whnf(term: Ptr) -> bool {
     CTR => true,
     U60 => true,
     F60 => true,
+    BUF => true,
     _   => false,
   }
 }
 
+thread_local! {
+  // How many reducers this thread is running
+  static REDUCERS: std::cell::Cell<usize> = std::cell::Cell::new(0);
+}
+
+// Whether this thread is running a reducer started by a primitive
+pub fn is_nested() -> bool {
+  return REDUCERS.with(|depth| depth.get() > 1);
+}
+
 pub fn reduce(heap: &Heap, prog: &Program, tids: &[usize], root: u64, full: bool, debug: bool) -> Ptr {
-  // Halting flag
-  let stop = &AtomicUsize::new(1);
+  reduce_roots(heap, prog, tids, &[root], full, debug);
+  return load_ptr(heap, root);
+}
+
+// Reduces many terms at once. Each root is a task of its own, so the threads share them through
+// the usual work stealing, instead of reducing them one after the other.
+pub fn reduce_roots(heap: &Heap, prog: &Program, tids: &[usize], roots: &[u64], full: bool, debug: bool) {
+  // Halting flag, counting the roots left
+  let stop = &AtomicUsize::new(roots.len());
   let barr = &Barrier::new(tids.len());
+  let park = &Park::new();
   let locs = &tids.iter().map(|x| AtomicU64::new(u64::MAX)).collect::<Vec<AtomicU64>>();
+  let safe = &Safepoint::new(tids.len());
 
-  // Spawn a thread for each worker
-  std::thread::scope(|s| {
-    for tid in tids {
-      s.spawn(move || {
-        reducer(heap, prog, tids, stop, barr, locs, root, *tid, full, debug);
-        //println!("[{}] done", tid);
-      });
+  // The collector the reducers stop for: the heap's, or else one that only reclaims the dup labels
+  // once they run low. Only outer reductions stop (see `reducer`), so only they need one.
+  let outer = REDUCERS.with(|depth| depth.get()) == 0;
+  let own = if heap.gc.is_none() && outer && !debug { Some(new_label_collector(heap)) } else { None };
+  let gc = heap.gc.as_ref().or(own.as_ref());
+
+  // Runs a reducer for each worker, on the heap's thread pool. One that panics (on a full redex
+  // bag, for example) makes the others quit, so that the pool can pass the panic on.
+  let work = || heap.pool.run(tids.len(), &|i| {
+    let tid = tids[i];
+    let done = std::panic::catch_unwind(std::panic::AssertUnwindSafe(|| {
+      reducer(heap, prog, tids, stop, barr, park, gc, safe, locs, roots, tid, full, debug);
+    }));
+    if let Err(payload) = done {
+      park.quit();
+      std::panic::resume_unwind(payload);
     }
+    //println!("[{}] done", tids[i]);
   });
 
-  // Return whnf term ptr
-  return load_ptr(heap, root);
+  // Samples it, if telemetry is on; a nested reduction is part of the outer one's samples
+  if outer {
+    sample_while(heap, prog, work);
+  } else {
+    work();
+  }
 }
 
 pub fn reducer(
@@ -70,26 +105,57 @@ pub fn reducer(
   tids: &[usize],
   stop: &AtomicUsize,
   barr: &Barrier,
+  park: &Park,
+  gc: Option<&Collector>,
+  safe: &Safepoint,
   locs: &[AtomicU64],
-  root: u64,
+  roots: &[u64],
   tid: usize,
   full: bool,
   debug: bool,
 ) {
 
+  // A reducer started by a primitive, to read a string for example, runs inside another one on
+  // the same thread. It gets its own visit queue, and doesn't steal, as the visits on the thread's
+  // queues belong to the outer reduction.
+  let nested = REDUCERS.with(|depth| { depth.set(depth.get() + 1); depth.get() > 1 });
+  // Undone on return, or on a panic, after which the pool's thread may run other reductions
+  struct Depth;
+  impl Drop for Depth {
+    fn drop(&mut self) {
+      REDUCERS.with(|depth| depth.set(depth.get() - 1));
+    }
+  }
+  let depth = Depth;
+  let own = if nested { Some(VisitQueue::new()) } else { None };
+
   // State Stacks
   let redex = &heap.rbag;
-  let visit = &heap.vstk[tid];
+  let visit = own.as_ref().unwrap_or(&heap.vstk[tid]);
   let bkoff = &Backoff::new();
+  let vics  = &mut Victims::new(heap.steal, if nested { std::slice::from_ref(&tid) } else { tids }, tid);
+  let mut sleep = PARK_MIN_MICROS;
   let hold  = tids.len() <= 1;
-  let seen  = &mut HashSet::new();
+  let seen  = &mut Vec::new(); // mark words set by this thread
+  let delay = &mut Vec::new();
+  let mut idle = None; // when this thread ran out of work, if profiling
 
-  // State Vars
-  let (mut cont, mut host) = if tid == tids[0] {
-    (REDEX_CONT_RET, root)
-  } else {
-    (0, u64::MAX)
-  };
+  // The tracing collector only stops outer reductions, and not while debugging (see `gc.rs`)
+  let gc = if nested || debug { None } else { gc };
+  let tele = heap.tele.as_ref();
+  let index = tids.iter().position(|x| *x == tid).unwrap_or(0);
+  let mut ticks = 0;
+
+  // State Vars. Each thread starts on the root at its index, and queues those at the same index
+  // modulo the number of threads.
+  let (mut cont, mut host) = (0, u64::MAX);
+  for root in roots.iter().skip(index).step_by(tids.len()).rev() {
+    if host != u64::MAX {
+      visit.push(new_visit(host, hold, cont));
+    }
+    cont = REDEX_CONT_RET;
+    host = *root;
+  }
 
   // Debug Printer
   let print = |tid: usize, host: u64| {
@@ -97,7 +163,7 @@ pub fn reducer(
     locs[tid].store(host, Ordering::SeqCst);
     barr.wait(stop);
     if tid == tids[0] {
-      println!("{}\n----------------", show_at(heap, prog, root, locs));
+      println!("{}\n----------------", show_at(heap, prog, roots[0], locs));
     }
     barr.wait(stop);
   };
@@ -109,11 +175,33 @@ pub fn reducer(
         break 'init;
       }
       'work: loop {
+        ticks += 1;
+        if let Some(gc) = gc {
+          if ticks % GC_TICKS == 0 && should_collect(heap, gc, safe) {
+            park.notify_all();
+            safepoint(heap, prog, gc, safe, index, tid, roots, stop, full);
+          }
+        }
+        // Queues the delayed visits whose dup was released, so that they don't wait for this thread
+        // to run out of work, which may take long when its queue is deep
+        if ticks % DELAY_TICKS == 0 && !delay.is_empty() {
+          let mut i = 0;
+          while i < delay.len() {
+            if is_visit_ready(heap, delay[i]) {
+              visit.push(delay.swap_remove(i));
+            } else {
+              i += 1;
+            }
+          }
+        }
         'visit: loop {
           let term = load_ptr(heap, host);
           if debug {
             print(tid, host);
           }
+          if let Some(tele) = tele {
+            tele.set(tid, host, cont);
+          }
           match get_tag(term) {
             APP => {
               if app::visit(ReduceCtx { heap, prog, tid, hold, term, visit, redex, cont: &mut cont, host: &mut host }) {
@@ -125,7 +213,11 @@ pub fn reducer(
             DP0 | DP1 => {
               match acquire_lock(heap, tid, term) {
                 Err(locker_tid) => {
-                  continue 'work;
+                  // The dup is being reduced elsewhere: delay this visit, so that the work below it
+                  // on our queue (which the lock holder may be waiting for) isn't blocked by a spin
+                  delay.push(new_visit(host, hold, cont));
+                  prof_inc(heap, tid, PROF_DELAY, 1);
+                  break 'work;
                 }
                 Ok(_) => {
                   // If the term changed, release lock and try again
@@ -151,6 +243,14 @@ pub fn reducer(
             }
             FUN | CTR => {
               let fid = get_ext(term);
+              // A task that waits on an effect is parked until it completes (see `park_effect`)
+              if fid == HVM_WAIT {
+                if nested {
+                  heap.io.wait(get_num(load_arg(heap, term, 0)));
+                } else if park_effect(heap, redex, tid, host, cont, term) {
+                  break 'work;
+                }
+              }
 //[[CODEGEN:FAST-VISIT]]//
               match &prog.funs.get(&fid) {
                 Some(Function::Interpreted { smap: fn_smap, visit: fn_visit, apply: fn_apply }) => {
@@ -183,6 +283,9 @@ pub fn reducer(
             if debug {
               print(tid, host);
             }
+            if let Some(tele) = tele {
+              tele.set(tid, host, cont);
+            }
             // Apply rewrite rules
             match get_tag(term) {
               APP => {
@@ -193,8 +296,8 @@ pub fn reducer(
                 }
               }
               DP0 | DP1 => {
+                // A dup that was rewritten was also freed, which releases its lock
                 if dup::apply(ReduceCtx { heap, prog, tid, hold, term, visit, redex, cont: &mut cont, host: &mut host }) {
-                  release_lock(heap, tid, term);
                   continue 'work;
                 } else {
                   release_lock(heap, tid, term);
@@ -240,8 +343,7 @@ pub fn reducer(
           if cont == REDEX_CONT_RET {
             //println!("done {}", show_at(heap, prog, host, &[]));
             stop.fetch_sub(1, Ordering::Relaxed);
-            if full && !seen.contains(&host) {
-              seen.insert(host);
+            if full && set_mark(heap, host, seen) {
               let term = load_ptr(heap, host);
               match get_tag(term) {
                 LAM => {
@@ -281,7 +383,7 @@ pub fn reducer(
             break 'work;
           }
           // Otherwise, try reducing the parent redex
-          if let Some((new_cont, new_host)) = redex.complete(cont) {
+          if let Some((new_cont, new_host)) = redex.complete(tid, cont) {
             cont = new_cont;
             host = new_host;
             continue 'call;
@@ -293,6 +395,10 @@ pub fn reducer(
       'blink: loop {
         // If available, visit a new location
         if let Some((new_cont, new_host)) = visit.pop() {
+          // Wakes a parked thread up, since there is work left to steal
+          if park.has_sleepers() && visit.len() > 0 {
+            park.notify_one();
+          }
           cont = new_cont;
           host = new_host;
           continue 'main;
@@ -309,39 +415,112 @@ pub fn reducer(
         print(tid, u64::MAX);
       }
       //println!("[{}] steal", tid);
-      if stop.load(Ordering::Relaxed) == 0 {
+      if let Some(tele) = tele {
+        tele.set_idle(tid);
+      }
+      if heap.prof.is_some() && idle.is_none() {
+        idle = Some(instant::Instant::now());
+      }
+      if stop.load(Ordering::Relaxed) == 0 || park.has_quit() {
         //println!("[{}] stop", tid);
+        prof_idle(heap, tid, &mut idle);
+        park.notify_all();
         break 'main;
       } else {
-        for victim_tid in tids {
-          if *victim_tid != tid {
-            if let Some((new_cont, new_host)) = heap.vstk[*victim_tid].steal() {
+        // Stops for a collection, if another thread asked
+        if let Some(gc) = gc {
+          if safe.want.load(Ordering::Relaxed) {
+            safepoint(heap, prog, gc, safe, index, tid, roots, stop, full);
+          }
+        }
+        // Resumes a delayed visit whose dup was released
+        if let Some(index) = delay.iter().position(|delayed| is_visit_ready(heap, *delayed)) {
+          let delayed = delay.swap_remove(index);
+          cont = get_visit_cont(delayed);
+          host = get_visit_host(delayed);
+          bkoff.reset();
+          sleep = PARK_MIN_MICROS;
+          prof_idle(heap, tid, &mut idle);
+          continue 'main;
+        }
+        // Resumes a task whose effect completed
+        if !nested {
+          if let Some(wait) = heap.io.next_ready() {
+            if let Some((new_cont, new_host)) = redex.complete(tid, wait) {
               cont = new_cont;
               host = new_host;
-              //println!("stolen");
+              bkoff.reset();
+              sleep = PARK_MIN_MICROS;
+              prof_idle(heap, tid, &mut idle);
               continue 'main;
             }
           }
         }
-        bkoff.snooze();
+        vics.next_round();
+        for i in 0 .. vics.len() {
+          prof_inc(heap, tid, PROF_STEAL_TRY, 1);
+          if let Some((new_cont, new_host)) = heap.vstk[vics.get(i)].steal_batch(visit) {
+            cont = new_cont;
+            host = new_host;
+            bkoff.reset();
+            sleep = PARK_MIN_MICROS;
+            prof_inc(heap, tid, PROF_STEAL_OK, 1);
+            prof_idle(heap, tid, &mut idle);
+            //println!("stolen");
+            continue 'main;
+          }
+        }
+        // Spins for a while, then parks with an exponentially growing timeout
+        if !bkoff.is_completed() {
+          bkoff.snooze();
+        } else {
+          park.wait(stop, sleep);
+          sleep = std::cmp::min(sleep * 2, PARK_MAX_MICROS);
+        }
         continue 'steal;
       }
     }
   }
+
+  // Clears the marks this thread set
+  for index in seen.iter() {
+    clear_mark_word(heap, *index);
+  }
 }
 
+// A delayed visit can be resumed once its dup isn't locked, or its host was rewritten
+pub fn is_visit_ready(heap: &Heap, visit: Visit) -> bool {
+  let term = load_ptr(heap, get_visit_host(visit));
+  match get_tag(term) {
+    DP0 | DP1 => {
+      return !is_locked(heap, term);
+    }
+    _ => {
+      return true;
+    }
+  }
+}
+
+// Reduces a term to full normal form. A single pass suffices, unless a substitution reached a part
+// of the term that was already normalized, in which case the pass is repeated.
 pub fn normalize(heap: &Heap, prog: &Program, tids: &[usize], host: u64, debug: bool) -> Ptr {
-  let mut cost = get_cost(heap);
+  normalize_roots(heap, prog, tids, &[host], debug);
+  load_ptr(heap, host)
+}
+
+// Reduces many terms to full normal form, at once (see `reduce_roots`)
+pub fn normalize_roots(heap: &Heap, prog: &Program, tids: &[usize], roots: &[u64], debug: bool) {
+  let dirt = heap.dirt.swap(false, Ordering::Relaxed);
   loop {
-    reduce(heap, prog, tids, host, true, debug);
-    let new_cost = get_cost(heap);
-    if new_cost != cost {
-      cost = new_cost;
-    } else {
+    reduce_roots(heap, prog, tids, roots, true, debug);
+    if !heap.dirt.swap(false, Ordering::Relaxed) {
       break;
     }
   }
-  load_ptr(heap, host)
+  // Restores the flag of an enclosing normalization
+  if dirt {
+    heap.dirt.store(true, Ordering::Relaxed);
+  }
 }
 
 //pub fn normal(heap: &Heap, prog: &Program, tids: &[usize], host: u64, seen: &mut im::HashSet<u64>, debug: bool) -> Ptr {
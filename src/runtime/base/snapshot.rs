@@ -0,0 +1,150 @@
+// Snapshot
+// --------
+// Saves the heap to a file and loads it back, so that evaluated terms (lookup tables, preprocessed
+// data) can be reused by another process. Locations are preserved, so a host returned before saving
+// is still valid after loading. The file layout, in native-endian u64 words, is:
+// - header, padded to SNAPSHOT_HEAD_SIZE bytes: magic, version, cell count, label word count,
+//   memo entry count
+// - the node cells, from 0 up to the last used one
+// - the label words: the first dup label batch never handed out (see `data::label_space`)
+// - the memo entries: (function id, cell) of each memoized value (see `data::memo_table`)
+// - the function table: count, then (id, arity, name length, name bytes padded to 8) per entry
+// Since the cells start at a page boundary, loading maps them straight from the file, copy-on-write.
+// Function ids are matched by name against the loading program; if they differ, CTR and FUN cells
+// are rewritten with the new ids. Heaps holding buffers can't be saved, as their bytes are off-heap.
+
+use crate::runtime::{*};
+use std::collections::HashMap;
+use std::io::{BufWriter, Read, Seek, SeekFrom, Write};
+
+pub const SNAPSHOT_MAGIC : u64 = u64::from_le_bytes(*b"HVMSNAP\0");
+pub const SNAPSHOT_VERSION : u64 = 4;
+
+// Large enough to keep the cells page aligned on 64 KB page systems
+pub const SNAPSHOT_HEAD_SIZE : u64 = 1 << 16;
+
+pub fn save_snapshot(heap: &Heap, prog: &Program, path: &str) -> Result<(), String> {
+  if heap.bufs.len() > 0 {
+    return Err(format!("can't save a heap holding buffers, whose bytes live outside of it"));
+  }
+  let file = std::fs::File::create(path).map_err(|e| format!("can't create '{}': {}", path, e))?;
+  let mut file = BufWriter::new(file);
+  let mut cells = get_heap_end(heap);
+  while cells > 0 && (load_ptr(heap, cells as u64 - 1) == 0 || get_tag(load_ptr(heap, cells as u64 - 1)) == NIL) {
+    cells -= 1;
+  }
+  let memo = heap.memo.entries();
+  let mut words : Vec<u64> = vec![SNAPSHOT_MAGIC, SNAPSHOT_VERSION, cells as u64, 1, memo.len() as u64];
+  words.resize((SNAPSHOT_HEAD_SIZE / 8) as usize, 0);
+  write_words(&mut file, &words)?;
+  // Cells of nodes on free lists are saved as empty
+  let mut chunk = Vec::with_capacity(1 << 16);
+  for idx in 0 .. cells {
+    let ptr = load_ptr(heap, idx as u64);
+    chunk.push(if get_tag(ptr) == NIL { 0 } else { ptr });
+    if chunk.len() == chunk.capacity() || idx + 1 == cells {
+      write_words(&mut file, &chunk)?;
+      chunk.clear();
+    }
+  }
+  // The batches the threads took count as used, however many of their labels they used
+  write_words(&mut file, &[heap.labs.get_next()])?;
+  write_words(&mut file, &memo.iter().flat_map(|(fid, cell)| [*fid, *cell]).collect::<Vec<u64>>())?;
+  let mut table = vec![0];
+  for (fid, name) in prog.nams.data.iter().enumerate() {
+    if let Some(name) = name {
+      let bytes = name.as_bytes();
+      table[0] += 1;
+      table.push(fid as u64);
+      table.push(*prog.aris.get(&(fid as u64)).unwrap_or(&u64::MAX));
+      table.push(bytes.len() as u64);
+      for part in bytes.chunks(8) {
+        let mut word = [0; 8];
+        word[.. part.len()].copy_from_slice(part);
+        table.push(u64::from_ne_bytes(word));
+      }
+    }
+  }
+  write_words(&mut file, &table)?;
+  return file.flush().map_err(|e| format!("can't write '{}': {}", path, e));
+}
+
+// Creates a heap with `tids` threads holding the snapshot at `path`. Its size is the largest of
+// `size` and the snapshot's cell count. Uses the scanning allocator, which skips the loaded cells.
+pub fn load_snapshot(prog: &Program, path: &str, size: usize, tids: usize) -> Result<Heap, String> {
+  let mut file = std::fs::File::open(path).map_err(|e| format!("can't open '{}': {}", path, e))?;
+  let head = read_words(&mut file, 5)?;
+  if head[0] != SNAPSHOT_MAGIC {
+    return Err(format!("'{}' is not a snapshot", path));
+  }
+  if head[1] != SNAPSHOT_VERSION {
+    return Err(format!("'{}' has snapshot version {}, expected {}", path, head[1], SNAPSHOT_VERSION));
+  }
+  let cells = head[2] as usize;
+  let label_words = head[3] as usize;
+  let memo_count = head[4] as usize;
+
+  // Reads the tables at the end of the file
+  file.seek(SeekFrom::Start(SNAPSHOT_HEAD_SIZE + cells as u64 * 8)).map_err(|e| format!("can't read '{}': {}", path, e))?;
+  let labels = read_words(&mut file, label_words)?;
+  let memo = read_words(&mut file, memo_count * 2)?;
+  let count = read_words(&mut file, 1)?[0];
+  let mut remap = vec![];
+  let ids = prog.nams.data.iter().enumerate().filter_map(|(fid, name)| name.as_ref().map(|name| (name.clone(), fid as u64))).collect::<HashMap<String, u64>>();
+  for _ in 0 .. count {
+    let entry = read_words(&mut file, 3)?;
+    let mut name = vec![];
+    for word in read_words(&mut file, (entry[2] as usize + 7) / 8)? {
+      name.extend_from_slice(&word.to_ne_bytes());
+    }
+    name.truncate(entry[2] as usize);
+    let name = String::from_utf8_lossy(&name).to_string();
+    let fid = *ids.get(&name).ok_or_else(|| format!("snapshot uses '{}', which isn't defined", name))?;
+    let arit = *prog.aris.get(&fid).unwrap_or(&u64::MAX);
+    if entry[1] != u64::MAX && arit != u64::MAX && entry[1] != arit {
+      return Err(format!("snapshot has '{}' with arity {}, but it is defined with arity {}", name, entry[1], arit));
+    }
+    if fid != entry[0] {
+      let old = entry[0] as usize;
+      if remap.len() <= old {
+        remap.resize(old + 1, None);
+      }
+      remap[old] = Some(fid);
+    }
+  }
+
+  // Maps the cells over a fresh heap
+  let size = std::cmp::max(size, cells);
+  let mut heap = new_heap(size, tids, AllocMode::Scan);
+  heap.node = MemMap::reserve_file(heap.node.len(), &file, SNAPSHOT_HEAD_SIZE, cells).ok_or_else(|| format!("can't map '{}'", path))?;
+  heap.labs.set_next(labels.get(0).copied().unwrap_or(LABEL_BATCHES));
+  for entry in memo.chunks(2) {
+    let fid = remap.get(entry[0] as usize).copied().flatten().unwrap_or(entry[0]);
+    heap.memo.set(fid, entry[1]);
+  }
+  if remap.len() > 0 {
+    for idx in 0 .. cells {
+      let ptr = load_ptr(&heap, idx as u64);
+      let tag = get_tag(ptr);
+      if tag == CTR || tag == FUN {
+        if let Some(Some(fid)) = remap.get(get_ext(ptr) as usize) {
+          link(&heap, idx as u64, (ptr & !(0xFFF_FFFF * EXT)) | (fid * EXT));
+        }
+      }
+    }
+  }
+  return Ok(heap);
+}
+
+fn write_words(file: &mut BufWriter<std::fs::File>, words: &[u64]) -> Result<(), String> {
+  for word in words {
+    file.write_all(&word.to_ne_bytes()).map_err(|e| format!("can't write snapshot: {}", e))?;
+  }
+  return Ok(());
+}
+
+fn read_words(file: &mut std::fs::File, count: usize) -> Result<Vec<u64>, String> {
+  let mut bytes = vec![0; count * 8];
+  file.read_exact(&mut bytes).map_err(|_| "snapshot is truncated".to_string())?;
+  return Ok(bytes.chunks(8).map(|x| u64::from_ne_bytes(x.try_into().unwrap())).collect());
+}
@@ -0,0 +1,241 @@
+// Telemetry
+// ---------
+// Opt-in sampling of what the reducers are doing, cheap enough to leave on for a whole run, unlike
+// the debug mode, which stops every thread at each step. Each reducer publishes the redex it is on
+// (its host and cont) in its slot, with a relaxed store per step. While an outer reduction runs, a
+// background thread reads the slots every TELE_PERIOD_MICROS, without stopping anyone, and walks
+// each host's parent redexes through the redex bag: that is the chain of calls waiting on it, so,
+// counted together, the samples are folded stacks, the input of flamegraph tools. If given an
+// address, the same thread also answers HTTP requests between samples:
+// - /metrics: rewrites per thread, heap cells in use, and what each thread is on, in the
+//   Prometheus text format, to be scraped while the program runs
+// - /folded: the stacks sampled so far, one "root;...;leaf count" line each
+// Samples race with the reducers, so a stack may be cut short, or have a stale frame, when its
+// redexes complete while it's read. As with any sampling profiler, only the counts are meaningful.
+
+use crate::runtime::{*};
+use crossbeam::utils::{CachePadded};
+use std::collections::HashMap;
+use std::io::{Read, Write};
+use std::net::{TcpListener, TcpStream};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::Mutex;
+use std::time::Duration;
+
+pub const TELE_PERIOD_MICROS : u64 = 1000; // time between samples
+pub const TELE_MAX_DEPTH     : usize = 256; // frames kept of a stack, from its leaf
+pub const TELE_READ_MILLIS   : u64 = 100; // how long a request may take to arrive, or its answer to be read
+pub const TELE_HEAD_MAX      : usize = 1 << 14; // bytes read of a request
+pub const TELE_IDLE          : u64 = u64::MAX; // the slot of a thread without work, and its frame
+
+pub struct Telemetry {
+  pub slot: Box<[CachePadded<AtomicU64>]>, // what each thread is on: cont << 32 | host, or TELE_IDLE
+  pub taken: AtomicU64, // samples taken
+  stacks: Mutex<HashMap<Vec<u64>, u64>>, // the stacks sampled, root first, with their counts
+  listen: Option<TcpListener>,
+}
+
+// Serves the counters on `addr`, if given
+pub fn new_telemetry(tids: usize, addr: Option<&str>) -> Result<Telemetry, String> {
+  let listen = match addr {
+    Some(addr) => {
+      let listen = TcpListener::bind(addr).map_err(|e| format!("can't serve telemetry on '{}': {}", addr, e))?;
+      listen.set_nonblocking(true).map_err(|e| e.to_string())?;
+      Some(listen)
+    }
+    None => None,
+  };
+  return Ok(Telemetry {
+    slot: (0 .. tids).map(|_| CachePadded::new(AtomicU64::new(TELE_IDLE))).collect(),
+    taken: AtomicU64::new(0),
+    stacks: Mutex::new(HashMap::new()),
+    listen,
+  });
+}
+
+impl Telemetry {
+  #[inline(always)]
+  pub fn set(&self, tid: usize, host: u64, cont: u64) {
+    unsafe { self.slot.get_unchecked(tid) }.store((cont << 32) | host, Ordering::Relaxed);
+  }
+
+  #[inline(always)]
+  pub fn set_idle(&self, tid: usize) {
+    unsafe { self.slot.get_unchecked(tid) }.store(TELE_IDLE, Ordering::Relaxed);
+  }
+}
+
+// Sampling
+// --------
+
+// Runs `body`, sampling the reducers until it returns, if telemetry is on
+pub fn sample_while(heap: &Heap, prog: &Program, body: impl FnOnce()) {
+  let tele = match &heap.tele {
+    Some(tele) => tele,
+    None => {
+      body();
+      return;
+    }
+  };
+  let done = &AtomicBool::new(false);
+  std::thread::scope(|scope| {
+    scope.spawn(move || {
+      while !done.load(Ordering::Relaxed) {
+        take_sample(heap, tele);
+        serve(heap, prog, tele);
+        std::thread::sleep(Duration::from_micros(TELE_PERIOD_MICROS));
+      }
+    });
+    body();
+    done.store(true, Ordering::Relaxed);
+  });
+}
+
+// Counts the stack of every thread once
+fn take_sample(heap: &Heap, tele: &Telemetry) {
+  let mut stacks = tele.stacks.lock().unwrap();
+  for slot in tele.slot.iter() {
+    *stacks.entry(stack_of(heap, slot.load(Ordering::Relaxed))).or_insert(0) += 1;
+  }
+  tele.taken.fetch_add(1, Ordering::Relaxed);
+}
+
+// The function or constructor at a host, or else the kind of its term
+fn frame_of(term: Ptr) -> u64 {
+  match get_tag(term) {
+    FUN | CTR => (get_tag(term) << 28) | get_ext(term),
+    DP1       => DP0 << 28,
+    tag       => tag << 28,
+  }
+}
+
+fn show_frame(prog: &Program, frame: u64) -> String {
+  if frame == TELE_IDLE {
+    return "(idle)".to_string();
+  }
+  match frame >> 28 {
+    FUN | CTR => {
+      let fid = frame & 0xFFF_FFFF;
+      return prog.nams.get(&fid).cloned().unwrap_or_else(|| format!("#{}", fid));
+    }
+    APP => "(app)".to_string(),
+    DP0 => "(dup)".to_string(),
+    OP2 => "(op2)".to_string(),
+    _   => "(whnf)".to_string(),
+  }
+}
+
+// The frames of a thread, from its root to the redex it is on. A parent redex that completed while
+// it's read ends the stack there.
+fn stack_of(heap: &Heap, slot: u64) -> Vec<u64> {
+  if slot == TELE_IDLE {
+    return vec![TELE_IDLE];
+  }
+  let mut stack = vec![];
+  let mut host = slot & 0xFFFF_FFFF;
+  let mut cont = slot >> 32;
+  while (host as usize) < heap.node.len() && stack.len() < TELE_MAX_DEPTH {
+    stack.push(frame_of(load_ptr(heap, host)));
+    if cont == REDEX_CONT_RET {
+      break;
+    }
+    match heap.rbag.peek(cont) {
+      Some(redex) if get_redex_left(redex) > 0 => {
+        host = get_redex_host(redex);
+        cont = get_redex_cont(redex);
+      }
+      _ => {
+        break;
+      }
+    }
+  }
+  stack.reverse();
+  return stack;
+}
+
+// Reports
+// -------
+
+// The stacks sampled so far, in the folded format, sorted
+pub fn show_folded(heap: &Heap, prog: &Program) -> String {
+  let tele = match &heap.tele {
+    Some(tele) => tele,
+    None => {
+      return String::new();
+    }
+  };
+  let stacks = tele.stacks.lock().unwrap();
+  let mut lines = stacks.iter().map(|(stack, count)| {
+    let names = stack.iter().map(|frame| show_frame(prog, *frame)).collect::<Vec<String>>();
+    format!("{} {}\n", names.join(";"), count)
+  }).collect::<Vec<String>>();
+  lines.sort();
+  return lines.concat();
+}
+
+// The counters, in the Prometheus text format
+pub fn show_metrics(heap: &Heap, prog: &Program) -> String {
+  fn head(text: &mut String, name: &str, kind: &str, help: &str) {
+    text.push_str(&format!("# HELP {} {}\n# TYPE {} {}\n", name, help, name, kind));
+  }
+  fn label(name: &str) -> String {
+    return name.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+  }
+  let mut text = String::new();
+  head(&mut text, "hvm_rewrites_total", "counter", "Graph rewrites performed.");
+  for (tid, lvar) in heap.lvar.iter().enumerate() {
+    text.push_str(&format!("hvm_rewrites_total{{thread=\"{}\"}} {}\n", tid, lvar.cost.load(Ordering::Relaxed)));
+  }
+  head(&mut text, "hvm_heap_used_cells", "gauge", "Heap cells in use.");
+  text.push_str(&format!("hvm_heap_used_cells {}\n", get_used(heap)));
+  head(&mut text, "hvm_heap_cells", "gauge", "Heap cells handed to the threads so far.");
+  text.push_str(&format!("hvm_heap_cells {}\n", get_heap_end(heap)));
+  if let Some(tele) = &heap.tele {
+    head(&mut text, "hvm_samples_total", "counter", "Samples taken of the reducers.");
+    text.push_str(&format!("hvm_samples_total {}\n", tele.taken.load(Ordering::Relaxed)));
+    head(&mut text, "hvm_thread_function", "gauge", "What each thread is reducing.");
+    for (tid, slot) in tele.slot.iter().enumerate() {
+      let leaf = *stack_of(heap, slot.load(Ordering::Relaxed)).last().unwrap_or(&TELE_IDLE);
+      text.push_str(&format!("hvm_thread_function{{thread=\"{}\",function=\"{}\"}} 1\n", tid, label(&show_frame(prog, leaf))));
+    }
+  }
+  return text;
+}
+
+// Serving
+// -------
+
+// Answers the requests that arrived since the last call, if serving
+fn serve(heap: &Heap, prog: &Program, tele: &Telemetry) {
+  if let Some(listen) = &tele.listen {
+    while let Ok((stream, _)) = listen.accept() {
+      // A client that goes away is no concern of the reduction
+      answer(heap, prog, stream).ok();
+    }
+  }
+}
+
+fn answer(heap: &Heap, prog: &Program, mut stream: TcpStream) -> std::io::Result<()> {
+  stream.set_nonblocking(false)?;
+  stream.set_read_timeout(Some(Duration::from_millis(TELE_READ_MILLIS)))?;
+  stream.set_write_timeout(Some(Duration::from_millis(TELE_READ_MILLIS)))?;
+  let mut head = Vec::new();
+  let mut buff = [0; 1024];
+  while !head.windows(4).any(|x| x == b"\r\n\r\n") && head.len() < TELE_HEAD_MAX {
+    let size = stream.read(&mut buff)?;
+    if size == 0 {
+      break;
+    }
+    head.extend_from_slice(&buff[.. size]);
+  }
+  let head = String::from_utf8_lossy(&head);
+  let path = head.split_whitespace().nth(1).unwrap_or("");
+  let (status, body) = match path.split('?').next().unwrap_or("") {
+    "/metrics" => ("200 OK", show_metrics(heap, prog)),
+    "/folded"  => ("200 OK", show_folded(heap, prog)),
+    _          => ("404 Not Found", "not found: try /metrics or /folded\n".to_string()),
+  };
+  write!(stream, "HTTP/1.1 {}\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: {}\r\nConnection: close\r\n\r\n", status, body.len())?;
+  stream.write_all(body.as_bytes())?;
+  return stream.flush();
+}
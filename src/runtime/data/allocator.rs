@@ -1,102 +1,134 @@
+use crate::runtime::data::mem_map::{MemMap};
 use crossbeam::utils::{CachePadded};
-use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use std::sync::atomic::{AtomicU64, Ordering};
 
 // Allocator
 // ---------
+// Page-granular arena allocator, selected with `AllocMode::Arena`. The heap is split in pages of
+// PAGE_SIZE cells, each with a `used` counter of live cells. A thread owns one page at a time and
+// bump-allocates on it. While a page is some thread's current page, its `used` counter holds one
+// extra unit, so a page only becomes free (used == 0) after its owner moved on and every node on
+// it was freed. When its page is full, a thread claims the next free page of its own area, then of
+// the pages the heap grew by, and, if there is none, steals free pages from the areas of the other
+// threads. Once all of them are taken, `alloc` returns None, and the heap grows the arena by a chunk
+// of its reserved space (see `memory::alloc`).
 
 pub struct AllocatorNext {
-  pub cell: AtomicU64,
-  pub area: AtomicU64,
+  pub cell: AtomicU64, // next cell to bump-allocate
+  pub area: AtomicU64, // current page
 }
 
 pub struct Allocator {
   pub tids: usize,
-  pub data: Box<[AtomicU64]>,
-  pub used: Box<[AtomicU64]>,
+  pub size: u64, // number of pages split between the threads
+  pub top: AtomicU64, // number of pages, including those the heap grew by
+  pub used: MemMap<AtomicU64>, // one counter per page the heap can have
   pub next: Box<[CachePadded<AllocatorNext>]>,
 }
 
 pub const PAGE_SIZE : usize = 4096;
+pub const PAGE_NONE : u64 = u64::MAX;
 
 impl Allocator {
 
-  pub fn new(tids: usize) -> Allocator {
+  // Makes an allocator for the first `size` cells of a heap that can grow up to `cells`
+  pub fn new(size: usize, tids: usize, cells: usize) -> Allocator {
+    let pages = size / PAGE_SIZE;
     let mut next = vec![];
     for i in 0 .. tids {
-      let cell = AtomicU64::new(u64::MAX);
-      let area = AtomicU64::new((crate::runtime::HEAP_SIZE / PAGE_SIZE / tids * i) as u64);
+      let cell = AtomicU64::new(PAGE_NONE);
+      let area = AtomicU64::new((pages / tids * i) as u64);
       next.push(CachePadded::new(AllocatorNext { cell, area }));
     }
-    let data = crate::runtime::new_atomic_u64_array(crate::runtime::HEAP_SIZE);
-    let used = crate::runtime::new_atomic_u64_array(crate::runtime::HEAP_SIZE / PAGE_SIZE);
+    let size = pages as u64;
+    let top = AtomicU64::new(size);
+    let used = MemMap::new(std::cmp::max(cells / PAGE_SIZE, pages));
     let next = next.into_boxed_slice();
-    Allocator { tids, data, used, next }
+    Allocator { tids, size, top, used, next }
   }
 
-  pub fn alloc(&self, tid: usize, arity: u64) -> u64 {
+  // The range of pages that belongs to a thread
+  pub fn area_of(&self, tid: usize) -> (u64, u64) {
+    let amin = self.size / self.tids as u64 * tid as u64;
+    let amax = if tid == self.tids - 1 { self.size } else { self.size / self.tids as u64 * (tid as u64 + 1) };
+    return (amin, amax);
+  }
+
+  // Makes the pages up to `top` claimable, once the heap grew by them
+  pub fn extend(&self, top: u64) {
+    self.top.fetch_max(std::cmp::min(top, self.used.len() as u64), Ordering::Relaxed);
+  }
+
+  // Returns None when every page is taken
+  pub fn alloc(&self, tid: usize, arity: u64) -> Option<u64> {
     unsafe {
-      let lvar = &heap.lvar[tid];
       if arity == 0 {
-        0
-      } else {
-        let mut length = 0;
-        loop {
-          // Loads value on cursor
-          let val = self.data.get_unchecked(*lvar.next.as_mut_ptr() as usize).load(Ordering::Relaxed);
-          // If it is empty, increment length; otherwise, reset it
-          length = if val == 0 { length + 1 } else { 0 };
-          // Moves the cursor forward
-          *lvar.next.as_mut_ptr() += 1;
-          // If it is out of bounds, warp around
-          if *lvar.next.as_mut_ptr() >= *lvar.amax.as_mut_ptr() {
-            length = 0;
-            *lvar.next.as_mut_ptr() = *lvar.amin.as_mut_ptr();
-          }
-          // If length equals arity, allocate that space
-          if length == arity {
-            return *lvar.next.as_mut_ptr() - length;
+        return Some(0);
+      }
+      let next = self.next.get_unchecked(tid);
+      let cell = next.cell.as_mut_ptr();
+      let area = next.area.as_mut_ptr();
+      // Bump-allocates on the current page, if the node fits
+      if *cell != PAGE_NONE {
+        if *cell + arity <= (*area + 1) * PAGE_SIZE as u64 {
+          self.used.get_unchecked(*area as usize).fetch_add(arity, Ordering::Relaxed);
+          let aloc = *cell;
+          *cell += arity;
+          return Some(aloc);
+        }
+        // The page is full: release the hold on it
+        self.used.get_unchecked(*area as usize).fetch_sub(1, Ordering::Relaxed);
+        *cell = PAGE_NONE;
+      }
+      // Claims a free page on this thread's area, starting after the current page
+      let (amin, amax) = self.area_of(tid);
+      let from = if *area >= amin && *area < amax { *area + 1 - amin } else { 0 };
+      for i in 0 .. amax - amin {
+        let page = amin + (from + i) % (amax - amin);
+        if let Some(aloc) = self.claim(tid, page, arity) {
+          return Some(aloc);
+        }
+      }
+      // Then one of the pages the heap grew by, also starting after the current page
+      let top = self.top.load(Ordering::Relaxed);
+      let from = if *area >= self.size && *area < top { *area + 1 - self.size } else { 0 };
+      for i in 0 .. top - self.size {
+        let page = self.size + (from + i) % (top - self.size);
+        if let Some(aloc) = self.claim(tid, page, arity) {
+          return Some(aloc);
+        }
+      }
+      // Otherwise, steals a free page from another thread's area
+      for i in 1 .. self.tids {
+        let (vmin, vmax) = self.area_of((tid + i) % self.tids);
+        for page in vmin .. vmax {
+          if let Some(aloc) = self.claim(tid, page, arity) {
+            return Some(aloc);
           }
         }
       }
+      return None;
     }
   }
 
-  pub fn free(&self, tid: usize, loc: u64, arity: u64) {
-    for i in 0 .. arity {
-      unsafe { self.data.get_unchecked((loc + i) as usize) }.store(0, Ordering::Relaxed);
-    }
-  }
-
-  pub fn arena_alloc(&self, tid: usize, arity: u64) -> u64 {
-    let next = unsafe { self.next.get_unchecked(tid) };
-    // Attempts to allocate on this thread's owned area
-    let aloc = next.cell.fetch_add(arity, Ordering::Relaxed);
-    let area = aloc / PAGE_SIZE as u64;
-    if aloc != u64::MAX && (aloc + arity) / PAGE_SIZE as u64 == area {
-      unsafe { self.used.get_unchecked(area as usize) }.fetch_add(arity, Ordering::Relaxed);
-      //println!("[{}] old_alloc {} at {}, used={} ({} {})", tid, arity, aloc, self.used[area as usize].load(Ordering::Relaxed), area, (aloc + arity) / PAGE_SIZE as u64);
-      return aloc;
-    }
-    // If we can't, attempt to allocate on a new area
-    let mut area = next.area.load(Ordering::Relaxed)  % ((crate::runtime::HEAP_SIZE / PAGE_SIZE) as u64);
-    loop {
-      if unsafe { self.used.get_unchecked(area as usize) }.compare_exchange_weak(0, arity, Ordering::Relaxed, Ordering::Relaxed).is_ok() {
-        let aloc = area * PAGE_SIZE as u64;
-        next.cell.store(aloc + arity, Ordering::Relaxed);
-        next.area.store((area + 1) % ((crate::runtime::HEAP_SIZE / PAGE_SIZE) as u64), Ordering::Relaxed);
-        //println!("[{}] new_alloc {} at {}, used={}", tid, arity, aloc, self.used[area as usize].load(Ordering::Relaxed));
-        return aloc;
-      } else {
-        area = (area + 1) % ((crate::runtime::HEAP_SIZE / PAGE_SIZE) as u64);
+  // Attempts to make a free page the current page of a thread, allocating `arity` cells on it
+  fn claim(&self, tid: usize, page: u64, arity: u64) -> Option<u64> {
+    unsafe {
+      let used = self.used.get_unchecked(page as usize);
+      if used.load(Ordering::Relaxed) == 0 && used.compare_exchange(0, arity + 1, Ordering::Relaxed, Ordering::Relaxed).is_ok() {
+        let next = self.next.get_unchecked(tid);
+        let aloc = page * PAGE_SIZE as u64;
+        *next.cell.as_mut_ptr() = aloc + arity;
+        *next.area.as_mut_ptr() = page;
+        return Some(aloc);
       }
+      return None;
     }
   }
 
-  pub fn arena_free(&self, tid: usize, loc: u64, arity: u64) {
-    //for i in 0 .. arity { unsafe { self.data.get_unchecked((loc + i) as usize) }.store(0, Ordering::Relaxed); }
-    let area = loc / PAGE_SIZE as u64;
-    let used = unsafe { self.used.get_unchecked(area as usize) }.fetch_sub(arity, Ordering::Relaxed);
-    //println!("[{}] free {} at {}, used={}", tid, arity, loc, self.used[area as usize].load(Ordering::Relaxed));
+  pub fn free(&self, tid: usize, loc: u64, arity: u64) {
+    let page = loc / PAGE_SIZE as u64;
+    unsafe { self.used.get_unchecked(page as usize) }.fetch_sub(arity, Ordering::Relaxed);
   }
 
 }
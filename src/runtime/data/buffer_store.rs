@@ -0,0 +1,90 @@
+// Buffer Store
+// ------------
+// Reference-counted byte arrays that live outside of the heap, so that a buffer term only needs a
+// small node pointing to its bytes, and so its bytes can be handed to the OS without copies. A
+// buffer is identified by its slot. Reading and sharing are lock-free; only adding a buffer and
+// dropping the last reference take the free list's lock, which happens once per file or string.
+
+use crate::runtime::data::mem_map::{MemMap};
+use std::sync::atomic::{AtomicPtr, AtomicU64, Ordering};
+use std::sync::Mutex;
+
+// Slots reserved for live buffers; only the used ones get committed
+pub const BUFFER_STORE_SIZE : usize = 1 << 24;
+
+pub struct Buffer {
+  data: Box<[u8]>,
+  refs: AtomicU64,
+}
+
+pub struct BufferStore {
+  slot: MemMap<AtomicPtr<Buffer>>,
+  next: AtomicU64, // the high-water mark
+  free: Mutex<Vec<u64>>,
+  live: AtomicU64,
+}
+
+impl BufferStore {
+  pub fn new() -> BufferStore {
+    let slot = MemMap::new(BUFFER_STORE_SIZE);
+    let next = AtomicU64::new(0);
+    let free = Mutex::new(Vec::new());
+    let live = AtomicU64::new(0);
+    return BufferStore { slot, next, free, live };
+  }
+
+  // Adds a buffer with one reference, returning its slot
+  pub fn insert(&self, data: Box<[u8]>) -> u64 {
+    let buff = Box::into_raw(Box::new(Buffer { data, refs: AtomicU64::new(1) }));
+    let id = match self.free.lock().unwrap().pop() {
+      Some(id) => id,
+      None => self.next.fetch_add(1, Ordering::Relaxed),
+    };
+    if id as usize >= BUFFER_STORE_SIZE {
+      panic!("too many live buffers (the limit is {})", BUFFER_STORE_SIZE);
+    }
+    self.live.fetch_add(1, Ordering::Relaxed);
+    unsafe { self.slot.get_unchecked(id as usize) }.store(buff, Ordering::Release);
+    return id;
+  }
+
+  // The bytes of a buffer. The caller must hold one of its references while using them.
+  #[inline(always)]
+  pub fn get(&self, id: u64) -> &[u8] {
+    return unsafe { &(*self.slot.get_unchecked(id as usize).load(Ordering::Acquire)).data };
+  }
+
+  // Adds a reference to a buffer the caller holds one of
+  #[inline(always)]
+  pub fn share(&self, id: u64) {
+    unsafe { (*self.slot.get_unchecked(id as usize).load(Ordering::Acquire)).refs.fetch_add(1, Ordering::Relaxed) };
+  }
+
+  // Drops a reference to a buffer, freeing it if it was the last
+  #[inline(always)]
+  pub fn release(&self, id: u64) {
+    let buff = unsafe { self.slot.get_unchecked(id as usize) }.load(Ordering::Acquire);
+    if unsafe { (*buff).refs.fetch_sub(1, Ordering::AcqRel) } == 1 {
+      unsafe { self.slot.get_unchecked(id as usize) }.store(std::ptr::null_mut(), Ordering::Relaxed);
+      drop(unsafe { Box::from_raw(buff) });
+      self.live.fetch_sub(1, Ordering::Relaxed);
+      self.free.lock().unwrap().push(id);
+    }
+  }
+
+  // How many buffers are alive
+  pub fn len(&self) -> u64 {
+    return self.live.load(Ordering::Relaxed);
+  }
+}
+
+impl Drop for BufferStore {
+  fn drop(&mut self) {
+    for id in 0 .. std::cmp::min(*self.next.get_mut() as usize, BUFFER_STORE_SIZE) {
+      let buff = self.slot[id].load(Ordering::Relaxed);
+      if !buff.is_null() {
+        drop(unsafe { Box::from_raw(buff) });
+      }
+    }
+  }
+}
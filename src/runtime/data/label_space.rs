@@ -0,0 +1,160 @@
+// Label Space
+// -----------
+// Hands out the labels of dup nodes, which their pointers carry on the 28-bit ext. Threads take
+// them in batches of LABEL_BATCH, so that creating a label, which rule bodies do once per dup they
+// make, only touches shared state once per batch. Two unrelated dups must never share a label, or
+// a DUP-SUP between them would annihilate instead of commuting, so a batch is only handed out again
+// once no live pointer carries its labels: the tracing collector records the batches it reaches
+// while marking (see `gc.rs`), and the ones it didn't, and that no thread is still taking labels
+// from, become free. When the space runs low, a collection is requested, which the reducers run
+// even on a heap without a collector, as one that only marks (see `reduce_roots`). If the space
+// still runs out, every batch is live, or was at the last collection, so taking one panics.
+// Batch 0 is never handed out, as the superpositions rule bodies make have constant labels in it.
+
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::Mutex;
+
+pub const LABEL_BITS : u64 = 28;
+pub const LABEL_BATCH : u64 = 1 << 14;
+pub const LABEL_BATCHES : u64 = (1 << LABEL_BITS) / LABEL_BATCH;
+
+// With fewer free batches than this left, a collection is requested. Once one leaves less than
+// twice that, no more are, until another collection frees enough, so that the collector doesn't
+// run again and again on a heap whose labels are all live.
+pub const LABEL_LOW : u64 = LABEL_BATCHES / 16;
+
+pub struct LabelSpace {
+  next: AtomicU64,        // the first batch never handed out
+  free: Mutex<Vec<u64>>,  // batches that can be handed out again, in decreasing order
+  seen: Box<[AtomicU64]>, // one bit per batch, set on those reached by a collection
+  goal: AtomicU64,        // free batches below which a collection is requested, if not 0
+  want: AtomicBool,       // few free batches are left
+}
+
+impl LabelSpace {
+  pub fn new() -> LabelSpace {
+    return LabelSpace {
+      next: AtomicU64::new(1),
+      free: Mutex::new(Vec::new()),
+      seen: (0 .. LABEL_BATCHES / 64).map(|_| AtomicU64::new(0)).collect(),
+      goal: AtomicU64::new(LABEL_LOW),
+      want: AtomicBool::new(false),
+    };
+  }
+
+  // Takes a range of at least `count` labels, returning its bounds
+  pub fn take(&self, count: u64) -> (u64, u64) {
+    let size = std::cmp::max(1, (count + LABEL_BATCH - 1) / LABEL_BATCH);
+    let mut free = self.free.lock().unwrap();
+    let next = std::cmp::min(self.next.load(Ordering::Relaxed), LABEL_BATCHES);
+    let left = LABEL_BATCHES - next + free.len() as u64;
+    let goal = self.goal.load(Ordering::Relaxed);
+    if goal > 0 && left < goal + size {
+      self.want.store(true, Ordering::Relaxed);
+    }
+    if size == 1 {
+      if let Some(batch) = free.pop() {
+        return (batch * LABEL_BATCH, (batch + 1) * LABEL_BATCH);
+      }
+    }
+    if next + size <= LABEL_BATCHES {
+      self.next.store(next + size, Ordering::Relaxed);
+      return (next * LABEL_BATCH, (next + size) * LABEL_BATCH);
+    }
+    // Takes the lowest `size` free batches in a row. Reusing batches that may be live instead would
+    // make unrelated dups annihilate, silently, so, if there are none, this fails.
+    let rows = (size as usize - 1 .. free.len()).rev().find(|i| free[*i - (size as usize - 1)] - free[*i] == size - 1);
+    if let Some(last) = rows {
+      let batch = free[last];
+      free.drain(last + 1 - size as usize ..= last);
+      return (batch * LABEL_BATCH, (batch + size) * LABEL_BATCH);
+    }
+    panic!("dup labels: out of label space, with {} batches wanted and {} free", size, free.len());
+  }
+
+  // Whether a collection should run, to free batches
+  #[inline(always)]
+  pub fn is_low(&self) -> bool {
+    return self.want.load(Ordering::Relaxed);
+  }
+
+  // Records that a live pointer carries `label`. Called while marking.
+  #[inline(always)]
+  pub fn see(&self, label: u64) {
+    let batch = label / LABEL_BATCH;
+    let word = unsafe { self.seen.get_unchecked((batch / 64) as usize) };
+    if (word.load(Ordering::Relaxed) >> (batch % 64)) & 1 == 0 {
+      word.fetch_or(1 << (batch % 64), Ordering::Relaxed);
+    }
+  }
+
+  // Frees the batches that the last collection didn't reach, except for those overlapping `held`,
+  // the ranges the threads still take labels from, and clears the marks
+  pub fn reclaim(&self, held: &[(u64, u64)]) {
+    let mut free = self.free.lock().unwrap();
+    let next = std::cmp::min(self.next.load(Ordering::Relaxed), LABEL_BATCHES);
+    free.clear();
+    for batch in (1 .. next).rev() {
+      let seen = (self.seen[(batch / 64) as usize].load(Ordering::Relaxed) >> (batch % 64)) & 1 == 1;
+      let init = batch * LABEL_BATCH;
+      let last = init + LABEL_BATCH;
+      if !seen && !held.iter().any(|(from, upto)| from < upto && *from < last && *upto > init) {
+        free.push(batch);
+      }
+    }
+    for word in self.seen.iter() {
+      word.store(0, Ordering::Relaxed);
+    }
+    let left = LABEL_BATCHES - next + free.len() as u64;
+    self.goal.store(if left >= 2 * LABEL_LOW { LABEL_LOW } else { 0 }, Ordering::Relaxed);
+    self.want.store(false, Ordering::Relaxed);
+  }
+
+  // Number of batches that can be handed out again
+  pub fn get_free(&self) -> u64 {
+    return self.free.lock().unwrap().len() as u64;
+  }
+
+  // The first batch never handed out, which is all a snapshot needs to keep
+  pub fn get_next(&self) -> u64 {
+    return self.next.load(Ordering::Relaxed);
+  }
+
+  pub fn set_next(&self, next: u64) {
+    self.next.store(std::cmp::max(next, 1), Ordering::Relaxed);
+  }
+}
+
+#[cfg(test)]
+mod tests {
+  use super::*;
+
+  // A space whose batches are all handed out, and then all seen but `free`
+  fn new_space_with_free(free: &[u64]) -> LabelSpace {
+    let labs = LabelSpace::new();
+    labs.set_next(LABEL_BATCHES);
+    for batch in 1 .. LABEL_BATCHES {
+      if !free.contains(&batch) {
+        labs.see(batch * LABEL_BATCH);
+      }
+    }
+    labs.reclaim(&[]);
+    return labs;
+  }
+
+  #[test]
+  fn test_label_space_takes_free_batches_in_a_row() {
+    let labs = new_space_with_free(&[3, 6, 8, 9]);
+    assert_eq!(labs.take(2 * LABEL_BATCH), (8 * LABEL_BATCH, 10 * LABEL_BATCH));
+    assert_eq!(labs.take(1), (3 * LABEL_BATCH, 4 * LABEL_BATCH));
+    assert_eq!(labs.take(1), (6 * LABEL_BATCH, 7 * LABEL_BATCH));
+    assert_eq!(labs.get_free(), 0);
+  }
+
+  #[test]
+  #[should_panic(expected = "out of label space")]
+  fn test_label_space_fails_once_every_batch_is_live() {
+    let labs = new_space_with_free(&[3, 5]);
+    labs.take(2 * LABEL_BATCH);
+  }
+}
@@ -0,0 +1,105 @@
+// Mem Map
+// -------
+// A large, zero-initialized array whose memory is reserved up front but only committed when
+// touched. On unix it is an anonymous `mmap` with MAP_NORESERVE, so untouched pages are never
+// backed by physical memory and there's no up-front cost to zero them. Elsewhere it falls back to
+// a zeroed allocation. `A` must be valid when all its bytes are zero (atomics, integers).
+
+use std::ops::Deref;
+
+pub struct MemMap<A> {
+  data: *mut A,
+  size: usize,
+  mmap: bool,
+}
+
+unsafe impl<A: Sync> Sync for MemMap<A> {}
+unsafe impl<A: Send> Send for MemMap<A> {}
+
+impl<A> MemMap<A> {
+
+  // Reserves `size` elements. Returns None if the address space couldn't be reserved.
+  pub fn reserve(size: usize) -> Option<MemMap<A>> {
+    let bytes = std::cmp::max(size, 1) * std::mem::size_of::<A>();
+    #[cfg(unix)]
+    unsafe {
+      let prot = libc::PROT_READ | libc::PROT_WRITE;
+      let flag = libc::MAP_PRIVATE | libc::MAP_ANONYMOUS | libc::MAP_NORESERVE;
+      let data = libc::mmap(std::ptr::null_mut(), bytes, prot, flag, -1, 0);
+      if data == libc::MAP_FAILED {
+        return None;
+      }
+      return Some(MemMap { data: data as *mut A, size, mmap: true });
+    }
+    #[cfg(not(unix))]
+    unsafe {
+      let layout = std::alloc::Layout::from_size_align(bytes, std::mem::align_of::<A>()).ok()?;
+      let data = std::alloc::alloc_zeroed(layout);
+      if data.is_null() {
+        return None;
+      }
+      return Some(MemMap { data: data as *mut A, size, mmap: false });
+    }
+  }
+
+  // Reserves `size` elements, the first `len` of which are read from `file`, starting at byte
+  // `offset`. On unix the file is mapped copy-on-write over the start of the reservation, so its
+  // pages are only read when touched and never written back; `offset` must be page aligned.
+  pub fn reserve_file(size: usize, file: &std::fs::File, offset: u64, len: usize) -> Option<MemMap<A>> {
+    let map = MemMap::reserve(size)?;
+    let bytes = len * std::mem::size_of::<A>();
+    if len > size {
+      return None;
+    }
+    if bytes > 0 {
+      #[cfg(unix)]
+      unsafe {
+        use std::os::unix::io::AsRawFd;
+        let prot = libc::PROT_READ | libc::PROT_WRITE;
+        let flag = libc::MAP_PRIVATE | libc::MAP_FIXED;
+        let data = libc::mmap(map.data as *mut libc::c_void, bytes, prot, flag, file.as_raw_fd(), offset as libc::off_t);
+        if data == libc::MAP_FAILED {
+          return None;
+        }
+      }
+      #[cfg(not(unix))]
+      unsafe {
+        use std::io::{Read, Seek};
+        let mut file = file;
+        file.seek(std::io::SeekFrom::Start(offset)).ok()?;
+        file.read_exact(std::slice::from_raw_parts_mut(map.data as *mut u8, bytes)).ok()?;
+      }
+    }
+    return Some(map);
+  }
+
+  pub fn new(size: usize) -> MemMap<A> {
+    match MemMap::reserve(size) {
+      Some(map) => map,
+      None => panic!("unable to reserve {} bytes of memory", size * std::mem::size_of::<A>()),
+    }
+  }
+
+}
+
+impl<A> Deref for MemMap<A> {
+  type Target = [A];
+  fn deref(&self) -> &[A] {
+    return unsafe { std::slice::from_raw_parts(self.data, self.size) };
+  }
+}
+
+impl<A> Drop for MemMap<A> {
+  fn drop(&mut self) {
+    let bytes = std::cmp::max(self.size, 1) * std::mem::size_of::<A>();
+    unsafe {
+      if self.mmap {
+        #[cfg(unix)]
+        libc::munmap(self.data as *mut libc::c_void, bytes);
+      } else {
+        let layout = std::alloc::Layout::from_size_align_unchecked(bytes, std::mem::align_of::<A>());
+        std::alloc::dealloc(self.data as *mut u8, layout);
+      }
+    }
+  }
+}
@@ -0,0 +1,63 @@
+// Memo Table
+// ----------
+// Maps each memoized function (see `fun::memo_call`) to the heap cell that holds its shared value,
+// made by its first call. Lookups are a single load on an array indexed by function id, which is
+// reserved lazily, so that functions no one calls take no memory; ids past MEMO_MAX_FIDS aren't
+// memoized. Making a cell takes a lock, so that two first calls racing don't both make one. The
+// cells are never freed, which is what keeps a value shared by calls that are far apart, so the
+// tracing collector treats them as roots.
+
+use crate::runtime::data::mem_map::{MemMap};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Mutex;
+
+pub const MEMO_MAX_FIDS : usize = 1 << 16;
+
+pub struct MemoTable {
+  cell: MemMap<AtomicU64>, // the cell of each function, plus one, or 0 if it wasn't made yet
+  made: Mutex<Vec<u64>>,   // the functions whose cells were made
+}
+
+impl MemoTable {
+  pub fn new() -> MemoTable {
+    return MemoTable {
+      cell: MemMap::new(MEMO_MAX_FIDS),
+      made: Mutex::new(Vec::new()),
+    };
+  }
+
+  // Returns the cell of `fid`, calling `make` to allocate it if it doesn't exist yet
+  #[inline(always)]
+  pub fn get_or_make(&self, fid: u64, make: impl FnOnce() -> u64) -> u64 {
+    let slot = unsafe { self.cell.get_unchecked(fid as usize) };
+    let cell = slot.load(Ordering::Acquire);
+    if cell != 0 {
+      return cell - 1;
+    }
+    let mut made = self.made.lock().unwrap();
+    let cell = slot.load(Ordering::Acquire);
+    if cell != 0 {
+      return cell - 1;
+    }
+    let cell = make();
+    slot.store(cell + 1, Ordering::Release);
+    made.push(fid);
+    return cell;
+  }
+
+  // Sets the cell of `fid`, as a snapshot that is loaded had it
+  pub fn set(&self, fid: u64, cell: u64) {
+    if (fid as usize) < MEMO_MAX_FIDS {
+      let mut made = self.made.lock().unwrap();
+      if self.cell[fid as usize].swap(cell + 1, Ordering::Release) == 0 {
+        made.push(fid);
+      }
+    }
+  }
+
+  // The functions whose cells were made, with their cells
+  pub fn entries(&self) -> Vec<(u64, u64)> {
+    let made = self.made.lock().unwrap();
+    return made.iter().map(|fid| (*fid, self.cell[*fid as usize].load(Ordering::Acquire) - 1)).collect();
+  }
+}
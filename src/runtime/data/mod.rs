@@ -1,14 +1,30 @@
-//pub mod allocator;
-
 pub mod f60;
 pub mod u60;
 
+pub mod allocator;
 pub mod barrier;
+pub mod buffer_store;
+pub mod label_space;
+pub mod mem_map;
+pub mod memo_table;
+pub mod park;
+pub mod pool;
+pub mod reactor;
 pub mod redex_bag;
 pub mod u64_map;
+pub mod victims;
 pub mod visit_queue;
 
+pub use allocator::{*};
 pub use barrier::{*};
+pub use buffer_store::{*};
+pub use label_space::{*};
+pub use mem_map::{*};
+pub use memo_table::{*};
+pub use park::{*};
+pub use pool::{*};
+pub use reactor::{*};
 pub use redex_bag::{*};
 pub use u64_map::{*};
+pub use victims::{*};
 pub use visit_queue::{*};
@@ -0,0 +1,65 @@
+// Park
+// ----
+// Lets idle threads sleep instead of spinning while there is nothing to steal. A parked thread
+// wakes up when notified, or when its timeout expires; since wake-ups aren't guaranteed to be
+// delivered, callers must use a bounded timeout and re-check for work. A thread that fails sets
+// `quit`, so that the others give up instead of waiting for work it will never finish.
+
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+use std::sync::{Condvar, Mutex};
+use std::time::Duration;
+
+pub const PARK_MIN_MICROS : u64 = 16;
+pub const PARK_MAX_MICROS : u64 = 1024;
+
+pub struct Park {
+  pub sleepers: AtomicUsize,
+  pub mutex: Mutex<()>,
+  pub cvar: Condvar,
+  pub quit: AtomicBool,
+}
+
+impl Park {
+  pub fn new() -> Park {
+    Park {
+      sleepers: AtomicUsize::new(0),
+      mutex: Mutex::new(()),
+      cvar: Condvar::new(),
+      quit: AtomicBool::new(false),
+    }
+  }
+
+  pub fn wait(&self, stop: &AtomicUsize, micros: u64) {
+    self.sleepers.fetch_add(1, Ordering::SeqCst);
+    let guard = self.mutex.lock().unwrap();
+    if stop.load(Ordering::Relaxed) != 0 && !self.has_quit() {
+      let _ = self.cvar.wait_timeout(guard, Duration::from_micros(micros));
+    }
+    self.sleepers.fetch_sub(1, Ordering::SeqCst);
+  }
+
+  // Tells every thread to stop, and wakes the parked ones
+  pub fn quit(&self) {
+    self.quit.store(true, Ordering::Relaxed);
+    let _guard = self.mutex.lock().unwrap_or_else(|e| e.into_inner());
+    self.cvar.notify_all();
+  }
+
+  #[inline(always)]
+  pub fn has_quit(&self) -> bool {
+    return self.quit.load(Ordering::Relaxed);
+  }
+
+  #[inline(always)]
+  pub fn has_sleepers(&self) -> bool {
+    return self.sleepers.load(Ordering::Relaxed) > 0;
+  }
+
+  pub fn notify_one(&self) {
+    self.cvar.notify_one();
+  }
+
+  pub fn notify_all(&self) {
+    self.cvar.notify_all();
+  }
+}
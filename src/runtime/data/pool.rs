@@ -0,0 +1,235 @@
+// Pool
+// ----
+// A set of worker threads that is kept alive across calls to `reduce`, so that evaluations don't
+// pay for spawning and joining OS threads each time. `run(count, job)` executes `job(0)` on the
+// calling thread and `job(1) .. job(count - 1)` on workers, returning once all of them are done.
+// Nested or concurrent calls, and calls asking for more workers than the pool has, fall back to
+// spawning scoped threads. `par_map` is for the work that comes before any pool exists, which is
+// compiling a program's rules.
+//
+// A job that panics doesn't take its worker down: the worker catches the panic and keeps the first
+// payload, which `run` resumes on the caller once every worker is done. If `job(0)` panics, `run`
+// also waits for the workers before unwinding, since they are still borrowing the job. A job that
+// waits on its siblings should watch for their failure (see `reduce_roots`), or a panic will hang.
+
+use std::any::Any;
+use std::panic::{AssertUnwindSafe, catch_unwind, resume_unwind};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Condvar, Mutex, MutexGuard};
+use std::thread::JoinHandle;
+
+// The job is only borrowed for the duration of `run`, which waits for every worker to finish it
+type PoolJob = &'static (dyn Fn(usize) + Sync);
+
+pub struct PoolWorker {
+  pub todo: Mutex<Option<(PoolJob, usize)>>,
+  pub wake: Condvar,
+}
+
+pub struct PoolShared {
+  pub workers: Box<[PoolWorker]>,
+  pub left: Mutex<usize>,
+  pub done: Condvar,
+  pub quit: AtomicBool,
+  pub fail: Mutex<Option<Box<dyn Any + Send>>>, // the first panic of a worker's job
+}
+
+pub struct Pool {
+  pub shared: Arc<PoolShared>,
+  pub handles: Vec<JoinHandle<()>>,
+  pub busy: AtomicBool,
+}
+
+impl Pool {
+
+  // Creates a pool that can run jobs on `tids` threads (the caller included)
+  pub fn new(tids: usize) -> Pool {
+    let size = if tids > 0 { tids - 1 } else { 0 };
+    let workers = (0 .. size).map(|_| PoolWorker { todo: Mutex::new(None), wake: Condvar::new() }).collect::<Vec<PoolWorker>>();
+    let shared = Arc::new(PoolShared {
+      workers: workers.into_boxed_slice(),
+      left: Mutex::new(0),
+      done: Condvar::new(),
+      quit: AtomicBool::new(false),
+      fail: Mutex::new(None),
+    });
+    let mut handles = vec![];
+    for index in 0 .. size {
+      let shared = shared.clone();
+      handles.push(std::thread::spawn(move || pool_worker(&shared, index)));
+    }
+    return Pool { shared, handles, busy: AtomicBool::new(false) };
+  }
+
+  pub fn run(&self, count: usize, job: &(dyn Fn(usize) + Sync)) {
+    if count <= 1 {
+      if count == 1 {
+        job(0);
+      }
+      return;
+    }
+    if count - 1 > self.shared.workers.len() || self.busy.swap(true, Ordering::Acquire) {
+      std::thread::scope(|s| {
+        for i in 1 .. count {
+          s.spawn(move || job(i));
+        }
+        job(0);
+      });
+      return;
+    }
+    let job : PoolJob = unsafe { std::mem::transmute(job) };
+    *lock(&self.shared.left) = count - 1;
+    for i in 1 .. count {
+      let worker = &self.shared.workers[i - 1];
+      *lock(&worker.todo) = Some((job, i));
+      worker.wake.notify_one();
+    }
+    // Waits for the workers when dropped, which is also when `job(0)` unwinds
+    struct Join<'a>(&'a Pool);
+    impl<'a> Drop for Join<'a> {
+      fn drop(&mut self) {
+        let mut left = lock(&self.0.shared.left);
+        while *left > 0 {
+          left = self.0.shared.done.wait(left).unwrap_or_else(|e| e.into_inner());
+        }
+        self.0.busy.store(false, Ordering::Release);
+      }
+    }
+    let join = Join(self);
+    job(0);
+    drop(join);
+    if let Some(payload) = lock(&self.shared.fail).take() {
+      resume_unwind(payload);
+    }
+  }
+
+  // Pins each thread to a cpu: the one running `job(i)` goes to cpu `i % cpus`. That includes the
+  // caller, which runs `job(0)`, and stays pinned after this returns.
+  pub fn pin(&self) {
+    let cpus = std::thread::available_parallelism().map(|x| x.get()).unwrap_or(1);
+    self.run(self.shared.workers.len() + 1, &|i| {
+      set_cpu_affinity(i % cpus);
+    });
+  }
+
+}
+
+impl Drop for Pool {
+  fn drop(&mut self) {
+    self.shared.quit.store(true, Ordering::Release);
+    for worker in self.shared.workers.iter() {
+      let _todo = lock(&worker.todo);
+      worker.wake.notify_one();
+    }
+    for handle in self.handles.drain(..) {
+      handle.join().ok();
+    }
+  }
+}
+
+// Fewest items `par_map` gives a thread, below which spawning it costs more than it saves
+pub const PAR_MAP_CHUNK : usize = 256;
+
+// Maps `f` over `items`, splitting them in one contiguous chunk per cpu, each on a scoped thread,
+// and returns the results in the order of the items
+pub fn par_map<A: Sync, B: Send>(items: &[A], f: impl Fn(&A) -> B + Sync) -> Vec<B> {
+  let cpus = std::thread::available_parallelism().map(|x| x.get()).unwrap_or(1);
+  let size = std::cmp::max(PAR_MAP_CHUNK, (items.len() + cpus - 1) / cpus);
+  if items.len() <= size {
+    return items.iter().map(f).collect();
+  }
+  let f = &f;
+  return std::thread::scope(|s| {
+    let parts = items.chunks(size).map(|chunk| s.spawn(move || chunk.iter().map(f).collect::<Vec<B>>())).collect::<Vec<_>>();
+    parts.into_iter().flat_map(|part| part.join().unwrap()).collect()
+  });
+}
+
+// A lock is poisoned when `run` unwinds while waiting; as jobs never run under the pool's locks,
+// what they guard is still consistent
+fn lock<T>(mutex: &Mutex<T>) -> MutexGuard<'_, T> {
+  return mutex.lock().unwrap_or_else(|e| e.into_inner());
+}
+
+fn pool_worker(shared: &PoolShared, index: usize) {
+  let worker = &shared.workers[index];
+  loop {
+    let task = {
+      let mut todo = lock(&worker.todo);
+      loop {
+        if let Some(task) = todo.take() {
+          break Some(task);
+        }
+        if shared.quit.load(Ordering::Acquire) {
+          break None;
+        }
+        todo = worker.wake.wait(todo).unwrap_or_else(|e| e.into_inner());
+      }
+    };
+    match task {
+      Some((job, i)) => {
+        if let Err(payload) = catch_unwind(AssertUnwindSafe(|| job(i))) {
+          lock(&shared.fail).get_or_insert(payload);
+        }
+        let mut left = lock(&shared.left);
+        *left -= 1;
+        if *left == 0 {
+          shared.done.notify_one();
+        }
+      }
+      None => {
+        return;
+      }
+    }
+  }
+}
+
+// Restricts the calling thread to a single cpu. Only supported on Linux; a no-op elsewhere.
+#[cfg(target_os = "linux")]
+pub fn set_cpu_affinity(cpu: usize) {
+  unsafe {
+    let mut set : libc::cpu_set_t = std::mem::zeroed();
+    libc::CPU_SET(cpu, &mut set);
+    libc::sched_setaffinity(0, std::mem::size_of::<libc::cpu_set_t>(), &set);
+  }
+}
+
+#[cfg(not(target_os = "linux"))]
+pub fn set_cpu_affinity(cpu: usize) {}
+
+#[cfg(test)]
+mod tests {
+  use super::Pool;
+  use std::sync::atomic::{AtomicUsize, Ordering};
+
+  #[test]
+  fn test_pool_passes_panics_on() {
+    let pool = Pool::new(4);
+    let done = AtomicUsize::new(0);
+    // A worker's panic reaches the caller, after the other jobs finished
+    let res = std::panic::catch_unwind(std::panic::AssertUnwindSafe(|| pool.run(4, &|i| {
+      if i == 2 {
+        panic!("job {}", i);
+      }
+      done.fetch_add(1, Ordering::SeqCst);
+    })));
+    assert!(res.is_err());
+    assert_eq!(done.load(Ordering::SeqCst), 3);
+    // So does the caller's, which waits for the workers before unwinding
+    let res = std::panic::catch_unwind(std::panic::AssertUnwindSafe(|| pool.run(4, &|i| {
+      if i == 0 {
+        panic!("job {}", i);
+      }
+      std::thread::sleep(std::time::Duration::from_millis(10));
+      done.fetch_add(1, Ordering::SeqCst);
+    })));
+    assert!(res.is_err());
+    assert_eq!(done.load(Ordering::SeqCst), 6);
+    // And the pool is still usable
+    pool.run(4, &|i| {
+      done.fetch_add(1, Ordering::SeqCst);
+    });
+    assert_eq!(done.load(Ordering::SeqCst), 10);
+    assert!(!pool.busy.load(Ordering::SeqCst));
+  }
+}
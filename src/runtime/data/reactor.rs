@@ -0,0 +1,235 @@
+// Reactor
+// -------
+// Performs the IO of effects off the reducer threads, so that a term waiting on a file, a timer or
+// stdin doesn't hold a core that could be reducing something else. Blocking calls run on a few IO
+// threads, and sleeps wait on a single timer thread, ordered by deadline, so that any number of
+// concurrent sleeps take no thread of their own. Each submitted effect gets a slot, which holds its
+// result once it completes. A reducer that needs the result before it's in parks the waiting task
+// on the slot with an id of its own (a redex index), which `next_ready` hands back on completion.
+// The threads are only started by the first effect, and exit once the reactor is dropped.
+
+use std::cmp::Reverse;
+use std::collections::{BinaryHeap, HashMap};
+use std::io::{BufRead, Write};
+use std::sync::atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex, mpsc};
+use std::time::{Duration, Instant};
+
+pub const REACTOR_THREADS : usize = 4;
+
+pub enum Effect {
+  Sleep(u64),             // waits for some nanoseconds
+  Print(Vec<u8>),         // writes a line to stdout
+  Query,                  // reads a line from stdin
+  Store(String, Vec<u8>), // writes a file
+  Load(String),           // reads a file
+}
+
+pub enum EffectDone {
+  Unit,
+  Text(String),
+  Bytes(Vec<u8>),
+  Fail(String),
+}
+
+struct EffectSlot {
+  done: Option<EffectDone>,
+  wait: Option<u64>, // the task parked on it, if any
+}
+
+struct ReactorState {
+  slots: Mutex<HashMap<u64, EffectSlot>>,
+  ready: Mutex<Vec<u64>>, // parked tasks whose effects completed
+  count: AtomicUsize,     // the length of `ready`, read without locking
+  timer: Mutex<BinaryHeap<Reverse<(Instant, u64)>>>,
+  alarm: Condvar,
+  close: AtomicBool,
+}
+
+pub struct Reactor {
+  state: Arc<ReactorState>,
+  next: AtomicU64, // the next slot
+  jobs: Mutex<Option<mpsc::Sender<(u64, Effect)>>>, // the IO threads' queue, once started
+}
+
+// Performs an effect on the calling thread
+pub fn run_effect(effect: Effect) -> EffectDone {
+  match effect {
+    Effect::Sleep(nanos) => {
+      std::thread::sleep(Duration::from_nanos(nanos));
+      return EffectDone::Unit;
+    }
+    Effect::Print(text) => {
+      let mut out = std::io::stdout().lock();
+      out.write_all(&text).and_then(|_| out.write_all(b"\n")).ok();
+      return EffectDone::Unit;
+    }
+    Effect::Query => {
+      let mut input = String::new();
+      std::io::stdin().lock().read_line(&mut input).expect("string");
+      if let Some('\n') = input.chars().next_back() { input.pop(); }
+      if let Some('\r') = input.chars().next_back() { input.pop(); }
+      return EffectDone::Text(input);
+    }
+    Effect::Store(path, data) => {
+      match std::fs::write(&path, data) {
+        Ok(()) => EffectDone::Unit,
+        Err(err) => EffectDone::Fail(format!("can't write '{}': {}", path, err)),
+      }
+    }
+    Effect::Load(path) => {
+      match std::fs::read(&path) {
+        Ok(data) => EffectDone::Bytes(data),
+        Err(err) => EffectDone::Fail(format!("can't read '{}': {}", path, err)),
+      }
+    }
+  }
+}
+
+impl ReactorState {
+  fn complete(&self, slot: u64, done: EffectDone) {
+    let mut slots = self.slots.lock().unwrap();
+    if let Some(entry) = slots.get_mut(&slot) {
+      entry.done = Some(done);
+      if let Some(wait) = entry.wait.take() {
+        self.ready.lock().unwrap().push(wait);
+        self.count.fetch_add(1, Ordering::Release);
+      }
+    }
+  }
+
+  // Completes each sleep when its deadline passes
+  fn run_timer(&self) {
+    let mut timer = self.timer.lock().unwrap();
+    while !self.close.load(Ordering::Relaxed) {
+      match timer.peek() {
+        None => {
+          timer = self.alarm.wait(timer).unwrap();
+        }
+        Some(Reverse((time, slot))) => {
+          let (time, slot) = (*time, *slot);
+          let now = Instant::now();
+          if time <= now {
+            timer.pop();
+            self.complete(slot, EffectDone::Unit);
+          } else {
+            timer = self.alarm.wait_timeout(timer, time - now).unwrap().0;
+          }
+        }
+      }
+    }
+  }
+}
+
+impl Reactor {
+  pub fn new() -> Reactor {
+    let state = Arc::new(ReactorState {
+      slots: Mutex::new(HashMap::new()),
+      ready: Mutex::new(Vec::new()),
+      count: AtomicUsize::new(0),
+      timer: Mutex::new(BinaryHeap::new()),
+      alarm: Condvar::new(),
+      close: AtomicBool::new(false),
+    });
+    let next = AtomicU64::new(0);
+    let jobs = Mutex::new(None);
+    return Reactor { state, next, jobs };
+  }
+
+  // Starts performing an effect, returning its slot
+  pub fn submit(&self, effect: Effect) -> u64 {
+    let slot = self.next.fetch_add(1, Ordering::Relaxed);
+    self.state.slots.lock().unwrap().insert(slot, EffectSlot { done: None, wait: None });
+    let mut jobs = self.jobs.lock().unwrap();
+    if jobs.is_none() {
+      *jobs = Some(self.start());
+    }
+    if let Effect::Sleep(nanos) = effect {
+      let time = Instant::now() + Duration::from_nanos(nanos);
+      self.state.timer.lock().unwrap().push(Reverse((time, slot)));
+      self.state.alarm.notify_one();
+    } else {
+      jobs.as_ref().unwrap().send((slot, effect)).ok();
+    }
+    return slot;
+  }
+
+  fn start(&self) -> mpsc::Sender<(u64, Effect)> {
+    let (send, recv) = mpsc::channel::<(u64, Effect)>();
+    let recv = Arc::new(Mutex::new(recv));
+    for _ in 0 .. REACTOR_THREADS {
+      let state = Arc::clone(&self.state);
+      let recv = Arc::clone(&recv);
+      std::thread::spawn(move || {
+        loop {
+          let job = recv.lock().unwrap().recv();
+          match job {
+            Ok((slot, effect)) => state.complete(slot, run_effect(effect)),
+            Err(_) => break,
+          }
+        }
+      });
+    }
+    let state = Arc::clone(&self.state);
+    std::thread::spawn(move || state.run_timer());
+    return send;
+  }
+
+  // Whether an effect completed. Unknown slots count as completed, so they're never waited on.
+  pub fn is_done(&self, slot: u64) -> bool {
+    return self.state.slots.lock().unwrap().get(&slot).map_or(true, |entry| entry.done.is_some());
+  }
+
+  // Parks `wait` on an effect, to be returned by `next_ready` once it completes
+  pub fn park(&self, slot: u64, wait: u64) {
+    let mut slots = self.state.slots.lock().unwrap();
+    match slots.get_mut(&slot) {
+      Some(entry) if entry.done.is_none() => {
+        entry.wait = Some(wait);
+      }
+      _ => {
+        self.state.ready.lock().unwrap().push(wait);
+        self.state.count.fetch_add(1, Ordering::Release);
+      }
+    }
+  }
+
+  // Blocks until an effect completes, for reducers that can't park
+  pub fn wait(&self, slot: u64) {
+    while !self.is_done(slot) {
+      std::thread::sleep(Duration::from_micros(64));
+    }
+  }
+
+  // Removes a completed effect, returning its result
+  pub fn take(&self, slot: u64) -> Option<EffectDone> {
+    let mut slots = self.state.slots.lock().unwrap();
+    if slots.get(&slot).map_or(false, |entry| entry.done.is_some()) {
+      return slots.remove(&slot).unwrap().done;
+    }
+    return None;
+  }
+
+  // Pops a parked task whose effect completed
+  #[inline(always)]
+  pub fn next_ready(&self) -> Option<u64> {
+    if self.state.count.load(Ordering::Acquire) == 0 {
+      return None;
+    }
+    let wait = self.state.ready.lock().unwrap().pop();
+    if wait.is_some() {
+      self.state.count.fetch_sub(1, Ordering::Release);
+    }
+    return wait;
+  }
+}
+
+impl Drop for Reactor {
+  fn drop(&mut self) {
+    // Dropping the sender ends the IO threads, once their current effects are done
+    *self.jobs.lock().unwrap() = None;
+    let _timer = self.state.timer.lock().unwrap();
+    self.state.close.store(true, Ordering::Relaxed);
+    self.state.alarm.notify_all();
+  }
+}
@@ -1,22 +1,48 @@
 // Redex Bag
 // ---------
 // Concurrent bag featuring insert, read and modify. No pop.
+//
+// A cont is the index of a slot. The slots are split in blocks of REDEX_BLOCK slots, which threads
+// take from the bag one at a time, as they need them, so a thread with many pending redexes isn't
+// limited to a fixed part of the bag. The blocks a thread took, and the slots freed on them, form
+// its shard; the bag records the owner of each block, so any thread can complete any redex. A
+// completed slot is recycled: the owner pushes it on its local free list; other threads push it on
+// the owner's `back` list, which the owner takes as a whole when its own list runs out. Free slots
+// hold the next free slot, so the lists need no extra memory. The slots are reserved with MemMap,
+// and a thread only moves past its high-water mark when both lists are empty, so the memory
+// touched follows the largest number of redexes that were pending at once, rather than the bag's
+// size.
 
 use crossbeam::utils::{CachePadded};
-use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use crate::runtime::data::mem_map::{MemMap};
+use std::sync::atomic::{AtomicU64, Ordering};
 
 pub const REDEX_BAG_SIZE : usize = 1 << 26;
 pub const REDEX_CONT_RET : u64 = 0x3FFFFFF; // signals to return
 
+// Slots a thread takes from the bag at a time
+pub const REDEX_BLOCK : u64 = 1 << 14;
+
+// Ends a free list
+const REDEX_FREE_NIL : u64 = u64::MAX;
+
 // - 32 bits: host
 // - 26 bits: cont
 // -  6 bits: left
 pub type Redex = u64;
 
+pub struct RedexShard {
+  free: AtomicU64, // the first free slot, owner only
+  next: AtomicU64, // the high-water mark, on the last block taken, owner only
+  last: AtomicU64, // the end of that block, owner only
+  back: CachePadded<AtomicU64>, // the first slot freed by other threads
+}
+
 pub struct RedexBag {
-  tids: usize,
-  next: Box<[CachePadded<AtomicUsize>]>,
-  data: Box<[AtomicU64]>,
+  data: MemMap<AtomicU64>,
+  owns: Box<[AtomicU64]>, // the thread that took each block
+  used: AtomicU64, // number of blocks taken
+  shard: Box<[CachePadded<RedexShard>]>,
 }
 
 pub fn new_redex(host: u64, cont: u64, left: u64) -> Redex {
@@ -37,41 +63,100 @@ pub fn get_redex_left(redex: Redex) -> u64 {
 
 impl RedexBag {
   pub fn new(tids: usize) -> RedexBag {
-    let mut next = vec![];
+    let mut shard = vec![];
     for _ in 0 .. tids {
-      next.push(CachePadded::new(AtomicUsize::new(0)));
+      shard.push(CachePadded::new(RedexShard {
+        free: AtomicU64::new(REDEX_FREE_NIL),
+        next: AtomicU64::new(0),
+        last: AtomicU64::new(0),
+        back: CachePadded::new(AtomicU64::new(REDEX_FREE_NIL)),
+      }));
     }
-    let next = next.into_boxed_slice();
-    let data = crate::runtime::new_atomic_u64_array(REDEX_BAG_SIZE);
-    return RedexBag { tids, next, data };
+    let data = MemMap::new(REDEX_BAG_SIZE);
+    let owns = (0 .. REDEX_BAG_SIZE as u64 / REDEX_BLOCK).map(|_| AtomicU64::new(0)).collect();
+    let used = AtomicU64::new(0);
+    let shard = shard.into_boxed_slice();
+    return RedexBag { data, owns, used, shard };
   }
 
-  //pub fn min_index(&self, tid: usize) -> usize {
-    //return REDEX_BAG_SIZE / self.tids * (tid + 0);
-  //}
-
-  //pub fn max_index(&self, tid: usize) -> usize {
-    //return std::cmp::min(REDEX_BAG_SIZE / self.tids * (tid + 1), REDEX_CONT_RET as usize - 1);
-  //}
+  // Takes a free slot of `tid`'s shard, which only `tid` may call
+  #[inline(always)]
+  fn take(&self, tid: usize) -> u64 {
+    let shard = unsafe { self.shard.get_unchecked(tid) };
+    unsafe {
+      let free = &mut *shard.free.as_mut_ptr();
+      if *free == REDEX_FREE_NIL {
+        *free = shard.back.swap(REDEX_FREE_NIL, Ordering::Acquire);
+      }
+      if *free != REDEX_FREE_NIL {
+        let slot = *free;
+        *free = self.data.get_unchecked(slot as usize).load(Ordering::Relaxed);
+        return slot;
+      }
+      let next = &mut *shard.next.as_mut_ptr();
+      let last = &mut *shard.last.as_mut_ptr();
+      if *next >= *last {
+        let block = self.used.fetch_add(1, Ordering::Relaxed);
+        if block >= self.owns.len() as u64 {
+          panic!("redex bag is full ({} pending redexes)", REDEX_CONT_RET);
+        }
+        self.owns.get_unchecked(block as usize).store(tid as u64, Ordering::Relaxed);
+        *next = block * REDEX_BLOCK;
+        // The bag's last slot is left out, so that no cont is REDEX_CONT_RET
+        *last = std::cmp::min((block + 1) * REDEX_BLOCK, REDEX_CONT_RET);
+      }
+      *next += 1;
+      return *next - 1;
+    }
+  }
 
+  // Returns a slot to the shard it belongs to
   #[inline(always)]
-  pub fn insert(&self, tid: usize, redex: u64) -> u64 {
-    loop {
-      let index = unsafe { self.next.get_unchecked(tid) }.fetch_add(1, Ordering::Relaxed);
-      if index + 2 >= REDEX_BAG_SIZE { 
-        unsafe { self.next.get_unchecked(tid) }.store(0, Ordering::Relaxed);
+  fn give(&self, tid: usize, slot: u64) {
+    let owner = unsafe { self.owns.get_unchecked((slot / REDEX_BLOCK) as usize) }.load(Ordering::Relaxed) as usize;
+    let shard = unsafe { self.shard.get_unchecked(owner) };
+    let cell = unsafe { self.data.get_unchecked(slot as usize) };
+    if owner == tid {
+      unsafe {
+        let free = &mut *shard.free.as_mut_ptr();
+        cell.store(*free, Ordering::Relaxed);
+        *free = slot;
       }
-      if unsafe { self.data.get_unchecked(index) }.compare_exchange_weak(0, redex, Ordering::Relaxed, Ordering::Relaxed).is_ok() {
-        return index as u64;
+    } else {
+      let mut back = shard.back.load(Ordering::Relaxed);
+      loop {
+        cell.store(back, Ordering::Relaxed);
+        match shard.back.compare_exchange_weak(back, slot, Ordering::Release, Ordering::Relaxed) {
+          Ok(_) => {
+            return;
+          }
+          Err(actual) => {
+            back = actual;
+          }
+        }
       }
     }
   }
 
   #[inline(always)]
-  pub fn complete(&self, index: u64) -> Option<(u64,u64)> {
+  pub fn insert(&self, tid: usize, redex: u64) -> u64 {
+    let slot = self.take(tid);
+    unsafe { self.data.get_unchecked(slot as usize) }.store(redex, Ordering::Relaxed);
+    return slot;
+  }
+
+  // Reads a redex without completing it, for samplers. It may have completed since its cont was
+  // taken, and its slot been given to another redex, or hold a free list link.
+  pub fn peek(&self, index: u64) -> Option<Redex> {
+    return self.data.get(index as usize).map(|cell| cell.load(Ordering::Relaxed));
+  }
+
+  // Called by thread `tid` when one of the redex's arguments is done
+  #[inline(always)]
+  pub fn complete(&self, tid: usize, index: u64) -> Option<(u64,u64)> {
     let redex = unsafe { self.data.get_unchecked(index as usize) }.fetch_sub(1, Ordering::Relaxed);
     if get_redex_left(redex) == 1 {
-      unsafe { self.data.get_unchecked(index as usize) }.store(0, Ordering::Relaxed);
+      self.give(tid, index);
       return Some((get_redex_cont(redex), get_redex_host(redex)));
     } else {
       return None;
@@ -79,3 +164,25 @@ impl RedexBag {
   }
 }
 
+#[cfg(test)]
+mod tests {
+  use super::*;
+
+  #[test]
+  fn test_redex_bag_lends_blocks_to_busy_threads() {
+    let tids = 64;
+    let bag = RedexBag::new(tids);
+    // Thread 0 holds more redexes than an even split of the bag would give it
+    let count = (REDEX_BAG_SIZE / tids) as u64 + 1;
+    let conts = (0 .. count).map(|i| bag.insert(0, new_redex(i, REDEX_CONT_RET, 1))).collect::<Vec<u64>>();
+    let used = bag.used.load(Ordering::Relaxed);
+    // Another thread completes them, and they go back to thread 0's shard
+    for (i, cont) in conts.iter().enumerate() {
+      assert_eq!(bag.complete(1, *cont), Some((REDEX_CONT_RET, i as u64)));
+    }
+    for i in 0 .. count {
+      bag.insert(0, new_redex(i, REDEX_CONT_RET, 1));
+    }
+    assert_eq!(bag.used.load(Ordering::Relaxed), used);
+  }
+}
@@ -0,0 +1,95 @@
+// Victims
+// -------
+// The order in which an idle thread visits the queues of other threads when trying to steal work.
+// Starting every thief at the same victim makes all them hammer the same `VisitQueue::init`.
+// - RoundRobin: starts at `tid + 1` and wraps around.
+// - Random: starts at a random victim, drawn by a per-thread xorshift.
+// - Socket: visits threads of the same NUMA node (or CPU socket, if the OS doesn't report nodes)
+//   before the others, round robin within each, so that stolen work is on memory close by.
+// Thread `tid` is assumed to run on cpu `tid % cpus`, which is what pinned workers do.
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum StealMode {
+  RoundRobin,
+  Random,
+  Socket,
+}
+
+pub struct Victims {
+  pub mode: StealMode,
+  pub list: Vec<usize>, // other tids, in visiting order
+  pub init: usize,      // where the current round starts
+  pub seed: u64,        // xorshift state
+}
+
+impl Victims {
+
+  pub fn new(mode: StealMode, tids: &[usize], tid: usize) -> Victims {
+    let this = tids.iter().position(|x| *x == tid).unwrap_or(0);
+    let mut list = vec![];
+    for i in 1 .. tids.len() {
+      list.push(tids[(this + i) % tids.len()]);
+    }
+    if mode == StealMode::Socket {
+      let nodes = cpu_nodes();
+      let here = nodes[tid % nodes.len()];
+      // Stable sort: keeps the round robin order inside each group
+      list.sort_by_key(|victim| if nodes[*victim % nodes.len()] == here { 0 } else { 1 });
+    }
+    let seed = 0x9E3779B97F4A7C15 ^ ((tid as u64 + 1) << 17);
+    return Victims { mode, list, init: 0, seed };
+  }
+
+  // Starts a new stealing round
+  pub fn next_round(&mut self) {
+    if self.mode == StealMode::Random && self.list.len() > 0 {
+      self.seed ^= self.seed << 13;
+      self.seed ^= self.seed >> 7;
+      self.seed ^= self.seed << 17;
+      self.init = (self.seed % self.list.len() as u64) as usize;
+    }
+  }
+
+  pub fn len(&self) -> usize {
+    return self.list.len();
+  }
+
+  // The i-th victim of the current round
+  #[inline(always)]
+  pub fn get(&self, i: usize) -> usize {
+    return unsafe { *self.list.get_unchecked((self.init + i) % self.list.len()) };
+  }
+
+}
+
+// The NUMA node of each cpu, read once, since reductions build their victim lists every time
+pub fn cpu_nodes() -> &'static [usize] {
+  static NODES : std::sync::OnceLock<Vec<usize>> = std::sync::OnceLock::new();
+  return NODES.get_or_init(|| {
+    let cpus = std::thread::available_parallelism().map(|x| x.get()).unwrap_or(1);
+    return (0 .. cpus).map(cpu_node).collect();
+  });
+}
+
+// The NUMA node of a cpu, as reported by the OS, or its socket if nodes aren't. Defaults to 0.
+pub fn cpu_node(cpu: usize) -> usize {
+  if let Ok(dir) = std::fs::read_dir(format!("/sys/devices/system/cpu/cpu{}", cpu)) {
+    for entry in dir.flatten() {
+      if let Some(node) = entry.file_name().to_str().and_then(|name| name.strip_prefix("node")).and_then(|id| id.parse::<usize>().ok()) {
+        return node;
+      }
+    }
+  }
+  return cpu_socket(cpu);
+}
+
+// The socket of a cpu, as reported by the OS. Defaults to 0 when unknown.
+pub fn cpu_socket(cpu: usize) -> usize {
+  let path = format!("/sys/devices/system/cpu/cpu{}/topology/physical_package_id", cpu);
+  if let Ok(text) = std::fs::read_to_string(path) {
+    if let Ok(socket) = text.trim().parse::<usize>() {
+      return socket;
+    }
+  }
+  return 0;
+}
@@ -1,20 +1,34 @@
 // Visit Queue
 // -----------
-// A concurrent task-stealing queue featuring push, pop and steal.
+// A concurrent task-stealing queue featuring push, pop and steal. It is a Chase-Lev deque: the
+// owner thread pushes and pops at the bottom (`last`), thieves steal from the top (`init`). Only
+// the last element requires a CAS by the owner. The storage is a circular buffer which doubles
+// when full; retired buffers are kept alive until the queue is dropped, since a thief may still be
+// reading an old one. Buffers are committed lazily (see `mem_map.rs`), so that their pages are
+// placed near the owner, which touches them first, rather than near the thread that made the heap.
 
+use crate::runtime::data::mem_map::{MemMap};
+use std::sync::atomic::{fence, AtomicPtr, AtomicUsize, AtomicU64, Ordering};
+use std::sync::Mutex;
 use crossbeam::utils::{CachePadded};
-use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
 
-pub const VISIT_QUEUE_SIZE : usize = 1 << 24;
+pub const VISIT_QUEUE_INIT_SIZE : usize = 1 << 12;
+pub const VISIT_QUEUE_STEAL_MAX : usize = 1 << 8;
 
 // - 32 bits: host
 // - 32 bits: cont
 pub type Visit = u64;
 
+pub struct VisitBuffer {
+  pub mask: usize,
+  pub data: MemMap<AtomicU64>,
+}
+
 pub struct VisitQueue {
   pub init: CachePadded<AtomicUsize>,
   pub last: CachePadded<AtomicUsize>,
-  pub data: Box<[AtomicU64]>,
+  pub data: AtomicPtr<VisitBuffer>,
+  pub olds: Mutex<Vec<Box<VisitBuffer>>>,
 }
 
 pub fn new_visit(host: u64, hold: bool, cont: u64) -> Visit {
@@ -26,58 +40,202 @@ pub fn get_visit_host(visit: Visit) -> u64 {
 }
 
 pub fn get_visit_hold(visit: Visit) -> bool {
-  return (visit >> 31) & 1 == 1; 
+  return (visit >> 31) & 1 == 1;
 }
 
 pub fn get_visit_cont(visit: Visit) -> u64 {
   return visit & 0x3FFFFFF;
 }
 
+impl VisitBuffer {
+
+  pub fn new(size: usize) -> Box<VisitBuffer> {
+    return Box::new(VisitBuffer {
+      mask: size - 1,
+      data: MemMap::new(size),
+    });
+  }
+
+  #[inline(always)]
+  pub fn get(&self, index: usize) -> u64 {
+    return unsafe { self.data.get_unchecked(index & self.mask) }.load(Ordering::Relaxed);
+  }
+
+  #[inline(always)]
+  pub fn set(&self, index: usize, value: u64) {
+    unsafe { self.data.get_unchecked(index & self.mask) }.store(value, Ordering::Relaxed);
+  }
+
+}
+
 impl VisitQueue {
 
   pub fn new() -> VisitQueue {
     return VisitQueue {
       init: CachePadded::new(AtomicUsize::new(0)),
       last: CachePadded::new(AtomicUsize::new(0)),
-      data: crate::runtime::new_atomic_u64_array(VISIT_QUEUE_SIZE),
+      data: AtomicPtr::new(Box::into_raw(VisitBuffer::new(VISIT_QUEUE_INIT_SIZE))),
+      olds: Mutex::new(vec![]),
     }
   }
 
+  // Number of visits on the queue (approximate when read by a thief)
+  pub fn len(&self) -> usize {
+    let init = self.init.load(Ordering::Relaxed);
+    let last = self.last.load(Ordering::Relaxed);
+    return last.saturating_sub(init);
+  }
+
+  // Owner only
   pub fn push(&self, value: u64) {
-    let index = self.last.fetch_add(1, Ordering::Relaxed);
-    unsafe { self.data.get_unchecked(index) }.store(value, Ordering::Relaxed);
+    let last = self.last.load(Ordering::Relaxed);
+    let init = self.init.load(Ordering::Acquire);
+    let mut data = unsafe { &*self.data.load(Ordering::Relaxed) };
+    if last - init > data.mask {
+      data = self.grow(init, last);
+    }
+    data.set(last, value);
+    self.last.store(last + 1, Ordering::Release);
   }
 
+  // Owner only: moves the live range to a buffer twice as large
+  #[cold]
+  fn grow(&self, init: usize, last: usize) -> &VisitBuffer {
+    let old_data = self.data.load(Ordering::Relaxed);
+    let new_data = VisitBuffer::new((unsafe { &*old_data }.mask + 1) * 2);
+    for index in init .. last {
+      new_data.set(index, unsafe { &*old_data }.get(index));
+    }
+    let new_data = Box::into_raw(new_data);
+    self.data.store(new_data, Ordering::Release);
+    self.olds.lock().unwrap().push(unsafe { Box::from_raw(old_data) });
+    return unsafe { &*new_data };
+  }
+
+  // Owner only
   #[inline(always)]
   pub fn pop(&self) -> Option<(u64, u64)> {
-    loop {
-      let last = self.last.load(Ordering::Relaxed);
-      if last > 0 {
-        self.last.fetch_sub(1, Ordering::Relaxed);
-        self.init.fetch_min(last - 1, Ordering::Relaxed);
-        let visit = unsafe { self.data.get_unchecked(last - 1) }.swap(0, Ordering::Relaxed);
-        if visit == 0 {
-          continue;
-        } else {
-          return Some((get_visit_cont(visit), get_visit_host(visit)));
-        }
-      } else {
-        return None;
+    let last = self.last.load(Ordering::Relaxed);
+    if self.init.load(Ordering::Relaxed) >= last {
+      return None;
+    }
+    let last = last - 1;
+    self.last.store(last, Ordering::Relaxed);
+    fence(Ordering::SeqCst);
+    let init = self.init.load(Ordering::Relaxed);
+    if init < last {
+      let visit = unsafe { &*self.data.load(Ordering::Relaxed) }.get(last);
+      return Some((get_visit_cont(visit), get_visit_host(visit)));
+    }
+    // Last element: races against thieves
+    let mut got = None;
+    if init == last {
+      let visit = unsafe { &*self.data.load(Ordering::Relaxed) }.get(last);
+      if self.init.compare_exchange(init, init + 1, Ordering::SeqCst, Ordering::Relaxed).is_ok() {
+        got = Some((get_visit_cont(visit), get_visit_host(visit)));
       }
     }
+    self.last.store(last + 1, Ordering::Relaxed);
+    return got;
   }
 
   #[inline(always)]
   pub fn steal(&self) -> Option<(u64, u64)> {
-    let index = self.init.load(Ordering::Relaxed);
-    let visit = unsafe { self.data.get_unchecked(index) }.load(Ordering::Relaxed);
-    if visit != 0 && !get_visit_hold(visit) {
-      if let Ok(visit) = unsafe { self.data.get_unchecked(index) }.compare_exchange(visit, 0, Ordering::Relaxed, Ordering::Relaxed) {
-        self.init.fetch_add(1, Ordering::Relaxed);
-        return Some((get_visit_cont(visit), get_visit_host(visit)));
+    let init = self.init.load(Ordering::Acquire);
+    fence(Ordering::SeqCst);
+    let last = self.last.load(Ordering::Acquire);
+    if init < last {
+      let visit = unsafe { &*self.data.load(Ordering::Acquire) }.get(init);
+      if !get_visit_hold(visit) {
+        if self.init.compare_exchange(init, init + 1, Ordering::SeqCst, Ordering::Relaxed).is_ok() {
+          return Some((get_visit_cont(visit), get_visit_host(visit)));
+        }
       }
     }
     return None;
   }
 
+  // Steals up to half of the visits of this queue. The oldest one is returned, and the others are
+  // pushed to `dest`, which must be owned by the calling thread, so that they're popped oldest first.
+  pub fn steal_batch(&self, dest: &VisitQueue) -> Option<(u64, u64)> {
+    let got = self.steal();
+    if got.is_some() {
+      let mut batch = [0; VISIT_QUEUE_STEAL_MAX];
+      let mut count = 0;
+      let limit = std::cmp::min(self.len() / 2, VISIT_QUEUE_STEAL_MAX);
+      while count < limit {
+        if let Some((cont, host)) = self.steal() {
+          batch[count] = new_visit(host, false, cont);
+          count += 1;
+        } else {
+          break;
+        }
+      }
+      for i in (0 .. count).rev() {
+        dest.push(batch[i]);
+      }
+    }
+    return got;
+  }
+
+}
+
+impl Drop for VisitQueue {
+  fn drop(&mut self) {
+    unsafe { drop(Box::from_raw(self.data.load(Ordering::Relaxed))) };
+  }
+}
+
+#[cfg(test)]
+mod tests {
+  use super::*;
+  use std::sync::atomic::AtomicBool;
+
+  // The owner pushes past the initial size, so that the buffer grows while thieves read it, and
+  // pops some visits back; thieves steal one at a time or in batches. Every visit must come out once.
+  #[test]
+  fn test_visit_queue_gives_each_visit_once() {
+    let count = VISIT_QUEUE_INIT_SIZE as u64 * 16;
+    let queue = &VisitQueue::new();
+    let done = &AtomicBool::new(false);
+    let mut seen = std::thread::scope(|scope| {
+      let thieves = (0 .. 3).map(|thief| scope.spawn(move || {
+        let own = VisitQueue::new();
+        let mut got = vec![];
+        loop {
+          let over = done.load(Ordering::Acquire);
+          let next = if thief == 0 { queue.steal() } else { queue.steal_batch(&own) };
+          match next {
+            Some((_, host)) => got.push(host),
+            None if over => break,
+            None => std::thread::yield_now(),
+          }
+          while let Some((_, host)) = own.pop() {
+            got.push(host);
+          }
+        }
+        return got;
+      })).collect::<Vec<_>>();
+      let mut got = vec![];
+      for host in 0 .. count {
+        queue.push(new_visit(host, false, host & 0xFFFF));
+        if host % 3 == 0 {
+          got.extend(queue.pop().map(|(_, host)| host));
+        }
+        if host % 1024 == 0 {
+          std::thread::yield_now();
+        }
+      }
+      while let Some((_, host)) = queue.pop() {
+        got.push(host);
+      }
+      done.store(true, Ordering::Release);
+      for thief in thieves {
+        got.extend(thief.join().unwrap());
+      }
+      return got;
+    });
+    seen.sort();
+    assert_eq!(seen, (0 .. count).collect::<Vec<u64>>());
+  }
 }
@@ -48,10 +48,10 @@ impl Runtime {
   /// Creates a new, empty runtime
   pub fn new(size: usize, tids: usize, dbug: bool) -> Runtime {
     Runtime {
-      heap: new_heap(size, tids),
+      heap: new_heap(size, tids, AllocMode::Scan),
       prog: Program::new(),
       book: language::rulebook::new_rulebook(),
-      tids: new_tids(size),
+      tids: new_tids(tids),
       dbug: dbug,
     }
   }
@@ -59,10 +59,11 @@ impl Runtime {
   /// Creates a runtime from source code, given a max number of nodes
   pub fn from_code_with(code: &str, size: usize, tids: usize, dbug: bool) -> Result<Runtime, String> {
     let file = language::syntax::read_file(code)?;
-    let heap = new_heap(size, tids);
-    let prog = Program::new();
+    let heap = new_heap(size, tids, AllocMode::Scan);
+    let mut prog = Program::new();
     let book = language::rulebook::gen_rulebook(&file);
-    let tids = new_tids(size);
+    prog.add_book(&book);
+    let tids = new_tids(tids);
     return Ok(Runtime { heap, prog, book, tids, dbug });
   }
 
@@ -91,6 +92,23 @@ impl Runtime {
     load_ptr(&self.heap, host)
   }
 
+  /// Pins the worker threads to cpus, one per thread
+  pub fn pin_threads(&self) {
+    self.heap.pool.pin();
+  }
+
+  /// Saves the heap to a snapshot file. Locations stay valid when it is loaded back.
+  pub fn save_snapshot(&self, path: &str) -> Result<(), String> {
+    save_snapshot(&self.heap, &self.prog, path)
+  }
+
+  /// Replaces the heap by the one saved on a snapshot file, which must have been taken from a
+  /// runtime defining the same functions
+  pub fn load_snapshot(&mut self, path: &str) -> Result<(), String> {
+    self.heap = load_snapshot(&self.prog, path, get_heap_end(&self.heap), self.heap.tids)?;
+    Ok(())
+  }
+
   /// Given a location, evaluates a term to head normal form
   pub fn reduce(&mut self, host: u64) {
     reduce(&self.heap, &self.prog, &self.tids, host, false, self.dbug);
@@ -101,6 +119,12 @@ impl Runtime {
     reduce(&self.heap, &self.prog, &self.tids, host, true, self.dbug);
   }
 
+  /// Frees every node that isn't reachable from the given locations, including the cyclic dups
+  /// that aren't freed as they're reduced. Returns how many cells were freed.
+  pub fn collect_garbage(&mut self, hosts: &[u64]) -> u64 {
+    collect_garbage(&self.heap, &self.prog, &self.tids, hosts)
+  }
+
   /// Evaluates a code, allocs and evaluates to full normal form. Returns its location.
   pub fn normalize_code(&mut self, code: &str) -> u64 {
     let host = self.alloc_code(code).ok().unwrap();
@@ -130,6 +154,11 @@ impl Runtime {
     language::readback::as_code(&self.heap, &self.prog, host)
   }
 
+  /// Given a location, writes the Term stored on it to `out`, without building it first, on all threads
+  pub fn write(&self, host: u64, format: language::readback::ReadbackFormat, out: &mut dyn std::io::Write) -> std::io::Result<()> {
+    language::readback::write_term_par(&self.heap, &self.prog, &self.tids, host, format, out)
+  }
+
   /// Given a location, recovers the linear Term stored on it, as code
   pub fn show_linear(&self, host: u64) -> String {
     language::readback::as_linear_code(&self.heap, &self.prog, host)
@@ -382,6 +411,23 @@ impl Runtime {
     alloc_term(&self.heap, &self.prog, 0, &self.book, term) // FIXME tid?
   }
 
+  /// Evaluates many terms to normal form, allocated on the same heap and reduced at once, as
+  /// separate tasks. Each normal form is then read back and freed, on the thread pool.
+  pub fn eval_batch(&mut self, terms: &[language::syntax::Term]) -> Vec<String> {
+    let hosts = terms.iter().map(|term| self.alloc_term(term)).collect::<Vec<u64>>();
+    normalize_roots(&self.heap, &self.prog, &self.tids, &hosts, self.dbug);
+    let (heap, prog, tids) = (&self.heap, &self.prog, &self.tids);
+    let done = hosts.iter().map(|_| std::sync::Mutex::new(String::new())).collect::<Vec<_>>();
+    heap.pool.run(tids.len(), &|i| {
+      for (host, code) in hosts.iter().zip(&done).skip(i).step_by(tids.len()) {
+        *code.lock().unwrap() = language::readback::as_code_streamed(heap, prog, *host);
+        collect(heap, &prog.aris, tids[i], load_ptr(heap, *host));
+        free(heap, tids[i], *host, 1);
+      }
+    });
+    return done.into_iter().map(|code| code.into_inner().unwrap()).collect();
+  }
+
   /// Given a location, recovers the Core stored on it
   pub fn readback(&self, host: u64) -> Box<language::syntax::Term> {
     language::readback::as_term(&self.heap, &self.prog, host)
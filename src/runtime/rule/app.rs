@@ -17,7 +17,7 @@ pub fn apply(ctx: ReduceCtx) -> bool {
   // x <- a
   // body
   if get_tag(arg0) == LAM {
-    inc_cost(ctx.heap, ctx.tid);
+    inc_rule_cost(ctx.heap, ctx.tid, PROF_APP_LAM);
     atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Var(get_loc(arg0, 0)), take_arg(ctx.heap, ctx.term, 1));
     link(ctx.heap, *ctx.host, take_arg(ctx.heap, arg0, 1));
     free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 2);
@@ -30,10 +30,10 @@ pub fn apply(ctx: ReduceCtx) -> bool {
   // dup x0 x1 = c
   // {(a x0) (b x1)}
   if get_tag(arg0) == SUP {
-    inc_cost(ctx.heap, ctx.tid);
+    inc_rule_cost(ctx.heap, ctx.tid, PROF_APP_SUP);
     let app0 = get_loc(ctx.term, 0);
     let app1 = get_loc(arg0, 0);
-    let let0 = alloc(ctx.heap, ctx.tid, 3);
+    let let0 = alloc_dup(ctx.heap, ctx.tid);
     let par0 = alloc(ctx.heap, ctx.tid, 2);
     link(ctx.heap, let0 + 2, take_arg(ctx.heap, ctx.term, 1));
     link(ctx.heap, app0 + 1, Dp0(get_ext(arg0), let0));
@@ -21,8 +21,8 @@ pub fn apply(ctx: ReduceCtx) -> bool {
   // s <- λx1(f1)
   // x <- {x0 x1}
   if get_tag(arg0) == LAM {
-    inc_cost(ctx.heap, ctx.tid);
-    let let0 = alloc(ctx.heap, ctx.tid, 3);
+    inc_rule_cost(ctx.heap, ctx.tid, PROF_DUP_LAM);
+    let let0 = alloc_dup(ctx.heap, ctx.tid);
     let par0 = alloc(ctx.heap, ctx.tid, 2);
     let lam0 = alloc(ctx.heap, ctx.tid, 2);
     let lam1 = alloc(ctx.heap, ctx.tid, 2);
@@ -36,7 +36,7 @@ pub fn apply(ctx: ReduceCtx) -> bool {
     atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp1(tcol, get_loc(ctx.term, 0)), Lam(lam1));
     let done = Lam(if get_tag(ctx.term) == DP0 { lam0 } else { lam1 });
     link(ctx.heap, *ctx.host, done);
-    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 3);
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 4);
     free(ctx.heap, ctx.tid, get_loc(arg0, 0), 2);
     return true;
   }
@@ -51,19 +51,19 @@ pub fn apply(ctx: ReduceCtx) -> bool {
   else if get_tag(arg0) == SUP {
 
     if tcol == get_ext(arg0) {
-      inc_cost(ctx.heap, ctx.tid);
+      inc_rule_cost(ctx.heap, ctx.tid, PROF_DUP_SUP_EQ);
       atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp0(tcol, get_loc(ctx.term, 0)), take_arg(ctx.heap, arg0, 0));
       atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp1(tcol, get_loc(ctx.term, 0)), take_arg(ctx.heap, arg0, 1));
-      free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 3);
+      free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 4);
       free(ctx.heap, ctx.tid, get_loc(arg0, 0), 2);
       return true;
 
     } else {
-      inc_cost(ctx.heap, ctx.tid);
+      inc_rule_cost(ctx.heap, ctx.tid, PROF_DUP_SUP_NE);
       let par0 = alloc(ctx.heap, ctx.tid, 2);
-      let let0 = alloc(ctx.heap, ctx.tid, 3);
+      let let0 = alloc_dup(ctx.heap, ctx.tid);
       let par1 = get_loc(arg0, 0);
-      let let1 = alloc(ctx.heap, ctx.tid, 3);
+      let let1 = alloc_dup(ctx.heap, ctx.tid);
       link(ctx.heap, let0 + 2, take_arg(ctx.heap, arg0, 0));
       link(ctx.heap, let1 + 2, take_arg(ctx.heap, arg0, 1));
       link(ctx.heap, par1 + 0, Dp1(tcol, let0));
@@ -72,7 +72,7 @@ pub fn apply(ctx: ReduceCtx) -> bool {
       link(ctx.heap, par0 + 1, Dp0(tcol, let1));
       atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp0(tcol, get_loc(ctx.term, 0)), Sup(get_ext(arg0), par0));
       atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp1(tcol, get_loc(ctx.term, 0)), Sup(get_ext(arg0), par1));
-      free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 3);
+      free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 4);
       return true;
     }
   }
@@ -83,10 +83,10 @@ pub fn apply(ctx: ReduceCtx) -> bool {
   // y <- N
   // ~
   else if get_tag(arg0) == U60 {
-    inc_cost(ctx.heap, ctx.tid);
+    inc_rule_cost(ctx.heap, ctx.tid, PROF_DUP_U60);
     atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp0(tcol, get_loc(ctx.term, 0)), arg0);
     atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp1(tcol, get_loc(ctx.term, 0)), arg0);
-    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 3);
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 4);
     return true;
   }
 
@@ -96,10 +96,24 @@ pub fn apply(ctx: ReduceCtx) -> bool {
   // y <- N
   // ~
   else if get_tag(arg0) == F60 {
-    inc_cost(ctx.heap, ctx.tid);
+    inc_rule_cost(ctx.heap, ctx.tid, PROF_DUP_F60);
     atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp0(tcol, get_loc(ctx.term, 0)), arg0);
     atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp1(tcol, get_loc(ctx.term, 0)), arg0);
-    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 3);
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 4);
+    return true;
+  }
+
+  // dup x y = B
+  // ----------- DUP-BUF
+  // x <- B
+  // y <- B' (a new node, sharing B's bytes)
+  // ~
+  else if get_tag(arg0) == BUF {
+    inc_rule_cost(ctx.heap, ctx.tid, PROF_DUP_BUF);
+    let arg1 = share_buffer(ctx.heap, ctx.tid, arg0);
+    atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp0(tcol, get_loc(ctx.term, 0)), arg0);
+    atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp1(tcol, get_loc(ctx.term, 0)), arg1);
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 4);
     return true;
   }
 
@@ -112,30 +126,30 @@ pub fn apply(ctx: ReduceCtx) -> bool {
   // x <- (K a0 b0 c0 ...)
   // y <- (K a1 b1 c1 ...)
   else if get_tag(arg0) == CTR {
-    inc_cost(ctx.heap, ctx.tid);
+    inc_rule_cost(ctx.heap, ctx.tid, PROF_DUP_CTR);
     let fnum = get_ext(arg0);
     let fari = arity_of(&ctx.prog.aris, arg0);
     if fari == 0 {
       atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp0(tcol, get_loc(ctx.term, 0)), Ctr(fnum, 0));
       atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp1(tcol, get_loc(ctx.term, 0)), Ctr(fnum, 0));
       link(ctx.heap, *ctx.host, Ctr(fnum, 0));
-      free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 3);
+      free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 4);
     } else {
       let ctr0 = get_loc(arg0, 0);
       let ctr1 = alloc(ctx.heap, ctx.tid, fari);
       for i in 0 .. fari - 1 {
-        let leti = alloc(ctx.heap, ctx.tid, 3);
+        let leti = alloc_dup(ctx.heap, ctx.tid);
         link(ctx.heap, leti + 2, take_arg(ctx.heap, arg0, i));
         link(ctx.heap, ctr0 + i, Dp0(get_ext(ctx.term), leti));
         link(ctx.heap, ctr1 + i, Dp1(get_ext(ctx.term), leti));
       }
-      let leti = alloc(ctx.heap, ctx.tid, 3);
+      let leti = alloc_dup(ctx.heap, ctx.tid);
       link(ctx.heap, leti + 2, take_arg(ctx.heap, arg0, fari - 1));
       link(ctx.heap, ctr0 + fari - 1, Dp0(get_ext(ctx.term), leti));
       link(ctx.heap, ctr1 + fari - 1, Dp1(get_ext(ctx.term), leti));
       atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp0(tcol, get_loc(ctx.term, 0)), Ctr(fnum, ctr0));
       atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp1(tcol, get_loc(ctx.term, 0)), Ctr(fnum, ctr1));
-      free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 3);
+      free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 4);
     }
     return true;
   }
@@ -145,11 +159,11 @@ pub fn apply(ctx: ReduceCtx) -> bool {
   // x <- *
   // y <- *
   else if get_tag(arg0) == ERA {
-    inc_cost(ctx.heap, ctx.tid);
+    inc_rule_cost(ctx.heap, ctx.tid, PROF_DUP_ERA);
     atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp0(tcol, get_loc(ctx.term, 0)), Era());
     atomic_subst(ctx.heap, &ctx.prog.aris, ctx.tid, Dp1(tcol, get_loc(ctx.term, 0)), Era());
     link(ctx.heap, *ctx.host, Era());
-    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 3);
+    free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), 4);
     return true;
   }
 
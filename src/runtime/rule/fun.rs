@@ -48,15 +48,122 @@ pub fn visit(ctx: ReduceCtx, sidxs: &[u64]) -> bool {
 
 #[inline(always)]
 pub fn apply(ctx: ReduceCtx, fid: u64, visit: &VisitObj, apply: &ApplyObj) -> bool {
-  // Reduces function superpositions
+  // A memoized function has no arguments, and a single rule that always matches
+  if apply.memo && (fid as usize) < MEMO_MAX_FIDS {
+    inc_rule_cost(ctx.heap, ctx.tid, PROF_FUN_CTR);
+    prof_rule(ctx.heap, ctx.tid, fid, 0);
+    memo_call(ctx.heap, ctx.prog, ctx.tid, *ctx.host, fid, ctx.term, unsafe { apply.rules.get_unchecked(0) });
+    return true;
+  }
+
+  // Reduces function superpositions, and unpacks the first character of matched buffers
   for (n, is_strict) in visit.strict_map.iter().enumerate() {
     let n = n as u64;
-    if *is_strict && get_tag(load_arg(ctx.heap, ctx.term, n)) == SUP {
-      superpose(ctx.heap, &ctx.prog.aris, ctx.tid, *ctx.host, ctx.term, load_arg(ctx.heap, ctx.term, n), n);
-      return true;
+    if *is_strict {
+      match get_tag(load_arg(ctx.heap, ctx.term, n)) {
+        SUP => {
+          superpose(ctx.heap, &ctx.prog.aris, ctx.tid, *ctx.host, ctx.term, load_arg(ctx.heap, ctx.term, n), n);
+          return true;
+        }
+        BUF => {
+          unpack_buffer(ctx.heap, ctx.tid, get_loc(ctx.term, n));
+        }
+        _ => {}
+      }
+    }
+  }
+
+  // Finds the first matching rule and builds its right-hand side, over the matched nodes when
+  // their sizes fit (freeing the others), with the function's machine code if it was lowered
+  let found = match &apply.jit {
+    Some(code) => code.apply(ctx.heap, ctx.tid, ctx.term),
+    None => {
+      let found = match &apply.tree {
+        Some(tree) => match_tree(ctx.heap, ctx.term, tree),
+        None => match_rules(ctx.heap, ctx.prog, ctx.term, visit, apply),
+      };
+      found.map(|r| (r, alloc_rule_body(ctx.heap, ctx.prog, ctx.tid, ctx.term, unsafe { apply.rules.get_unchecked(r) })))
+    }
+  };
+
+  // If a rule matched, we must apply it
+  if let Some((r, done)) = found {
+    let rule = unsafe { apply.rules.get_unchecked(r) };
+
+    // Increments the gas count
+    inc_rule_cost(ctx.heap, ctx.tid, PROF_FUN_CTR);
+    prof_rule(ctx.heap, ctx.tid, fid, r);
+
+    // Links the *ctx.host location to it
+    link(ctx.heap, *ctx.host, done);
+
+    // Collects unused variables
+    for (index, RuleVar { param: _, field: _, erase }) in rule.vars.iter().enumerate() {
+      if *erase {
+        collect(ctx.heap, &ctx.prog.aris, ctx.tid, get_rule_var(ctx.heap, ctx.tid, rule, index));
+      }
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+// Memoized Calls
+// --------------
+// The value of a memoized function (see `gen_memo_functions`) is built once per heap, on a memo
+// cell, and every call duplicates it from there: `(F)` becomes `dup a b = <cell>`, which returns `a`
+// and leaves `b` on the cell, for the next call. So the value is only reduced once, on its first
+// use, and the usual DUP rules copy it lazily, as far as each call reads it. The new dup stays
+// locked until it is complete, since the next call can reach it through the cell before that.
+
+pub fn memo_call(heap: &Heap, prog: &Program, tid: usize, host: u64, fid: u64, term: Ptr, rule: &Rule) {
+  let cell = heap.memo.get_or_make(fid, || {
+    let cell = alloc(heap, tid, 1);
+    link(heap, cell, alloc_body(heap, prog, tid, term, &[], &rule.body));
+    cell
+  });
+  let dupc = gen_dup(heap, tid);
+  let loc = alloc(heap, tid, 4);
+  let lock = unsafe { heap.node.get_unchecked((loc + 3) as usize) };
+  lock.store(Lck(tid as u64 + 1), Ordering::Relaxed);
+  link(heap, host, Dp0(dupc, loc));
+  link(heap, loc + 1, Arg(cell));
+  // Another thread may be substituting a variable on the cell, so its old value is swapped out
+  let old = unsafe { heap.node.get_unchecked(cell as usize) }.swap(Dp1(dupc, loc), Ordering::Relaxed);
+  link(heap, loc + 2, old);
+  lock.store(LOCK_OPEN, Ordering::Release);
+}
+
+// Walks a function's match tree (see `build_match_tree`), returning the index of the matching rule
+#[inline(always)]
+pub fn match_tree(heap: &Heap, term: Ptr, tree: &[MatchNode]) -> Option<usize> {
+  let mut node = 0;
+  loop {
+    match unsafe { tree.get_unchecked(node) } {
+      MatchNode::Switch { arg, cases, other } => {
+        let arg = load_arg(heap, term, *arg);
+        let tag = get_tag(arg);
+        if tag != CTR && tag != U60 && tag != F60 {
+          return None;
+        }
+        let key = match_key(arg);
+        node = match cases.binary_search_by_key(&key, |case| case.0) {
+          Ok(i) => unsafe { cases.get_unchecked(i).1 },
+          Err(_) => *other,
+        };
+      }
+      MatchNode::Leaf { rule } => {
+        return *rule;
+      }
     }
   }
+}
 
+// Tests each rule in order, returning the index of the first that matches
+#[inline(always)]
+pub fn match_rules(heap: &Heap, prog: &Program, term: Ptr, visit: &VisitObj, apply: &ApplyObj) -> Option<usize> {
   // For each rule condition vector
   let mut matched;
   for (r, rule) in apply.rules.iter().enumerate() {
@@ -68,18 +175,18 @@ pub fn apply(ctx: ReduceCtx, fid: u64, visit: &VisitObj, apply: &ApplyObj) -> bo
       let i = i as u64;
       match get_tag(*cond) {
         U60 => {
-          let same_tag = get_tag(load_arg(ctx.heap, ctx.term, i)) == U60;
-          let same_val = get_num(load_arg(ctx.heap, ctx.term, i)) == get_num(*cond);
+          let same_tag = get_tag(load_arg(heap, term, i)) == U60;
+          let same_val = get_num(load_arg(heap, term, i)) == get_num(*cond);
           matched = matched && same_tag && same_val;
         }
         F60 => {
-          let same_tag = get_tag(load_arg(ctx.heap, ctx.term, i)) == F60;
-          let same_val = get_num(load_arg(ctx.heap, ctx.term, i)) == get_num(*cond);
+          let same_tag = get_tag(load_arg(heap, term, i)) == F60;
+          let same_val = get_num(load_arg(heap, term, i)) == get_num(*cond);
           matched = matched && same_tag && same_val;
         }
         CTR => {
-          let same_tag = get_tag(load_arg(ctx.heap, ctx.term, i)) == CTR;
-          let same_ext = get_ext(load_arg(ctx.heap, ctx.term, i)) == get_ext(*cond);
+          let same_tag = get_tag(load_arg(heap, term, i)) == CTR;
+          let same_ext = get_ext(load_arg(heap, term, i)) == get_ext(*cond);
           matched = matched && same_tag && same_ext;
         }
         VAR => {
@@ -91,27 +198,27 @@ pub fn apply(ctx: ReduceCtx, fid: u64, visit: &VisitObj, apply: &ApplyObj) -> bo
 
               // Matches number literals
               let is_num
-                =  get_tag(load_arg(ctx.heap, ctx.term, i)) == U60
-                || get_tag(load_arg(ctx.heap, ctx.term, i)) == F60;
+                =  get_tag(load_arg(heap, term, i)) == U60
+                || get_tag(load_arg(heap, term, i)) == F60;
 
               // Matches constructor labels
               let is_ctr
-                =  get_tag(load_arg(ctx.heap, ctx.term, i)) == CTR
-                && arity_of(&ctx.prog.aris, load_arg(ctx.heap, ctx.term, i)) == 0;
+                =  get_tag(load_arg(heap, term, i)) == CTR
+                && arity_of(&prog.aris, load_arg(heap, term, i)) == 0;
 
               // Matches HOAS numbers and constructors
               let is_hoas_ctr_num
-                =  get_tag(load_arg(ctx.heap, ctx.term, i)) == CTR
-                && get_ext(load_arg(ctx.heap, ctx.term, i)) >= KIND_TERM_CT0
-                && get_ext(load_arg(ctx.heap, ctx.term, i)) <= KIND_TERM_F60;
+                =  get_tag(load_arg(heap, term, i)) == CTR
+                && get_ext(load_arg(heap, term, i)) >= KIND_TERM_CT0
+                && get_ext(load_arg(heap, term, i)) <= KIND_TERM_F60;
 
               matched = matched && (is_num || is_ctr || is_hoas_ctr_num);
 
             // Only match default variables on CTRs and NUMs
             } else {
-              let is_ctr = get_tag(load_arg(ctx.heap, ctx.term, i)) == CTR;
-              let is_u60 = get_tag(load_arg(ctx.heap, ctx.term, i)) == U60;
-              let is_f60 = get_tag(load_arg(ctx.heap, ctx.term, i)) == F60;
+              let is_ctr = get_tag(load_arg(heap, term, i)) == CTR;
+              let is_u60 = get_tag(load_arg(heap, term, i)) == U60;
+              let is_f60 = get_tag(load_arg(heap, term, i)) == F60;
               matched = matched && (is_ctr || is_u60 || is_f60);
             }
           }
@@ -120,40 +227,18 @@ pub fn apply(ctx: ReduceCtx, fid: u64, visit: &VisitObj, apply: &ApplyObj) -> bo
       }
     }
 
-    // If all conditions are satisfied, the rule matched, so we must apply it
+    // If all conditions are satisfied, the rule matched
     if matched {
-      // Increments the gas count
-      inc_cost(ctx.heap, ctx.tid);
-
-      // Builds the right-hand side ctx.term
-      let done = alloc_body(ctx.heap, ctx.prog, ctx.tid, ctx.term, &rule.vars, &rule.body);
-
-      // Links the *ctx.host location to it
-      link(ctx.heap, *ctx.host, done);
-
-      // Collects unused variables
-      for var @ RuleVar { param: _, field: _, erase } in rule.vars.iter() {
-        if *erase {
-          collect(ctx.heap, &ctx.prog.aris, ctx.tid, get_var(ctx.heap, ctx.term, var));
-        }
-      }
-
-      // free the matched ctrs
-      for (i, arity) in &rule.free {
-        free(ctx.heap, ctx.tid, get_loc(load_arg(ctx.heap, ctx.term, *i as u64), 0), *arity);
-      }
-      free(ctx.heap, ctx.tid, get_loc(ctx.term, 0), arity_of(&ctx.prog.aris, fid));
-
-      return true;
+      return Some(r);
     }
   }
 
-  return false;
+  return None;
 }
 
 #[inline(always)]
 pub fn superpose(heap: &Heap, aris: &Aris, tid: usize, host: u64, term: Ptr, argn: Ptr, n: u64) -> Ptr {
-  inc_cost(heap, tid);
+  inc_rule_cost(heap, tid, PROF_FUN_SUP);
   let arit = arity_of(aris, term);
   let func = get_ext(term);
   let fun0 = get_loc(term, 0);
@@ -161,7 +246,7 @@ pub fn superpose(heap: &Heap, aris: &Aris, tid: usize, host: u64, term: Ptr, arg
   let par0 = get_loc(argn, 0);
   for i in 0 .. arit {
     if i != n {
-      let leti = alloc(heap, tid, 3);
+      let leti = alloc_dup(heap, tid);
       let argi = take_arg(heap, term, i);
       link(heap, fun0 + i, Dp0(get_ext(argn), leti));
       link(heap, fun1 + i, Dp1(get_ext(argn), leti));